@@ -0,0 +1,599 @@
+/*
+ * lpdbench [options]
+ *
+ * Queue throughput benchmark for lpd.
+ *
+ * Starts lpd on a scratch spool directory and a loopback port (or
+ * uses an lpd that is already running), then runs a number of
+ * concurrent clients that submit jobs using the RFC1179 'receive job'
+ * protocol or the LPRng block transfer protocol.  lpq (short and long
+ * status) and lprm requests are interleaved with the job submissions.
+ * The queue prints to a file (:lp=) so the drain time measures the
+ * spooling and unspooling overhead and not a device.
+ *
+ * The latency of each request (connect to final acknowledgement or
+ * end of response) is recorded and the p50/p99/max latencies and the
+ * throughput are reported in CSV format.  The drain row gives the time
+ * for the queue to empty and, in the left column, the jobs still in the
+ * queue when the timeout expired.
+ *
+ * lpd reads its configuration file from a compiled in path
+ * (--with-lpd_conf_path); when lpdbench starts lpd it writes the
+ * configuration file given by -C,  so the lpd should be a test build
+ * that uses a scratch configuration file.
+ *
+ * Example:
+ *  ./configure --with-lpd_conf_path=/tmp/bench/lpd.conf ...; make
+ *  lpdbench -L src/lpd -C /tmp/bench/lpd.conf -d /tmp/bench \
+ *      -c 8 -j 100 -s 1k,64k,1m -q 10 -r 20
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <dirent.h>
+
+char *Prog = "???";
+
+char *msg[] = {
+	"use: %s [options]",
+	"  -L lpd      - start this lpd binary (default: use a running lpd)",
+	"  -C conf     - lpd configuration file written for the started lpd",
+	"  -d dir      - scratch directory for spool queue, printcap, log",
+	"                  (default /tmp/lpdbench)",
+	"  -h host     - lpd host (default 127.0.0.1)",
+	"  -p port     - lpd port (default 15515)",
+	"  -P printer  - queue name (default bench)",
+	"  -c clients  - number of concurrent clients (default 4)",
+	"  -j jobs     - jobs submitted by each client (default 25)",
+	"                  each client uses its own job numbers, at most",
+	"                  1000000 jobs in total",
+	"  -s sizes    - job sizes, used in rotation, k and m suffixes allowed",
+	"                  (default 4k)",
+	"  -B          - use the block job transfer protocol",
+	"  -q n        - each client sends an lpq request every n jobs (default 5)",
+	"                  alternating short and long format, 0 disables",
+	"  -r n        - each client removes its last job every n jobs (default 0)",
+	"  -t timeout  - timeout in seconds for a request or the drain (default 300)",
+	"  -o file     - write the CSV report to file (default stdout)",
+	0
+};
+
+/* operations that are timed */
+#define OP_SEND  0
+#define OP_LPQ   1
+#define OP_LPRM  2
+#define OP_COUNT 3
+
+char *op_names[OP_COUNT] = { "send", "lpq", "lprm" };
+
+/* latency record passed from the clients to the parent */
+struct record {
+	int op;
+	int err;
+	long size;
+	double usec;
+};
+
+char *Lpd_path, *Conf_path, *Report_path;
+char *Dir = "/tmp/lpdbench";
+char *Host = "127.0.0.1";
+char *Port = "15515";
+char *Printer = "bench";
+char *Sizes_str = "4k";
+int Clients = 4, Jobs = 25, Block = 0, Lpq_every = 5, Lprm_every = 0;
+int Timeout = 300;
+/* digits in the job number, 6 when there are more than 1000 jobs */
+int Number_width = 3;
+
+long *Sizes;
+int Size_count;
+struct sockaddr_in Dest;
+char Hostname[64] = "bench";
+
+void usage(void)
+{
+	int i;
+	fprintf( stderr, msg[0], Prog );
+	fprintf( stderr, "\n");
+	for( i = 1; msg[i]; ++i ){
+		fprintf( stderr, "%s\n", msg[i] );
+	}
+	exit(1);
+}
+
+double now_usec( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return( tv.tv_sec * 1000000.0 + tv.tv_usec );
+}
+
+long parse_size( char *s )
+{
+	char *end;
+	long n = strtol( s, &end, 10 );
+	if( *end == 'k' || *end == 'K' ){
+		n *= 1024;
+	} else if( *end == 'm' || *end == 'M' ){
+		n *= 1024*1024;
+	}
+	return( n );
+}
+
+void parse_sizes( char *s )
+{
+	char *t, *copy = strdup( s );
+	for( t = strtok( copy, "," ); t; t = strtok( 0, "," ) ){
+		Sizes = realloc( Sizes, (Size_count+1)*sizeof(Sizes[0]) );
+		if( (Sizes[Size_count] = parse_size( t )) <= 0 ){
+			fprintf( stderr, "%s: bad size '%s'\n", Prog, t );
+			exit(1);
+		}
+		++Size_count;
+	}
+	free( copy );
+	if( Size_count == 0 ) usage();
+}
+
+int write_all( int fd, char *s, long len )
+{
+	long n;
+	while( len > 0 ){
+		n = write( fd, s, len );
+		if( n < 0 && errno == EINTR ) continue;
+		if( n <= 0 ) return( -1 );
+		s += n; len -= n;
+	}
+	return( 0 );
+}
+
+int write_file( char *path, char *contents )
+{
+	int fd = open( path, O_WRONLY|O_CREAT|O_TRUNC, 0644 );
+	if( fd < 0 || write_all( fd, contents, strlen(contents) ) ){
+		fprintf( stderr, "%s: cannot write '%s' - %s\n",
+			Prog, path, strerror(errno) );
+		exit(1);
+	}
+	close( fd );
+	return( 0 );
+}
+
+int open_connection( void )
+{
+	int sock = socket( AF_INET, SOCK_STREAM, 0 );
+	if( sock < 0 ) return( -1 );
+	if( connect( sock, (struct sockaddr *)&Dest, sizeof(Dest) ) < 0 ){
+		close( sock );
+		return( -1 );
+	}
+	return( sock );
+}
+
+/* read the one byte acknowledgement, 0 is success */
+int read_ack( int sock )
+{
+	unsigned char c;
+	int n;
+	do{
+		n = read( sock, &c, 1 );
+	} while( n < 0 && errno == EINTR );
+	if( n != 1 ) return( -1 );
+	return( c );
+}
+
+/* read until the other end closes the connection */
+int read_to_eof( int sock )
+{
+	char buffer[4096];
+	int n, total = 0;
+	while( (n = read( sock, buffer, sizeof(buffer) )) != 0 ){
+		if( n < 0 ){
+			if( errno == EINTR ) continue;
+			return( -1 );
+		}
+		total += n;
+	}
+	return( total );
+}
+
+/* send a subcommand line, and wait for the ack unless in a block */
+int send_cmd( int sock, char *cmd, int ack )
+{
+	if( write_all( sock, cmd, strlen(cmd) ) ) return( -1 );
+	if( ack && read_ack( sock ) ) return( -1 );
+	return( 0 );
+}
+
+char *Data;
+
+/*
+ * send a job with a control file and a single data file
+ *  normal: \2printer\n  then \3len dfname\n data \0 and \2len cfname\n cf \0
+ *  block:  \7printer size\n  then the subcommands and files, then \0
+ */
+int send_job( int number, long size )
+{
+	char cf[512], cfname[128], dfname[128], line[256];
+	int sock, cflen, err = -1;
+	double total;
+
+	sprintf( cfname, "cfA%0*d%s", Number_width, number, Hostname );
+	sprintf( dfname, "dfA%0*d%s", Number_width, number, Hostname );
+	sprintf( cf, "H%s\nPbench\nJlpdbench\nCA\nLbench\nl%s\nU%s\nNlpdbench\n",
+		Hostname, dfname, dfname );
+	cflen = strlen( cf );
+
+	if( (sock = open_connection()) < 0 ) return( -1 );
+	if( Block ){
+		/* the block is the subcommands and files without the acks */
+		sprintf( line, "\002%d %s\n", cflen, cfname );
+		total = strlen(line) + cflen;
+		sprintf( line, "\003%ld %s\n", size, dfname );
+		total += strlen(line) + size;
+		sprintf( line, "\007%s %0.0f\n", Printer, total );
+		if( send_cmd( sock, line, 1 ) ) goto done;
+		sprintf( line, "\002%d %s\n", cflen, cfname );
+		if( send_cmd( sock, line, 0 ) || write_all( sock, cf, cflen ) ) goto done;
+		sprintf( line, "\003%ld %s\n", size, dfname );
+		if( send_cmd( sock, line, 0 ) || write_all( sock, Data, size ) ) goto done;
+		if( write_all( sock, "", 1 ) || read_ack( sock ) ) goto done;
+	} else {
+		sprintf( line, "\002%s\n", Printer );
+		if( send_cmd( sock, line, 1 ) ) goto done;
+		sprintf( line, "\003%ld %s\n", size, dfname );
+		if( send_cmd( sock, line, 1 ) || write_all( sock, Data, size )
+			|| write_all( sock, "", 1 ) || read_ack( sock ) ) goto done;
+		sprintf( line, "\002%d %s\n", cflen, cfname );
+		if( send_cmd( sock, line, 1 ) || write_all( sock, cf, cflen )
+			|| write_all( sock, "", 1 ) || read_ack( sock ) ) goto done;
+	}
+	err = 0;
+ done:
+	close( sock );
+	return( err );
+}
+
+/* \3printer\n short status, \4printer\n long status */
+int send_lpq( int longformat )
+{
+	char line[256];
+	int sock, err = -1;
+
+	if( (sock = open_connection()) < 0 ) return( -1 );
+	sprintf( line, "%c%s\n", longformat ? '\004' : '\003', Printer );
+	if( write_all( sock, line, strlen(line) ) == 0 && read_to_eof( sock ) >= 0 ){
+		err = 0;
+	}
+	close( sock );
+	return( err );
+}
+
+/* \5printer user job\n */
+int send_lprm( int number )
+{
+	char line[256];
+	int sock, err = -1;
+
+	if( (sock = open_connection()) < 0 ) return( -1 );
+	sprintf( line, "\005%s bench %d\n", Printer, number );
+	if( write_all( sock, line, strlen(line) ) == 0 && read_to_eof( sock ) >= 0 ){
+		err = 0;
+	}
+	close( sock );
+	return( err );
+}
+
+void record( int fd, int op, int err, long size, double start )
+{
+	struct record r;
+	r.op = op;
+	r.err = err != 0;
+	r.size = size;
+	r.usec = now_usec() - start;
+	/* records are smaller than PIPE_BUF, so the writes are atomic */
+	write_all( fd, (char *)&r, sizeof(r) );
+}
+
+void client( int n, int fd )
+{
+	int i, number, err;
+	long size;
+	double start;
+
+	for( i = 0; i < Jobs; ++i ){
+		/* each client has its own range of job numbers */
+		number = n * Jobs + i;
+		size = Sizes[(n + i) % Size_count];
+		start = now_usec();
+		err = send_job( number, size );
+		record( fd, OP_SEND, err, size, start );
+		if( Lpq_every > 0 && (i+1) % Lpq_every == 0 ){
+			start = now_usec();
+			err = send_lpq( ((i+1) / Lpq_every) & 1 );
+			record( fd, OP_LPQ, err, 0, start );
+		}
+		if( Lprm_every > 0 && (i+1) % Lprm_every == 0 ){
+			start = now_usec();
+			err = send_lprm( number );
+			record( fd, OP_LPRM, err, 0, start );
+		}
+	}
+	exit(0);
+}
+
+/* number of jobs (hold files) in the spool queue */
+int queue_jobs( char *sd )
+{
+	DIR *dir;
+	struct dirent *d;
+	int count = 0;
+
+	if( !(dir = opendir( sd )) ) return( -1 );
+	while( (d = readdir( dir )) ){
+		if( !strncmp( d->d_name, "hfA", 3 ) ) ++count;
+	}
+	closedir( dir );
+	return( count );
+}
+
+/* remove the files left by an earlier run */
+void clean_queue( char *sd )
+{
+	DIR *dir;
+	struct dirent *d;
+	char path[1024];
+
+	if( !(dir = opendir( sd )) ) return;
+	while( (d = readdir( dir )) ){
+		if( d->d_name[0] == '.' ) continue;
+		sprintf( path, "%s/%s", sd, d->d_name );
+		unlink( path );
+	}
+	closedir( dir );
+}
+
+pid_t start_lpd( char *sd )
+{
+	char path[1024], buffer[4096];
+	pid_t pid;
+	int i, sock;
+
+	mkdir( Dir, 0755 );
+	mkdir( sd, 0700 );
+	clean_queue( sd );
+	sprintf( buffer,
+		"lpd_listen_port=%s\nlpd_port=%s\n"
+		"printcap_path=%s/printcap\nlpd_printcap_path=%s/printcap\n"
+		"perms_path=%s/lpd.perms\nlockfile=%s/lpd\nunix_socket_path=%s/sock\n",
+		Port, Port, Dir, Dir, Dir, Dir, Dir );
+	write_file( Conf_path, buffer );
+	sprintf( path, "%s/printcap", Dir );
+	sprintf( buffer, "%s:sd=%s:lp=%s/%s.out:sh:mx=0:done_jobs=0\n",
+		Printer, sd, Dir, Printer );
+	write_file( path, buffer );
+	sprintf( path, "%s/lpd.perms", Dir );
+	write_file( path, "DEFAULT ACCEPT\n" );
+	/* lpd only writes to an existing output file and log file */
+	sprintf( path, "%s/%s.out", Dir, Printer );
+	write_file( path, "" );
+	sprintf( path, "%s/log", Dir );
+	write_file( path, "" );
+
+	if( (pid = fork()) < 0 ){
+		fprintf( stderr, "%s: fork failed - %s\n", Prog, strerror(errno) );
+		exit(1);
+	} else if( pid == 0 ){
+		sprintf( path, "%s/log", Dir );
+		execl( Lpd_path, Lpd_path, "-F", "-L", path, (char *)0 );
+		fprintf( stderr, "%s: cannot execute '%s' - %s\n",
+			Prog, Lpd_path, strerror(errno) );
+		_exit(1);
+	}
+	/* wait for lpd to accept connections */
+	for( i = 0; i < 100; ++i ){
+		if( (sock = open_connection()) >= 0 ){
+			close( sock );
+			return( pid );
+		}
+		if( waitpid( pid, 0, WNOHANG ) == pid ){
+			break;
+		}
+		usleep( 100000 );
+	}
+	fprintf( stderr, "%s: lpd '%s' did not start, see %s/log\n",
+		Prog, Lpd_path, Dir );
+	kill( pid, SIGINT );
+	exit(1);
+}
+
+int cmp_double( const void *l, const void *r )
+{
+	double a = *(const double *)l, b = *(const double *)r;
+	return( a < b ? -1 : a > b );
+}
+
+double percentile( double *v, int n, int p )
+{
+	int i;
+	if( n == 0 ) return( 0 );
+	i = (n * p + 99) / 100 - 1;
+	if( i < 0 ) i = 0;
+	return( v[i] );
+}
+
+int main( int argc, char **argv )
+{
+	int n, i, fds[2], errors[OP_COUNT], counts[OP_COUNT], max[OP_COUNT];
+	double *lat[OP_COUNT], start, submitted, drained, bytes;
+	struct record r;
+	struct hostent *host_ent;
+	char *s, sd[1024];
+	pid_t lpd_pid = 0, *clients;
+	FILE *out = stdout;
+
+	(void)signal( SIGPIPE, SIG_IGN );
+	if( argv[0] ) Prog = argv[0];
+	if( (s = strrchr(Prog,'/')) ){
+		Prog = s+1;
+	}
+	while( (n = getopt(argc, argv, "BC:L:P:c:d:h:j:o:p:q:r:s:t:")) != EOF ){
+		switch(n){
+		case 'B': Block = 1; break;
+		case 'C': Conf_path = optarg; break;
+		case 'L': Lpd_path = optarg; break;
+		case 'P': Printer = optarg; break;
+		case 'c': Clients = atoi(optarg); break;
+		case 'd': Dir = optarg; break;
+		case 'h': Host = optarg; break;
+		case 'j': Jobs = atoi(optarg); break;
+		case 'o': Report_path = optarg; break;
+		case 'p': Port = optarg; break;
+		case 'q': Lpq_every = atoi(optarg); break;
+		case 'r': Lprm_every = atoi(optarg); break;
+		case 's': Sizes_str = optarg; break;
+		case 't': Timeout = atoi(optarg); break;
+		default: usage(); break;
+		}
+	}
+	if( optind != argc || Clients <= 0 || Jobs <= 0 ) usage();
+	if( Clients * (double)Jobs > 1000000 ){
+		fprintf( stderr, "%s: at most 1000000 jobs (clients * jobs)\n", Prog );
+		usage();
+	}
+	if( Clients * Jobs > 1000 ) Number_width = 6;
+	if( Lpd_path && !Conf_path ){
+		fprintf( stderr, "%s: -L needs -C for the lpd configuration file\n", Prog );
+		usage();
+	}
+	parse_sizes( Sizes_str );
+	gethostname( Hostname, sizeof(Hostname)-1 );
+	if( (s = strchr( Hostname, '.' )) ) *s = 0;
+
+	memset( &Dest, 0, sizeof(Dest) );
+	Dest.sin_family = AF_INET;
+	Dest.sin_port = htons( atoi(Port) );
+	if( (host_ent = gethostbyname( Host )) ){
+		memcpy( &Dest.sin_addr, host_ent->h_addr, sizeof(Dest.sin_addr) );
+	} else if( inet_pton( AF_INET, Host, &Dest.sin_addr ) != 1 ){
+		fprintf( stderr, "%s: unknown host '%s'\n", Prog, Host );
+		exit(1);
+	}
+
+	/* one data buffer for the largest job */
+	for( n = i = 0; i < Size_count; ++i ){
+		if( Sizes[i] > n ) n = Sizes[i];
+	}
+	Data = malloc( n );
+	for( i = 0; i < n; ++i ){
+		Data[i] = (i % 64 == 63) ? '\n' : ' ' + (i % 64);
+	}
+
+	sprintf( sd, "%s/%s", Dir, Printer );
+	if( Lpd_path ) lpd_pid = start_lpd( sd );
+
+	if( pipe( fds ) < 0 ){
+		fprintf( stderr, "%s: pipe failed - %s\n", Prog, strerror(errno) );
+		exit(1);
+	}
+	clients = malloc( Clients * sizeof(clients[0]) );
+	start = now_usec();
+	for( i = 0; i < Clients; ++i ){
+		pid_t pid = fork();
+		clients[i] = pid;
+		if( pid < 0 ){
+			fprintf( stderr, "%s: fork failed - %s\n", Prog, strerror(errno) );
+			exit(1);
+		} else if( pid == 0 ){
+			close( fds[0] );
+			client( i, fds[1] );
+		}
+	}
+	close( fds[1] );
+
+	bytes = 0;
+	for( i = 0; i < OP_COUNT; ++i ){
+		errors[i] = counts[i] = 0;
+		max[i] = 16;
+		lat[i] = malloc( max[i] * sizeof(double) );
+	}
+	while( (n = read( fds[0], &r, sizeof(r) )) != 0 ){
+		if( n < 0 && errno == EINTR ) continue;
+		if( n != sizeof(r) || r.op < 0 || r.op >= OP_COUNT ) break;
+		if( r.err ){
+			++errors[r.op];
+			continue;
+		}
+		if( counts[r.op] >= max[r.op] ){
+			max[r.op] *= 2;
+			lat[r.op] = realloc( lat[r.op], max[r.op] * sizeof(double) );
+		}
+		lat[r.op][counts[r.op]++] = r.usec;
+		bytes += r.size;
+	}
+	close( fds[0] );
+	for( i = 0; i < Clients; ++i ){
+		while( waitpid( clients[i], 0, 0 ) < 0 && errno == EINTR );
+	}
+	submitted = now_usec();
+
+	/* wait for the queue to drain */
+	drained = 0;
+	if( lpd_pid ){
+		while( (n = queue_jobs( sd )) > 0
+			&& now_usec() - start < Timeout * 1000000.0 ){
+			usleep( 10000 );
+		}
+		drained = now_usec();
+		if( n != 0 ){
+			fprintf( stderr, "%s: %d jobs left in queue after %d seconds\n",
+				Prog, n, Timeout );
+		}
+		kill( lpd_pid, SIGINT );
+		waitpid( lpd_pid, 0, 0 );
+	}
+
+	if( Report_path && !(out = fopen( Report_path, "w" )) ){
+		fprintf( stderr, "%s: cannot open '%s' - %s\n",
+			Prog, Report_path, strerror(errno) );
+		exit(1);
+	}
+	fprintf( out, "op,count,errors,p50_ms,p99_ms,max_ms,per_sec,mb_per_sec,left\n" );
+	for( i = 0; i < OP_COUNT; ++i ){
+		qsort( lat[i], counts[i], sizeof(double), cmp_double );
+		fprintf( out, "%s,%d,%d,%.3f,%.3f,%.3f,%.1f,",
+			op_names[i], counts[i], errors[i],
+			percentile( lat[i], counts[i], 50 ) / 1000,
+			percentile( lat[i], counts[i], 99 ) / 1000,
+			counts[i] ? lat[i][counts[i]-1] / 1000 : 0.0,
+			counts[i] * 1000000.0 / (submitted - start) );
+		if( i == OP_SEND ){
+			fprintf( out, "%.2f,\n", bytes / (submitted - start) );
+		} else {
+			fprintf( out, ",\n" );
+		}
+	}
+	if( drained ){
+		/* jobs still in the queue at the timeout go in the left column */
+		fprintf( out, "drain,%d,,,,%.3f,%.1f,%.2f,%d\n",
+			counts[OP_SEND],
+			(drained - start) / 1000,
+			counts[OP_SEND] * 1000000.0 / (drained - start),
+			bytes / (drained - start), n > 0 ? n : 0 );
+	}
+	if( out != stdout ) fclose( out );
+	return( errors[OP_SEND] != 0 );
+}
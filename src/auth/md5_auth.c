@@ -17,6 +17,7 @@
 #include "lpd_secure.h"
 #include "lpd_dispatch.h"
 #include "permission.h"
+#include "sendauth.h"
 
 /* 
  * md5 authentication
@@ -94,6 +95,27 @@ static void MDFile( int fd, unsigned char *outstring )
 	MD5Final(&mdContext, outstring);
 }
 
+static int MDUpdate( void *arg, char *buffer, int len,
+	char *errmsg UNUSED, int errlen UNUSED )
+{
+	MD5Update( (MD5_CONTEXT *)arg, (unsigned char *)buffer, len );
+	return( 0 );
+}
+
+static int md5_write( void *arg, char *buffer, int len,
+	char *errmsg, int errlen )
+{
+	int *sock = arg;
+
+	DEBUG4("md5_write: file information '%.*s'", len, buffer );
+	if( Write_fd_len( *sock, buffer, len ) < 0 ){
+		plp_snprintf(errmsg, errlen,
+			"md5_send: write to socket failed - %s", Errormsg(errno) );
+		return( JABORT );
+	}
+	return( 0 );
+}
+
 static char *hexstr( const unsigned char *str, int len, char *outbuf, int outlen )
 {
 	int i, j;
@@ -163,9 +185,9 @@ static int md5key( const char *keyfile, char *name, char *key, int keysize, char
  *
  **************************************************************/
 
-static int md5_send( int *sock, int transfer_timeout, char *tempfile,
-	char *errmsg, int errlen,
-	const struct security *security UNUSED, struct line_list *info )
+static int md5_send_job( int *sock, int transfer_timeout,
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen, struct line_list *info )
 {
 	unsigned char destkey[KEY_LENGTH+1];
 	unsigned char challenge[KEY_LENGTH+1];
@@ -276,17 +298,29 @@ static int md5_send( int *sock, int transfer_timeout, char *tempfile,
 	DEBUG1("md5_send: challenge^destkey^idkey '%s'", 
 		hexstr( challenge, KEY_LENGTH, buffer, sizeof(buffer) ));
 
-	DEBUG1("md5_send: opening tempfile '%s'", tempfile );
+	if( stream ){
+		MD5_CONTEXT mdContext;
 
-	if( (tempfd = Checkread(tempfile,&statb)) < 0){
-		plp_snprintf(errmsg, errlen,
-			"md5_send: open '%s' for read failed - %s",
-			tempfile, Errormsg(errno) );
-		status = JABORT;
-		goto error;
+		DEBUG1("md5_send: doing md5 of %0.0f bytes", stream->size );
+		MD5Init( &mdContext );
+		if( (status = Auth_stream_copy( stream, MDUpdate, &mdContext,
+			errmsg, errlen )) ){
+			goto error;
+		}
+		MD5Final( &mdContext, filehash );
+	} else {
+		DEBUG1("md5_send: opening tempfile '%s'", tempfile );
+
+		if( (tempfd = Checkread(tempfile,&statb)) < 0){
+			plp_snprintf(errmsg, errlen,
+				"md5_send: open '%s' for read failed - %s",
+				tempfile, Errormsg(errno) );
+			status = JABORT;
+			goto error;
+		}
+		DEBUG1("md5_send: doing md5 of file");
+		MDFile( tempfd, filehash);
 	}
-	DEBUG1("md5_send: doing md5 of file");
-	MDFile( tempfd, filehash);
 	DEBUG1("md5_send: filehash '%s'", 
 		hexstr( filehash, KEY_LENGTH, buffer, sizeof(buffer) ));
 
@@ -335,30 +369,34 @@ static int md5_send( int *sock, int transfer_timeout, char *tempfile,
 		goto error;
 	}
 
-	if( lseek( tempfd, 0, SEEK_SET ) == -1 ){
-		plp_snprintf(errmsg,errlen,
-			"md5_send: seek failed - '%s'", Errormsg(errno) );
-		goto error;
-	}
+	if( stream ){
+		DEBUG1("md5_send: starting transfer of job");
+		if( (status = Auth_stream_copy( stream, md5_write, sock,
+			errmsg, errlen )) ){
+			goto error;
+		}
+	} else {
+		if( lseek( tempfd, 0, SEEK_SET ) == -1 ){
+			plp_snprintf(errmsg,errlen,
+				"md5_send: seek failed - '%s'", Errormsg(errno) );
+			goto error;
+		}
 
-	DEBUG1("md5_send: starting transfer of file");
-	while( (len = Read_fd_len_timeout( transfer_timeout, tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
-		buffer[len] = 0;
-		DEBUG4("md5_send: file information '%s'", buffer );
-		if( write( *sock, buffer, len) != len ){
+		DEBUG1("md5_send: starting transfer of file");
+		while( (len = Read_fd_len_timeout( transfer_timeout, tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
+			buffer[len] = 0;
+			if( (status = md5_write( sock, buffer, len, errmsg, errlen )) ){
+				goto error;
+			}
+		}
+		if( len < 0 ){
 			plp_snprintf(errmsg, errlen,
-				"md5_send: write to socket failed - %s", Errormsg(errno) );
+				"md5_send: read dest '%s' failed - %s", tempfile, Errormsg(errno) );
 			status = JABORT;
 			goto error;
 		}
+		close(tempfd); tempfd = -1;
 	}
-	if( len < 0 ){
-		plp_snprintf(errmsg, errlen,
-			"md5_send: read dest '%s' failed - %s", tempfile, Errormsg(errno) );
-		status = JABORT;
-		goto error;
-	}
-	close(tempfd); tempfd = -1;
 	/* we close the writing side */
 	shutdown( *sock, 1 );
 
@@ -396,10 +434,27 @@ static int md5_send( int *sock, int transfer_timeout, char *tempfile,
 	}
 	
  error:
-	close(tempfd); 
+	if( tempfd >= 0 ) close(tempfd); 
 	return(status);
 }
 
+static int md5_send( int *sock, int transfer_timeout, char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( md5_send_job( sock, transfer_timeout, 0, tempfile,
+		errmsg, errlen, info ) );
+}
+
+static int md5_stream( int *sock, int transfer_timeout,
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( md5_send_job( sock, transfer_timeout, stream, tempfile,
+		errmsg, errlen, info ) );
+}
+
 
 static int md5_receive( int *sock, int transfer_timeout,
 	char *user UNUSED, char *jobsize, int from_server, char *authtype UNUSED,
@@ -686,7 +741,7 @@ static int md5_receive( int *sock, int transfer_timeout,
 
 
 const struct security md5_auth =
-	{ "md5",       "md5",	"md5",      0,              0,           md5_send, 0, md5_receive };
+	{ "md5",       "md5",	"md5",      0,              0,           md5_send, 0, md5_receive, md5_stream };
 
 #ifdef WITHPLUGINS
 plugin_get_func getter_name(md5);
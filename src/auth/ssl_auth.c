@@ -19,6 +19,7 @@
 #include "user_auth.h"
 #include "lpd_secure.h"
 #include "ssl_auth.h"
+#include "sendauth.h"
 
 /*
    The code for the SSL support routines has been taken from
@@ -742,12 +743,29 @@ static const char * Error_SSL_name( int i )
 	return(s);
 }
 
-static int Ssl_send( int *sock,
+struct ssl_write {
+	SSL *ssl;
+	int timeout;
+};
+
+static int Ssl_write( void *arg, char *buffer, int len,
+	char *errmsg, int errlen )
+{
+	struct ssl_write *out = arg;
+
+	DEBUG4("Ssl_write: file information '%.*s'", len, buffer );
+	if( Write_SSL_connection( out->timeout, out->ssl, buffer, len, errmsg, errlen) ){
+		return( JFAIL );
+	}
+	return( 0 );
+}
+
+static int Ssl_send_job( int *sock,
 	int transfer_timeout,
-	char *tempfile,
-	char *errmsg, int errlen,
-	const struct security *security, struct line_list *info )
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen, struct line_list *info )
 {
+	struct ssl_write out;
 	char buffer[LARGEBUFFER];
 	struct stat statb;
 	int tempfd = -1, len;
@@ -770,14 +788,17 @@ static int Ssl_send( int *sock,
 		goto t_error;
 	}
 
-	if( (tempfd = Checkread(tempfile,&statb)) < 0){
+	if( stream ){
+		size = stream->size;
+	} else if( (tempfd = Checkread(tempfile,&statb)) < 0){
 		plp_snprintf(errmsg, errlen,
 			"Ssl_send: open '%s' for read failed - %s",
 			tempfile, Errormsg(errno) );
 		status = JABORT;
 		goto t_error;
+	} else {
+		size = statb.st_size;
 	}
-	size = statb.st_size;
 	plp_snprintf(buffer,sizeof(buffer), "%0.0f\n", size );
 	DEBUG1("Ssl_send: writing '%s'", buffer );
 	if( Write_SSL_connection( transfer_timeout, ssl, buffer, strlen(buffer), errmsg, errlen) ){
@@ -786,11 +807,16 @@ static int Ssl_send( int *sock,
 	}
 
 	DEBUG1("Ssl_send: starting send");
-	while( (len = ok_read( tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
-		buffer[len] = 0;
-		DEBUG4("Ssl_send: file information '%s'", buffer );
-		if( Write_SSL_connection( transfer_timeout, ssl, buffer, len, errmsg, errlen) ){
-			status = JFAIL;
+	out.ssl = ssl;
+	out.timeout = transfer_timeout;
+	if( stream ){
+		if( (status = Auth_stream_copy( stream, Ssl_write, &out,
+			errmsg, errlen )) ){
+			goto t_error;
+		}
+		len = 0;
+	} else while( (len = ok_read( tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
+		if( (status = Ssl_write( &out, buffer, len, errmsg, errlen )) ){
 			goto t_error;
 		}
 	}
@@ -867,6 +893,26 @@ static int Ssl_send( int *sock,
 	return(status);
 }
 
+static int Ssl_send( int *sock,
+	int transfer_timeout,
+	char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( Ssl_send_job( sock, transfer_timeout, 0, tempfile,
+		errmsg, errlen, info ) );
+}
+
+static int Ssl_stream( int *sock,
+	int transfer_timeout,
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( Ssl_send_job( sock, transfer_timeout, stream, tempfile,
+		errmsg, errlen, info ) );
+}
+
 static int Ssl_receive( int *sock, int transfer_timeout,
 	char *user, char *jobsize, int from_server, char *authtype,
 	struct line_list *info,
@@ -985,7 +1031,7 @@ static int Ssl_receive( int *sock, int transfer_timeout,
 }
 
 const struct security ssl_auth =
-	{ "ssl",      "ssl",	"ssl",       0,              0,           Ssl_send, 0, Ssl_receive };
+	{ "ssl",      "ssl",	"ssl",       0,              0,           Ssl_send, 0, Ssl_receive, Ssl_stream };
 
 #ifdef WITHPLUGINS
 plugin_get_func getter_name(ssl);
@@ -17,6 +17,7 @@
 #include "lpd_secure.h"
 #include "lpd_dispatch.h"
 #include "permission.h"
+#include "sendauth.h"
 
 #if 0
 /*
@@ -103,44 +104,66 @@ static int Test_accept( int *sock, int transfer_timeout,
  *
  **************************************************************/
 
-static int Test_send( int *sock,
+static int Test_write( void *arg, char *buffer, int len,
+	char *errmsg, int errlen )
+{
+	int *sock = arg;
+
+	DEBUG4("Test_write: file information '%.*s'", len, buffer );
+	if( Write_fd_len( *sock, buffer, len ) < 0 ){
+		plp_snprintf(errmsg, errlen,
+			"Test_send: write to socket failed - %s", Errormsg(errno) );
+		return( JABORT );
+	}
+	return( 0 );
+}
+
+/*
+ * send the job from the tempfile or the stream,
+ *  then put the reply in the tempfile
+ */
+
+static int Test_send_job( int *sock,
 	int transfer_timeout,
-	char *tempfile,
-	char *errmsg, int errlen,
-	const struct security *security UNUSED, struct line_list *info )
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen, struct line_list *info )
 {
 	char buffer[LARGEBUFFER];
 	struct stat statb;
-	int tempfd, len;
+	int tempfd = -1, len;
 	int status = 0;
 
 	if(DEBUGL1)Dump_line_list("Test_send: info", info );
 	DEBUG1("Test_send: sending on socket %d", *sock );
-	if( (tempfd = Checkread(tempfile,&statb)) < 0){
-		plp_snprintf(errmsg, errlen,
-			"Test_send: open '%s' for read failed - %s",
-			tempfile, Errormsg(errno) );
-		status = JABORT;
-		goto error;
-	}
-	DEBUG1("Test_send: starting read");
-	while( (len = Read_fd_len_timeout( transfer_timeout, tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
-		buffer[len] = 0;
-		DEBUG4("Test_send: file information '%s'", buffer );
-		if( write( *sock, buffer, len) != len ){
+	if( stream ){
+		DEBUG1("Test_send: streaming %0.0f bytes", stream->size );
+		if( (status = Auth_stream_copy( stream, Test_write, sock,
+			errmsg, errlen )) ){
+			goto error;
+		}
+	} else {
+		if( (tempfd = Checkread(tempfile,&statb)) < 0){
 			plp_snprintf(errmsg, errlen,
-				"Test_send: write to socket failed - %s", Errormsg(errno) );
+				"Test_send: open '%s' for read failed - %s",
+				tempfile, Errormsg(errno) );
 			status = JABORT;
 			goto error;
 		}
+		DEBUG1("Test_send: starting read");
+		while( (len = Read_fd_len_timeout( transfer_timeout, tempfd, buffer, sizeof(buffer)-1 )) > 0 ){
+			buffer[len] = 0;
+			if( (status = Test_write( sock, buffer, len, errmsg, errlen )) ){
+				goto error;
+			}
+		}
+		if( len < 0 ){
+			plp_snprintf(errmsg, errlen,
+				"Test_send: read from '%s' failed - %s", tempfile, Errormsg(errno) );
+			status = JABORT;
+			goto error;
+		}
+		close(tempfd); tempfd = -1;
 	}
-	if( len < 0 ){
-		plp_snprintf(errmsg, errlen,
-			"Test_send: read from '%s' failed - %s", tempfile, Errormsg(errno) );
-		status = JABORT;
-		goto error;
-	}
-	close(tempfd); tempfd = -1;
 	/* we close the writing side */
 	shutdown( *sock, 1 );
 
@@ -168,9 +191,30 @@ static int Test_send( int *sock,
 	close( tempfd ); tempfd = -1;
 
  error:
+	if( tempfd >= 0 ) close( tempfd );
 	return(status);
 }
 
+static int Test_send( int *sock,
+	int transfer_timeout,
+	char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( Test_send_job( sock, transfer_timeout, 0, tempfile,
+		errmsg, errlen, info ) );
+}
+
+static int Test_stream( int *sock,
+	int transfer_timeout,
+	struct auth_stream *stream, char *tempfile,
+	char *errmsg, int errlen,
+	const struct security *security UNUSED, struct line_list *info )
+{
+	return( Test_send_job( sock, transfer_timeout, stream, tempfile,
+		errmsg, errlen, info ) );
+}
+
 static int Test_receive( int *sock, int transfer_timeout,
 	char *user UNUSED, char *jobsize, int from_server, char *authtype UNUSED,
 	struct line_list *info,
@@ -261,7 +305,7 @@ static int Test_receive( int *sock, int transfer_timeout,
 }
 
 const struct security test_auth =
-	{ "test",      "test",	"test",     0,              0,           Test_send, 0, Test_receive };
+	{ "test",      "test",	"test",     0,              0,           Test_send, 0, Test_receive, Test_stream };
 
 #ifdef WITHPLUGINS
 plugin_get_func getter_name(test);
@@ -18,8 +18,17 @@
 #include "child.h"
 #include "linksupport.h"
 #include "fileopen.h"
+#include "proctitle.h"
+#include "lpd_worker.h"
 /**** ENDINCLUDE ****/
 
+#ifndef PIPE_BUF
+# define PIPE_BUF 512
+#endif
+
+static int Send_to_accounting_sink( char *record, int timeout );
+static void Accounting_sink( struct line_list *args, int input ) NORETURN;
+
 /*
  Do_accounting is called with:
    status = Do_accounting( 0, Accounting_start_DYN, job, Send_job_rw_timeout_DYN );
@@ -100,6 +109,9 @@ int Do_accounting( int end, char *command, struct job *job, int timeout )
 			Errorcode = JABORT;
 			logerr_die(LOG_INFO, "Do_accounting: lseek tempfile failed");
 		}
+	} else if( !ISNULL(Accounting_file_DYN) && !(end == 0 && Accounting_check_DYN)
+		&& Send_to_accounting_sink( args.list[0], timeout ) == 0 ){
+		DEBUG2("Do_accounting: sent to accounting sink");
 	} else if( !ISNULL(Accounting_file_DYN) ){
 		if( (cval(Accounting_file_DYN) == '|') ){
 			int fd = Make_temp_fd(0);
@@ -153,6 +165,7 @@ int Do_accounting( int end, char *command, struct job *job, int timeout )
 					Errorcode= JFAIL;
 					logerr_die(LOG_INFO, "Do_accounting: write to '%s' failed", command);
 				}
+				if( Accounting_fsync_DYN ) fsync( tempfd );
 				close(tempfd); tempfd = -1;
 			}
 		}
@@ -193,3 +206,246 @@ int Do_accounting( int end, char *command, struct job *job, int timeout )
 	DEBUG2("Do_accounting: status %s", Server_status(err) );
 	return( err );
 }
+
+/*
+ * Accounting sink
+ *
+ *  With :accounting_batch the queue server starts a process that keeps the
+ *  :af filter, connection or file open for as long as the queue server runs.
+ *  The workers write their :as and :ae records down a pipe to it,  and it
+ *  writes whatever has accumulated as one batch.  The buffer is bounded;
+ *  when the destination falls behind the sink stops reading,  the pipe
+ *  fills,  and the workers block for up to the write timeout before
+ *  falling back to writing the record themselves.
+ */
+
+static int Accounting_sink_fd = -1;		/* pipe to the sink */
+static pid_t Accounting_sink_pid;		/* sink process */
+static char *Accounting_sink_af;		/* :af the sink writes to */
+
+/*
+ * Start_accounting_sink - called by the queue server before it starts a
+ *  worker;  returns the fd to pass to the worker or 0 if there is no sink.
+ */
+
+int Start_accounting_sink( void )
+{
+	struct line_list args;
+	int p[2];
+	pid_t pid;
+
+	if( !Accounting_batch_DYN || ISNULL(Accounting_file_DYN) ){
+		Stop_accounting_sink();
+		return( 0 );
+	}
+	if( Accounting_sink_fd > 0 ){
+		if( !safestrcmp( Accounting_sink_af, Accounting_file_DYN )
+			&& kill( Accounting_sink_pid, 0 ) == 0 ){
+			return( Accounting_sink_fd );
+		}
+		Stop_accounting_sink();
+	}
+	if( pipe(p) == -1 ){
+		logerr(LOG_INFO, "Start_accounting_sink: pipe() failed");
+		return( 0 );
+	}
+	Max_open(p[0]); Max_open(p[1]);
+	Init_line_list(&args);
+	Set_str_value(&args,PRINTER,Printer_DYN);
+	pid = Start_worker( "accounting", Accounting_sink, &args, p[0] );
+	close(p[0]);
+	if( pid < 0 ){
+		logerr(LOG_INFO, "Start_accounting_sink: fork failed");
+		close(p[1]);
+		return( 0 );
+	}
+	/* it exits when the last worker and the queue server close the pipe */
+	Detach_child( pid );
+	Accounting_sink_pid = pid;
+	Accounting_sink_fd = p[1];
+	Accounting_sink_af = safestrdup( Accounting_file_DYN, __FILE__,__LINE__ );
+	DEBUG1("Start_accounting_sink: pid %ld, fd %d, af '%s'",
+		(long)pid, Accounting_sink_fd, Accounting_sink_af );
+	return( Accounting_sink_fd );
+}
+
+void Stop_accounting_sink( void )
+{
+	if( Accounting_sink_fd > 0 ) close( Accounting_sink_fd );
+	Accounting_sink_fd = -1;
+	if( Accounting_sink_af ) free( Accounting_sink_af );
+	Accounting_sink_af = 0;
+}
+
+/*
+ * Set_accounting_sink - the worker side, fd passed by the queue server
+ */
+
+void Set_accounting_sink( int fd )
+{
+	Accounting_sink_fd = fd;
+}
+
+/*
+ * Send_to_accounting_sink - returns 0 if the sink took the record
+ *  A record no larger than PIPE_BUF is written atomically,  so the
+ *  records of different workers are never interleaved.
+ */
+
+static int Send_to_accounting_sink( char *record, int timeout )
+{
+	int len = safestrlen( record );
+
+	if( Accounting_sink_fd <= 0 || len > PIPE_BUF ) return( -1 );
+	if( Write_fd_len_timeout( timeout, Accounting_sink_fd, record, len ) < 0 ){
+		logerr(LOG_INFO, "Do_accounting: write to accounting sink failed, writing directly");
+		close( Accounting_sink_fd );
+		Accounting_sink_fd = -1;
+		return( -1 );
+	}
+	return( 0 );
+}
+
+static int Accounting_is_remote( void )
+{
+	return( isalnum(cval(Accounting_file_DYN))
+		&& safestrchr( Accounting_file_DYN, '%' ) != 0 );
+}
+
+/*
+ * Open_accounting_dest - start the :af filter,  connect to the accounting
+ *  server,  or open the accounting file
+ */
+
+static int Open_accounting_dest( pid_t *pid )
+{
+	struct line_list files;
+	struct stat statb;
+	char msg[SMALLBUFFER];
+	int fd = -1, p[2], null_fd;
+
+	if( cval(Accounting_file_DYN) == '|' ){
+		if( pipe(p) == -1 ){
+			logerr(LOG_INFO, "Accounting_sink: pipe() failed");
+			return( -1 );
+		}
+		Max_open(p[0]); Max_open(p[1]);
+		if( (null_fd = open("/dev/null", O_RDWR )) < 0 ){
+			logerr(LOG_INFO, "Accounting_sink: open /dev/null failed");
+			close(p[0]); close(p[1]);
+			return( -1 );
+		}
+		Max_open(null_fd);
+		Init_line_list(&files);
+		Check_max(&files, 3 );
+		files.list[files.count++] = Cast_int_to_voidstar(p[0]);	/* stdin */
+		files.list[files.count++] = Cast_int_to_voidstar(null_fd);	/* stdout */
+		files.list[files.count++] = Cast_int_to_voidstar(2);	/* stderr */
+		*pid = Make_passthrough( Accounting_file_DYN, Filter_options_DYN, &files, 0, 0 );
+		files.count = 0;
+		Free_line_list(&files);
+		close(p[0]); close(null_fd);
+		fd = p[1];
+	} else if( Accounting_is_remote() ){
+		if( (fd = Link_open( Accounting_file_DYN, Send_job_rw_timeout_DYN, 0, 0,
+				msg, sizeof(msg) )) < 0 ){
+			logerr(LOG_INFO, _("connection to accounting server '%s' failed '%s'"),
+				Accounting_file_DYN, msg);
+		}
+	} else {
+		fd = Checkwrite( Accounting_file_DYN, &statb, 0, Create_files_DYN, 0 );
+	}
+	DEBUG2("Accounting_sink: '%s' fd %d", Accounting_file_DYN, fd );
+	return( fd );
+}
+
+static int Close_accounting_dest( int fd, pid_t *pid )
+{
+	plp_status_t status;
+
+	if( fd > 0 ) close( fd );
+	if( *pid > 0 ) plp_waitpid( *pid, &status, 0 );
+	*pid = -1;
+	return( -1 );
+}
+
+/*
+ * Write_accounting_batch - write the batch,  reopening the destination once
+ *  if the write fails.  The sink cannot fail the jobs,  so a batch that
+ *  still cannot be written is logged and dropped.
+ */
+
+static int Write_accounting_batch( int fd, pid_t *pid, char *batch, int len )
+{
+	int tries, file;
+
+	file = cval(Accounting_file_DYN) != '|' && !Accounting_is_remote();
+	for( tries = 0; tries < 2; ++tries ){
+		if( fd <= 0 ) fd = Open_accounting_dest( pid );
+		if( fd <= 0 ) break;
+		if( file ){
+			fd = Trim_status_file( fd, Accounting_file_DYN,
+				Max_accounting_file_size_DYN, Min_accounting_file_size_DYN );
+		}
+		if( Write_fd_len( fd, batch, len ) >= 0 ){
+			if( file && Accounting_fsync_DYN ) fsync( fd );
+			return( fd );
+		}
+		logerr(LOG_INFO, "Accounting_sink: write to '%s' failed", Accounting_file_DYN );
+		fd = Close_accounting_dest( fd, pid );
+	}
+	logmsg(LOG_INFO, "Accounting_sink: dropped %d bytes of records for '%s'",
+		len, Accounting_file_DYN );
+	return( fd );
+}
+
+static int Accounting_input_ready( int fd )
+{
+	fd_set readfds;
+	struct timeval delay;
+
+	FD_ZERO( &readfds );
+	FD_SET( fd, &readfds );
+	memset( &delay, 0, sizeof(delay) );
+	return( select( fd+1, &readfds, NULL, NULL, &delay ) > 0 );
+}
+
+/*
+ * Accounting_sink - the sink process
+ *  Reads records until all the writers have closed the pipe,  and writes
+ *  what has arrived each time the pipe is drained or the buffer is full.
+ */
+
+static void Accounting_sink( struct line_list *args, int input )
+{
+	char *buffer;
+	int len, n, cut, fd = -1;
+	pid_t pid = -1;
+
+	Name = "(Accounting)";
+	Set_DYN(&Printer_DYN, Find_str_value(args,PRINTER));
+	setproctitle( "lpd %s '%s'", Name, Printer_DYN );
+	Free_line_list(args);
+	DEBUG1("Accounting_sink: af '%s', input %d", Accounting_file_DYN, input );
+
+	buffer = malloc_or_die( LARGEBUFFER, __FILE__,__LINE__ );
+	len = 0;
+	while( (n = ok_read( input, buffer+len, LARGEBUFFER-len )) > 0 ){
+		len += n;
+		if( len < LARGEBUFFER && Accounting_input_ready( input ) ) continue;
+		/* write whole records unless the buffer is full */
+		for( cut = len; cut > 0 && buffer[cut-1] != '\n'; --cut );
+		if( cut == 0 ){
+			if( len < LARGEBUFFER ) continue;
+			cut = len;
+		}
+		DEBUG2("Accounting_sink: batch of %d bytes", cut );
+		fd = Write_accounting_batch( fd, &pid, buffer, cut );
+		len -= cut;
+		memmove( buffer, buffer+cut, len );
+	}
+	if( len > 0 ) fd = Write_accounting_batch( fd, &pid, buffer, len );
+	Close_accounting_dest( fd, &pid );
+	free( buffer );
+	cleanup(0);
+}
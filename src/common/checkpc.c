@@ -21,6 +21,7 @@
 #include "lpd_remove.h"
 #include "linksupport.h"
 #include "gethostinfo.h"
+#include "errorcodes.h"
 
 /**** ENDINCLUDE ****/
 
@@ -466,6 +467,9 @@ void Scan_printer(struct line_list *spooldirs)
 	 */
 	if( Fix ){
 		if( Lpq_status_file_DYN ) unlink(Lpq_status_file_DYN );
+		if( Queue_index_file_DYN ) unlink(Queue_index_file_DYN );
+		if( Queue_jobnumber_file_DYN ) unlink(Queue_jobnumber_file_DYN );
+		if( Queue_snapshot_file_DYN ) unlink(Queue_snapshot_file_DYN );
 	}
 	Free_line_list( &Sort_order );
 	{ int fdx = open("/dev/null",O_RDWR); DEBUG1("Scan_printer: Scan_queue before maxfd %d", fdx); close(fdx); }
@@ -1461,22 +1465,96 @@ void Test_port(int ruid, int euid, char *serial_line )
 void Fix_clean( char *s, int no )
 {
 	struct stat statb;
-	int fd;
+	off_t size;
 	if( s ){
 		if(!no){
 			Make_write_file( s, 0 );
-			if( Truncate >= 0 ){
+			if( Truncate > 0 ){
 				MESSAGE(" trimming '%s'", s );
-				fd = Trim_status_file( -1, s, Truncate, Truncate );
-				close(fd);
+				size = Trim_file_tail( s, (off_t)Truncate*1024 );
+				/* the older lines are in the previous segment;
+				 * keep only what is needed to make up the size */
+				s = Status_file_segment( s );
+				if( size >= 0 && stat(s,&statb) == 0 ){
+					if( size >= (off_t)Truncate*1024 ){
+						MESSAGE(" removing '%s'", s );
+						unlink(s);
+					} else {
+						MESSAGE(" trimming '%s'", s );
+						Trim_file_tail( s, (off_t)Truncate*1024 - size );
+					}
+				}
+				free(s); s = 0;
 			}
 		} else {
 			if( stat(s,&statb) == 0 && Fix ){
 				MESSAGE(" removing '%s'", s );
 				unlink(s);
 			}
+			s = Status_file_segment( s );
+			if( stat(s,&statb) == 0 && Fix ){
+				MESSAGE(" removing '%s'", s );
+				unlink(s);
+			}
+			free(s); s = 0;
+		}
+	}
+}
+
+/*
+ * Trim_file_tail - cut a file down to its last 'max' bytes
+ *  The part that is kept starts at a line boundary and is copied to the
+ *  start of the file.  Returns the size of the file before trimming,  or
+ *  -1 if it cannot be opened.
+ */
+
+off_t Trim_file_tail( char *file, off_t max )
+{
+	struct stat statb;
+	char buffer[LARGEBUFFER];
+	off_t in, out;
+	int fd, count, flags;
+	char *s;
+
+	if( (fd = Checkwrite( file, &statb, O_RDWR, 0, 0 )) < 0 ) return( -1 );
+	/* Trim_status_file() holds the lock while it rotates the file */
+	Do_lock( fd, 1 );
+	if( fstat( fd, &statb ) == -1 ){
+		close( fd );
+		return( -1 );
+	}
+	if( statb.st_size > max ){
+		/* skip the partial line at the cut */
+		in = statb.st_size - max;
+		lseek( fd, in, SEEK_SET );
+		while( (count = ok_read( fd, buffer, sizeof(buffer) )) > 0 ){
+			if( (s = memchr( buffer, '\n', count )) ){
+				in += s - buffer + 1;
+				break;
+			}
+			in += count;
+		}
+		/* Checkwrite() opens files for appending */
+		if( (flags = fcntl( fd, F_GETFL, 0 )) == -1
+			|| fcntl( fd, F_SETFL, flags & ~O_APPEND ) == -1 ){
+			Errorcode = JABORT;
+			logerr_die(LOG_ERR, "Trim_file_tail: cannot set flags on '%s'", file );
+		}
+		out = 0;
+		while( lseek( fd, in, SEEK_SET ) != -1
+			&& (count = ok_read( fd, buffer, sizeof(buffer) )) > 0 ){
+			if( lseek( fd, out, SEEK_SET ) == -1
+				|| Write_fd_len( fd, buffer, count ) < 0 ){
+				Errorcode = JABORT;
+				logerr_die(LOG_ERR, "Trim_file_tail: cannot write '%s'", file );
+			}
+			in += count;
+			out += count;
 		}
+		ftruncate( fd, out );
 	}
+	close( fd );
+	return( statb.st_size );
 }
 
 int Check_path_list( char *plist, int allow_missing )
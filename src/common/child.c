@@ -67,6 +67,16 @@ static void forget_child(pid_t pid)
 	}
 }
 
+/*
+ * Detach_child - a child that outlives this process
+ *  The child is not killed by cleanup(); it is expected to exit on its own
+ *  when its input is closed.
+ */
+void Detach_child( pid_t pid )
+{
+	forget_child( pid );
+}
+
 
 /*
  * Patrick Powell
@@ -747,7 +747,6 @@ const char *Server_status( int d )
 #endif
 	char msg_b[SMALLBUFFER];
 	static int insetstatus;
-	struct stat statb;
     VA_LOCAL_DECL
 
     VA_START (fmt);
@@ -774,9 +773,8 @@ const char *Server_status( int d )
 			Add_line_list(&Status_lines,msg_b,0,0,0);
 		}
 	} else {
-		if( Status_fd <= 0 
-			|| ( Max_status_size_DYN > 0 && fstat( Status_fd, &statb ) != -1
-			&& (statb.st_size / 1024 ) > Max_status_size_DYN ) ){
+		/* reopens the status file if it was rotated */
+		if( Status_fd <= 0 || Max_status_size_DYN > 0 ){
 			Status_fd = Trim_status_file( Status_fd, Queue_status_file_DYN,
 				Max_status_size_DYN, Min_status_size_DYN );
 		}
@@ -0,0 +1,220 @@
+/***************************************************************************
+ * LPRng - An Extended Print Spooler System
+ *
+ * Copyright 1988-2003, Patrick Powell, San Diego, CA
+ *     papowell@lprng.com
+ * See LICENSE for conditions of use.
+ *
+ ***************************************************************************/
+
+/***************************************************************************
+ * Concurrent queue scanning
+ *
+ * Reporting the status of all of the queues (lpq -a, the lpd 'all'
+ * status request, the logger status dump) gets the status of each
+ * queue in turn, so the time taken is the sum of the times for all the
+ * queues.  Fanout_status() does the per-queue work in up to
+ * queue_scan_workers child processes at once.  Each child writes its
+ * output to a pipe;  the parent collects it and hands it back to the
+ * caller in printcap order as soon as all the earlier queues have been
+ * reported.
+ ***************************************************************************/
+
+#include "lp.h"
+#include "errorcodes.h"
+#include "child.h"
+#include "linelist.h"
+#include "fanout.h"
+
+/**** ENDINCLUDE ****/
+
+struct fanout_job {
+	pid_t pid;		/* worker process, 0 when finished */
+	int fd;			/* output from worker */
+	char *output;	/* collected output */
+	int len, max;
+};
+
+static int Start_fanout( struct fanout_job *job, int n,
+	Fanout_proc proc, void *arg );
+static void Run_fanout( struct fanout_job *job, int n,
+	Fanout_proc proc, void *arg );
+static int Read_fanout( struct fanout_job *job );
+static void Finish_fanout( struct fanout_job *job );
+
+/*
+ * int Fanout_status( int count, int workers, Fanout_proc proc,
+ *   Fanout_emit emit, void *arg )
+ *
+ *  call proc( n, fd, arg ) for n = 0 .. count-1,  running up to 'workers'
+ *  of them at once in child processes.  The output that proc() writes
+ *  to fd is passed to emit( n, output, len, arg ) in order of n.
+ *  If we cannot fork, proc() is run in this process.
+ *  returns: 0 if all was emitted,  the emit() return value if it failed
+ */
+
+int Fanout_status( int count, int workers, Fanout_proc proc,
+	Fanout_emit emit, void *arg )
+{
+	struct fanout_job *jobs;
+	fd_set readfds;
+	int next, started, active, max_socks, n, status = 0;
+
+	if( workers < 1 ) workers = 1;
+	jobs = malloc_or_die( (count+1)*sizeof(jobs[0]), __FILE__,__LINE__ );
+	memset( jobs, 0, (count+1)*sizeof(jobs[0]) );
+	for( n = 0; n < count; ++n ) jobs[n].fd = -1;
+	next = started = active = 0;
+
+	while( next < count ){
+		/* start as many as we can */
+		while( started < count && active < workers ){
+			if( Start_fanout( &jobs[started], started, proc, arg ) ){
+				if( active ) break;
+				/* nothing running,  do it ourselves */
+				Run_fanout( &jobs[started], started, proc, arg );
+			} else {
+				++active;
+			}
+			++started;
+		}
+		/* report the ones that are done,  in order */
+		while( next < started && jobs[next].pid == 0 && jobs[next].fd < 0 ){
+			if( status == 0 ){
+				status = (emit)( next, jobs[next].output, jobs[next].len, arg );
+			}
+			if( jobs[next].output ) free( jobs[next].output );
+			jobs[next].output = 0;
+			++next;
+		}
+		if( status ) break;
+		if( active == 0 ) continue;
+
+		FD_ZERO( &readfds );
+		max_socks = 0;
+		for( n = next; n < started; ++n ){
+			if( jobs[n].fd >= 0 ){
+				FD_SET( jobs[n].fd, &readfds );
+				if( jobs[n].fd >= max_socks ) max_socks = jobs[n].fd+1;
+			}
+		}
+		if( select( max_socks, &readfds, NULL, NULL, NULL ) < 0 ){
+			if( errno == EINTR ) continue;
+			logerr_die(LOG_INFO, "Fanout_status: select failed" );
+		}
+		for( n = next; n < started; ++n ){
+			if( jobs[n].fd >= 0 && FD_ISSET( jobs[n].fd, &readfds )
+				&& Read_fanout( &jobs[n] ) ){
+				Finish_fanout( &jobs[n] );
+				--active;
+			}
+		}
+	}
+
+	/* we stopped early;  get rid of the rest */
+	for( n = next; n < started; ++n ){
+		if( jobs[n].pid > 0 ){
+			kill( jobs[n].pid, SIGINT );
+			Finish_fanout( &jobs[n] );
+		}
+		if( jobs[n].output ) free( jobs[n].output );
+	}
+	free( jobs );
+	DEBUG1("Fanout_status: count %d, workers %d, status %d",
+		count, workers, status );
+	return( status );
+}
+
+/*
+ * start a worker process for job n
+ *  returns: 0 if started
+ */
+
+static int Start_fanout( struct fanout_job *job, int n,
+	Fanout_proc proc, void *arg )
+{
+	int fds[2];
+	pid_t pid;
+
+	if( pipe( fds ) == -1 ){
+		logerr(LOG_INFO, "Start_fanout: pipe failed" );
+		return( -1 );
+	}
+	Max_open(fds[0]); Max_open(fds[1]);
+	if( (pid = dofork(0)) < 0 ){
+		logerr(LOG_INFO, "Start_fanout: fork failed" );
+		close( fds[0] ); close( fds[1] );
+		return( -1 );
+	} else if( pid == 0 ){
+		close( fds[0] );
+		Errorcode = (proc)( n, fds[1], arg );
+		cleanup(0);
+	}
+	close( fds[1] );
+	job->pid = pid;
+	job->fd = fds[0];
+	DEBUG2("Start_fanout: %d, pid %ld, fd %d", n, (long)pid, job->fd );
+	return( 0 );
+}
+
+/*
+ * do job n in this process,  collecting the output in a temp file
+ */
+
+static void Run_fanout( struct fanout_job *job, int n,
+	Fanout_proc proc, void *arg )
+{
+	int fd;
+
+	DEBUG1("Run_fanout: doing %d in process", n );
+	fd = Make_temp_fd( 0 );
+	(proc)( n, fd, arg );
+	if( lseek( fd, 0, SEEK_SET ) == -1 ){
+		logerr_die(LOG_INFO, "Run_fanout: lseek failed" );
+	}
+	job->fd = fd;
+	while( !Read_fanout( job ) );
+	close( fd );
+	job->fd = -1;
+}
+
+/*
+ * read the output from a worker
+ *  returns: 1 on EOF
+ */
+
+static int Read_fanout( struct fanout_job *job )
+{
+	int len;
+
+	if( job->max - job->len < LARGEBUFFER ){
+		job->max += LARGEBUFFER + job->max/2;
+		job->output = realloc_or_die( job->output, job->max+1,
+			__FILE__,__LINE__ );
+	}
+	len = ok_read( job->fd, job->output + job->len, job->max - job->len );
+	if( len <= 0 ){
+		return( 1 );
+	}
+	job->len += len;
+	job->output[job->len] = 0;
+	return( 0 );
+}
+
+/*
+ * close the output channel and wait for the worker
+ */
+
+static void Finish_fanout( struct fanout_job *job )
+{
+	plp_status_t procstatus;
+
+	if( job->fd >= 0 ) close( job->fd );
+	job->fd = -1;
+	if( job->pid > 0 ){
+		plp_waitpid( job->pid, &procstatus, 0 );
+		DEBUG2("Finish_fanout: pid %ld, status '%s'",
+			(long)job->pid, Decode_status(&procstatus) );
+	}
+	job->pid = 0;
+}
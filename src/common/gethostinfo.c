@@ -17,8 +17,10 @@
  ********************************************************************/
 
 #include "lp.h"
+#include "fileopen.h"
 #include "gethostinfo.h"
 #include "linksupport.h"
+#include "lockfile.h"
 #include "getqueue.h"
 #include "globmatch.h"
 #if defined(HAVE_ARPA_NAMESER_H)
@@ -27,6 +29,10 @@
 #if defined(HAVE_RESOLV_H)
 # include <resolv.h>
 #endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define DNS_CACHE_SUPPORTED 1
+#endif
 /**** ENDINCLUDE ****/
 
 #ifndef MAXHOSTNAMELEN
@@ -36,6 +42,14 @@
 /* prototypes of forward-declarations */
 static char *Fixup_fqdn( const char *shorthost, struct host_information *info,
 	struct hostent *host_ent );
+static int Dns_cache_lookup( struct host_information *info, int kind,
+	int family, const char *key, int keylen );
+static void Dns_cache_store( struct host_information *info, int kind,
+	int family, const char *key, int keylen );
+
+/* kinds of dns cache entries */
+#define DNS_BYNAME 1
+#define DNS_BYADDR 2
 
 static void Clear_host_information( struct host_information *info )
 {
@@ -102,6 +116,11 @@ char *Find_fqdn( struct host_information *info, const char *shorthost )
 		fatal(LOG_ALERT, "Find_fqdn: hostname too long, HACKER ALERT '%s'",
 			shorthost );
 	}
+	switch( Dns_cache_lookup( info, DNS_BYNAME, AF_Protocol(),
+		shorthost, safestrlen(shorthost) ) ){
+	case 1: return( info->fqdn );
+	case 0: return( 0 );
+	}
 #if defined(HAVE_GETHOSTBYNAME2)
 	if( host_ent == 0 ){
 		host_ent = gethostbyname2( shorthost, AF_Protocol() );
@@ -114,9 +133,14 @@ char *Find_fqdn( struct host_information *info, const char *shorthost )
 	}
 	if( host_ent == 0 ){
 		DEBUG3( "Find_fqdn: no entry for host '%s'", shorthost );
+		Dns_cache_store( 0, DNS_BYNAME, AF_Protocol(),
+			shorthost, safestrlen(shorthost) );
 		return( 0 );
 	}
-	return( Fixup_fqdn( shorthost, info, host_ent) );
+	Fixup_fqdn( shorthost, info, host_ent);
+	Dns_cache_store( info, DNS_BYNAME, AF_Protocol(),
+		shorthost, safestrlen(shorthost) );
+	return( info->fqdn );
 }
 
 static char *Fixup_fqdn( const char *shorthost, struct host_information *info,
@@ -224,6 +248,358 @@ static char *Fixup_fqdn( const char *shorthost, struct host_information *info,
 	return(fqdn);
 }
 
+/***************************************************************************
+ * Host information cache
+ *
+ * A host name or address lookup can take seconds when the name
+ * servers are slow,  and lpd does one for every connection in the
+ * forked server process,  so nothing was remembered between them.
+ * The results of Find_fqdn() and Get_remote_hostbyaddr() lookups are
+ * kept in the dns_cache file,  which is memory mapped by lpd and the
+ * client programs.  The file is a hash table of fixed size entries
+ * keyed by the host name or address and the address family.  Failed
+ * lookups are kept for dns_cache_negative_ttl seconds,  host
+ * information for dns_cache_ttl seconds.
+ *
+ * As with the queue status snapshot (see getqueue.c),  readers do not
+ * lock the file:  each entry has a seq counter that is odd while the
+ * entry is being written,  and readers copy the entry and check that
+ * seq was even and did not change.  Writers lock the file.  Only lpd
+ * writes the file;  the client programs just read it.  The mapping is
+ * inherited by the forked server processes,  and is made again when
+ * the file has been replaced.  lpd creates the file as root when it
+ * starts and gives it to the daemon user,  as the spool directories
+ * are,  so that it can be updated after lpd has given up root.
+ ***************************************************************************/
+
+#define DNS_CACHE_MAGIC "LPRdns01"
+#define DNS_CACHE_SLOTS 1021	/* entries in the hash table */
+#define DNS_CACHE_PROBE 8		/* entries checked for a key */
+#define DNS_CACHE_KEY 72		/* Find_fqdn() allows 64 character names */
+#define DNS_CACHE_DATA 1024		/* host names and addresses */
+#define DNS_CACHE_ADDR 16		/* largest address length */
+
+struct dns_cache_header {
+	char magic[8];
+	int slots;			/* entries that follow the header */
+	int entry_size;		/* sizeof(struct dns_cache_entry) */
+};
+
+struct dns_cache_entry {
+	int seq;			/* odd while the entry is being written */
+	int kind;			/* DNS_BYNAME or DNS_BYADDR, 0 if unused */
+	int family;			/* address family of the lookup */
+	int keylen;
+	time_t expires;
+	int found;			/* 0 if the lookup failed */
+	int h_addrtype, h_length;
+	int names, addrs;	/* host names and addresses in data */
+	int datalen;
+	char key[DNS_CACHE_KEY];
+	char data[DNS_CACHE_DATA];	/* fqdn and host names, then addresses */
+};
+
+#define DNS_CACHE_SIZE ((int)(sizeof(struct dns_cache_header) \
+	+ DNS_CACHE_SLOTS * sizeof(struct dns_cache_entry)))
+
+#if defined(DNS_CACHE_SUPPORTED)
+static char *Dns_cache_path;	/* file that is mapped */
+static ino_t Dns_cache_ino;
+static struct dns_cache_header *Dns_cache_map;
+
+static void Dns_cache_unmap( void )
+{
+	if( Dns_cache_map ){
+		munmap( (void *)Dns_cache_map, DNS_CACHE_SIZE );
+		Dns_cache_map = 0;
+	}
+	free( Dns_cache_path ); Dns_cache_path = 0;
+}
+
+static int Dns_cache_header_ok( struct dns_cache_header *header )
+{
+	return( !memcmp( header->magic, DNS_CACHE_MAGIC, sizeof(header->magic) )
+		&& header->slots == DNS_CACHE_SLOTS
+		&& header->entry_size == (int)sizeof(struct dns_cache_entry) );
+}
+
+/*
+ * struct dns_cache_entry *Dns_cache_entries( void )
+ *  map the dns_cache file if it is not mapped yet
+ *  returns: the entries,  0 if there is no cache
+ */
+
+static struct dns_cache_entry *Dns_cache_entries( void )
+{
+	struct stat statb;
+	void *p;
+	int fd;
+
+	if( ISNULL(Dns_cache_DYN) ) return( 0 );
+	if( Dns_cache_map && (safestrcmp( Dns_cache_path, Dns_cache_DYN )
+		|| stat( Dns_cache_DYN, &statb ) || statb.st_ino != Dns_cache_ino) ){
+		/* the path changed or the file has been replaced */
+		Dns_cache_unmap();
+	}
+	if( Dns_cache_map == 0 ){
+		if( (fd = Checkread( Dns_cache_DYN, &statb )) < 0 ){
+			DEBUG3("Dns_cache_entries: no cache '%s'", Dns_cache_DYN );
+			return( 0 );
+		}
+		if( statb.st_size >= DNS_CACHE_SIZE
+			&& (p = mmap( 0, DNS_CACHE_SIZE, PROT_READ, MAP_SHARED, fd, 0 ))
+				!= MAP_FAILED ){
+			Dns_cache_map = (struct dns_cache_header *)p;
+			Dns_cache_path = safestrdup( Dns_cache_DYN,__FILE__,__LINE__);
+			Dns_cache_ino = statb.st_ino;
+		}
+		close( fd );
+		if( Dns_cache_map == 0 ) return( 0 );
+	}
+	if( !Dns_cache_header_ok( Dns_cache_map ) ){
+		DEBUG3("Dns_cache_entries: '%s' bad format", Dns_cache_DYN );
+		return( 0 );
+	}
+	return( (struct dns_cache_entry *)(Dns_cache_map+1) );
+}
+
+static unsigned int Dns_cache_hash( int kind, int family,
+	const char *key, int keylen )
+{
+	unsigned int hash = kind * 31 + family;
+	int i;
+	for( i = 0; i < keylen; ++i ){
+		hash = hash * 33 + ((unsigned char *)key)[i];
+	}
+	return( hash % DNS_CACHE_SLOTS );
+}
+
+/*
+ * int Dns_cache_unpack( struct host_information *info,
+ *  struct dns_cache_entry *entry )
+ *  put the host information from the entry into info
+ *  returns: 0 if the entry is good, -1 otherwise
+ */
+
+static int Dns_cache_unpack( struct host_information *info,
+	struct dns_cache_entry *entry )
+{
+	char *s, *end, *addr;
+	int i;
+
+	if( entry->datalen < 0 || entry->datalen > DNS_CACHE_DATA
+		|| entry->names < 1 || entry->addrs < 0
+		|| entry->h_length <= 0 || entry->h_length > DNS_CACHE_ADDR ){
+		return( -1 );
+	}
+	end = entry->data + entry->datalen;
+	for( s = entry->data, i = 0; i <= entry->names; ++i ){
+		if( s >= end || !(s = memchr( s, 0, end - s )) ) return( -1 );
+		++s;
+	}
+	if( end - s != entry->addrs * entry->h_length ) return( -1 );
+
+	info->h_addrtype = entry->h_addrtype;
+	info->h_length = entry->h_length;
+	s = entry->data;
+	info->fqdn = safestrdup(s,__FILE__,__LINE__);
+	info->shorthost = safestrdup(s,__FILE__,__LINE__);
+	if( (s = safestrchr(info->shorthost,'.')) ) *s = 0;
+	s = entry->data + strlen(entry->data) + 1;
+	for( i = 0; i < entry->names; ++i ){
+		Add_line_list(&info->host_names,s,0,0,0 );
+		s += strlen(s) + 1;
+	}
+	for( i = 0; i < entry->addrs; ++i ){
+		addr = malloc_or_die(info->h_length,__FILE__,__LINE__);
+		memcpy( addr, s, info->h_length );
+		s += info->h_length;
+		Check_max( &info->h_addr_list, 2 );
+		info->h_addr_list.list[ info->h_addr_list.count++ ] = addr;
+		info->h_addr_list.list[ info->h_addr_list.count ] = 0;
+	}
+	return( 0 );
+}
+#endif
+
+/***************************************************************************
+ * int Dns_cache_lookup( struct host_information *info, int kind,
+ *   int family, const char *key, int keylen )
+ *  look up a host name (DNS_BYNAME) or address (DNS_BYADDR) in the cache
+ *  returns: 1 if found, and info has the host information
+ *           0 if the lookup is known to fail
+ *          -1 if it is not in the cache
+ ***************************************************************************/
+
+static int Dns_cache_lookup( struct host_information *info, int kind,
+	int family, const char *key, int keylen )
+{
+	int status = -1;
+#if defined(DNS_CACHE_SUPPORTED)
+	struct dns_cache_entry *entries, *e, entry;
+	unsigned int hash;
+	int i, tries, seq;
+	time_t now;
+
+	if( keylen <= 0 || keylen > DNS_CACHE_KEY
+		|| (entries = Dns_cache_entries()) == 0 ){
+		return( -1 );
+	}
+	now = time( (void *)0 );
+	hash = Dns_cache_hash( kind, family, key, keylen );
+	for( i = 0; i < DNS_CACHE_PROBE; ++i ){
+		e = &entries[(hash + i) % DNS_CACHE_SLOTS];
+		if( e->kind != kind || e->keylen != keylen ) continue;
+		for( tries = 0; tries < 10; ++tries ){
+			seq = e->seq;
+			Memory_barrier();
+			if( seq & 1 ) continue;
+			memcpy( &entry, e, sizeof(entry) );
+			Memory_barrier();
+			if( seq == e->seq ) break;
+		}
+		if( tries >= 10 || entry.kind != kind || entry.family != family
+			|| entry.keylen != keylen || memcmp( entry.key, key, keylen ) ){
+			continue;
+		}
+		if( entry.expires > now ){
+			if( !entry.found ){
+				status = 0;
+			} else if( Dns_cache_unpack( info, &entry ) == 0 ){
+				status = 1;
+			}
+		}
+		break;
+	}
+	DEBUG3("Dns_cache_lookup: kind %d, family %d, status %d%s%s",
+		kind, family, status, status == 1 ? ", fqdn " : "",
+		status == 1 ? info->fqdn : "" );
+	if( status == 1 && DEBUGL4 ) Dump_host_information( "Dns_cache_lookup", info );
+#endif
+	return( status );
+}
+
+/***************************************************************************
+ * void Dns_cache_store( struct host_information *info, int kind,
+ *   int family, const char *key, int keylen )
+ *  save the result of a lookup in the cache;  info is 0 if it failed
+ ***************************************************************************/
+
+static void Dns_cache_store( struct host_information *info, int kind,
+	int family, const char *key, int keylen )
+{
+#if defined(DNS_CACHE_SUPPORTED)
+	struct dns_cache_entry entry, *entries, *e, *use;
+	struct dns_cache_header *map;
+	struct stat statb;
+	char *s;
+	int fd, i, len, ttl, seq;
+	time_t now;
+
+	ttl = info ? Dns_cache_ttl_DYN : Dns_cache_negative_ttl_DYN;
+	if( !Is_server || ISNULL(Dns_cache_DYN) || ttl <= 0
+		|| keylen <= 0 || keylen > DNS_CACHE_KEY ){
+		return;
+	}
+	now = time( (void *)0 );
+	memset( &entry, 0, sizeof(entry) );
+	entry.kind = kind;
+	entry.family = family;
+	entry.keylen = keylen;
+	memcpy( entry.key, key, keylen );
+	entry.expires = now + ttl;
+	if( info ){
+		if( info->h_length <= 0 || info->h_length > DNS_CACHE_ADDR ) return;
+		entry.found = 1;
+		entry.h_addrtype = info->h_addrtype;
+		entry.h_length = info->h_length;
+		entry.names = info->host_names.count;
+		entry.addrs = info->h_addr_list.count;
+		len = safestrlen(info->fqdn) + 1 + entry.addrs * info->h_length;
+		for( i = 0; i < info->host_names.count; ++i ){
+			len += safestrlen(info->host_names.list[i]) + 1;
+		}
+		if( entry.names < 1 || len > DNS_CACHE_DATA ){
+			DEBUG3("Dns_cache_store: '%s' does not fit", info->fqdn );
+			return;
+		}
+		s = entry.data;
+		len = safestrlen(info->fqdn) + 1;
+		memcpy( s, info->fqdn, len ); s += len;
+		for( i = 0; i < info->host_names.count; ++i ){
+			len = safestrlen(info->host_names.list[i]) + 1;
+			memcpy( s, info->host_names.list[i], len ); s += len;
+		}
+		for( i = 0; i < info->h_addr_list.count; ++i ){
+			memcpy( s, info->h_addr_list.list[i], info->h_length );
+			s += info->h_length;
+		}
+		entry.datalen = s - entry.data;
+	}
+
+	if( (fd = Checkwrite( Dns_cache_DYN, &statb, O_RDWR, 1, 0 )) < 0 ){
+		return;
+	}
+	if( Do_lock( fd, 0 ) || fstat( fd, &statb ) ){
+		DEBUG3("Dns_cache_store: '%s' being updated by another process",
+			Dns_cache_DYN );
+		close( fd );
+		return;
+	}
+	if( Dns_cache_map && Dns_cache_ino != statb.st_ino ){
+		/* the file has been replaced */
+		Dns_cache_unmap();
+	}
+	if( statb.st_size < DNS_CACHE_SIZE
+		&& (ftruncate( fd, DNS_CACHE_SIZE ) || fchmod( fd, 0644 )) ){
+		logerr(LOG_INFO, "Dns_cache_store: cannot extend '%s'", Dns_cache_DYN );
+		close( fd );
+		return;
+	}
+	map = (struct dns_cache_header *)mmap( 0, DNS_CACHE_SIZE,
+		PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( (void *)map == MAP_FAILED ){
+		DEBUG1("Dns_cache_store: mmap of '%s' failed - %s",
+			Dns_cache_DYN, Errormsg(errno) );
+		return;
+	}
+	if( !Dns_cache_header_ok( map ) ){
+		memset( (void *)map, 0, DNS_CACHE_SIZE );
+		memcpy( map->magic, DNS_CACHE_MAGIC, sizeof(map->magic) );
+		map->slots = DNS_CACHE_SLOTS;
+		map->entry_size = sizeof(struct dns_cache_entry);
+	}
+	entries = (struct dns_cache_entry *)(map+1);
+
+	/* use the entry for the key, an unused or expired one, or the oldest */
+	use = 0;
+	i = Dns_cache_hash( kind, family, key, keylen );
+	for( len = 0; len < DNS_CACHE_PROBE; ++len ){
+		e = &entries[(i + len) % DNS_CACHE_SLOTS];
+		if( e->kind == kind && e->family == family && e->keylen == keylen
+			&& !memcmp( e->key, key, keylen ) ){
+			use = e;
+			break;
+		}
+		if( use == 0 || (use->kind && use->expires > now
+			&& (e->kind == 0 || e->expires < use->expires)) ){
+			use = e;
+		}
+	}
+	seq = use->seq | 1;
+	use->seq = seq;
+	Memory_barrier();
+	entry.seq = seq;
+	memcpy( use, &entry, sizeof(entry) );
+	Memory_barrier();
+	use->seq = seq + 1;
+	munmap( (void *)map, DNS_CACHE_SIZE );
+	DEBUG3("Dns_cache_store: kind %d, family %d, found %d, entry %d",
+		kind, family, entry.found, (int)(use - entries) );
+#endif
+}
+
 /***************************************************************************
  * char *Get_local_host()
  * Get the fully-qualified hostname of the local host.
@@ -348,11 +724,22 @@ static char *Get_hostinfo_byaddr( struct host_information *info,
 		fatal(LOG_ERR, "Get_remote_hostbyaddr: bad family '%d'",
 			sinaddr->sa_family);
 	}
+	if( !addr_only ){
+		switch( Dns_cache_lookup( info, DNS_BYADDR, sinaddr->sa_family,
+			addr, len ) ){
+		case 1: return( info->fqdn );
+		case 0: addr_only = 1; break;
+		}
+	}
 	if( !addr_only ){
 		host_ent = gethostbyaddr( addr, len, sinaddr->sa_family );
+		if( host_ent == 0 ){
+			Dns_cache_store( 0, DNS_BYADDR, sinaddr->sa_family, addr, len );
+		}
 	}
 	if( host_ent ){
 		fqdn = Fixup_fqdn( host_ent->h_name, info, host_ent );
+		Dns_cache_store( info, DNS_BYADDR, sinaddr->sa_family, addr, len );
 	} else {
 		/* We will need to create a dummy record. - no host */
 		info->h_addrtype = sinaddr->sa_family;
@@ -470,7 +857,7 @@ void Dump_host_information( const char *title,  struct host_information *info )
  *		form address and mask from string
  *      with the format:  IPADDR/MASK, mask is x.x.x.x or n (length)
  ***************************************************************************/
-static int form_addr_and_mask(char *v, char *addr,char *mask,
+int form_addr_and_mask(char *v, char *addr,char *mask,
 	int addrlen, int family )
 {
 	char *s, *t;
@@ -550,7 +937,7 @@ static int form_addr_and_mask(char *v, char *addr,char *mask,
  * do a masked string compare
  */
 
-static int cmp_ip_addr( const char *h, const char *a, const char *m, int len )
+int cmp_ip_addr( const char *h, const char *a, const char *m, int len )
 {
     int match = 0, i;
 
@@ -22,6 +22,9 @@
  * pointers to this list,  but use indexes instead.
  ***************************************************************************/
 
+#if !defined(_GNU_SOURCE)
+# define _GNU_SOURCE 1	/* syncfs() */
+#endif
 #include "lp.h"
 #include "child.h"
 #include "errorcodes.h"
@@ -35,6 +38,11 @@
 #include "lockfile.h"
 #include "merge.h"
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define QUEUE_SNAPSHOT_SUPPORTED 1
+#endif
+
 #if defined(USER_INCLUDE)
 # include USER_INCLUDE
 #else
@@ -49,6 +57,25 @@
 /* prototypes of functions only used internally */
 static void Append_Z_value( struct job *job, char *s );
 static void Set_job_ticket_datafile_info( struct job *job );
+static void Get_job_ticket_datafiles( struct job *job );
+static char *Make_job_ticket_binary( struct job *job, int *len );
+static int Is_binary_job_ticket( const char *image, int len );
+static int Split_job_ticket_image( struct line_list *info,
+	const char *image, int len, const char *job_ticket_name );
+static char *Get_job_ticket_image( int fd, int *len );
+static int Write_job_ticket_binary( int fd, const char *image, int len );
+static void Read_queue_index( void );
+static void Write_queue_index( void );
+static int Find_queue_index( const char *job_ticket_name );
+static void Get_job_ticket_indexed( struct job *job, char *job_ticket_name,
+	char *seen, struct line_list *new_index );
+static int indexcmp(  const void *left, const void *right, const void *p);
+
+/* job ticket file index, see the Queue index commentary below */
+#define QUEUE_INDEX_MAGIC "#LPRng queue index 1"
+static struct line_list Queue_index;
+static char *Queue_index_dir;
+static int Queue_index_changed;
 static int ordercomp(  const void *left, const void *right, const void *orderp);
 
 /*
@@ -71,6 +98,10 @@ int Scan_queue( struct line_list *spool_control,
 	int remove_prefix_len = safestrlen( remove_prefix );
 	int remove_suffix_len = safestrlen( remove_suffix );
 	struct job job;
+	struct line_list new_index;
+	struct line_arena *arena;
+	char *seen = 0;
+	int use_index = !ISNULL(Queue_index_file_DYN);
 
 	c = printable = held = move = error = done = 0;
 	Init_job( &job );
@@ -81,12 +112,22 @@ int Scan_queue( struct line_list *spool_control,
 	if( pdone ) *pdone = 0;
 
 	Free_line_list(sort_order);
+	Init_line_list(&new_index);
+	/* the jobs are read one at a time into the same storage */
+	arena = Make_line_arena();
 
 	if( !(dir = opendir( "." )) ){
+		Free_line_arena( arena );
 		logerr(LOG_INFO, "Scan_queue: cannot open '.'" );
 		return( 1 );
 	}
 
+	if( use_index ){
+		Read_queue_index();
+		seen = malloc_or_die( Queue_index.count+1,__FILE__,__LINE__);
+		memset( seen, 0, Queue_index.count+1 );
+	}
+
 	job_ticket_name = 0;
 	while( (d = readdir(dir)) ){
 		job_ticket_name = d->d_name;
@@ -110,9 +151,15 @@ int Scan_queue( struct line_list *spool_control,
 		DEBUG2("Scan_queue: processing file '%s'", job_ticket_name );
 
 		Free_job( &job );
+		Reset_line_arena( arena );
+		Use_line_arena( &job.info, arena );
 
 		/* read the hf file and get the information */
-		Get_job_ticket_file( 0, &job, job_ticket_name );
+		if( use_index ){
+			Get_job_ticket_indexed( &job, job_ticket_name, seen, &new_index );
+		} else {
+			Get_job_ticket_file( 0, &job, job_ticket_name );
+		}
 		if(DEBUGL3)Dump_line_list("Scan_queue: hf", &job.info );
 		if( job.info.count == 0 ){
 			continue;
@@ -140,6 +187,30 @@ int Scan_queue( struct line_list *spool_control,
 	closedir(dir);
 
 	Free_job(&job);
+	Free_line_arena( arena );
+
+	if( use_index ){
+		/* discard the entries for jobs that are no longer in the queue */
+		for( c = 0; c < Queue_index.count; ++c ){
+			if( !seen[c] ){
+				free( Queue_index.list[c] );
+				Queue_index_changed = 1;
+			}
+			Queue_index.list[c] = 0;
+		}
+		Queue_index.count = 0;
+		Free_line_list( &Queue_index );
+		free( seen ); seen = 0;
+		Queue_index = new_index;
+		if( Mergesort( Queue_index.list, Queue_index.count,
+			sizeof( Queue_index.list[0] ), indexcmp, 0 ) ){
+			Errorcode = JABORT;
+			logerr_die(LOG_ERR, "Scan_queue: Mergesort failed" );
+		}
+		if( Queue_index_changed ){
+			Write_queue_index();
+		}
+	}
 
 	if(DEBUGL5){
 		LOGDEBUG("Scan_queue: final values" );
@@ -155,6 +226,494 @@ int Scan_queue( struct line_list *spool_control,
 	return(0);
 }
 
+/*
+ * Queue index
+ *
+ *  Scanning a queue with a large number of jobs requires opening,
+ *  locking and reading every job ticket (hf) file.  To avoid this we
+ *  keep the job ticket file contents in an index file in the spool
+ *  directory (Queue_index_file_DYN), and only read the job ticket files
+ *  whose modification time or size has changed since the index was
+ *  written.  The index is also kept in memory so that a process that
+ *  rescans the queue (i.e. the queue server) does not need to reread it.
+ *
+ *  Each index entry has the form:
+ *     hfname=mtime size\n<job ticket file contents>
+ *  The entries are sorted by hfname.  An mtime of 0 forces the job
+ *  ticket file to be reread;  we use this when the file was modified
+ *  in the same second as we read it, as the mtime would not show a
+ *  further change.
+ *
+ *  The index file is:
+ *    QUEUE_INDEX_MAGIC\n
+ *    length\n<entry> (repeated)
+ */
+
+static int indexcmp(  const void *left, const void *right, const void *p)
+{
+	const char *l = *(const char **)left;
+	const char *r = *(const char **)right;
+	int cl, cr;
+	for( ; (cl = cval(l)) == (cr = cval(r)) && cl && cl != '='; ++l, ++r );
+	if( cl == '=' ) cl = 0;
+	if( cr == '=' ) cr = 0;
+	return( cl - cr );
+}
+
+static int Find_queue_index( const char *job_ticket_name )
+{
+	int bot = 0, top = Queue_index.count-1, mid, cmp;
+	const char *key = job_ticket_name;
+	while( bot <= top ){
+		mid = (top+bot)/2;
+		cmp = indexcmp( &key, &Queue_index.list[mid], 0 );
+		if( cmp == 0 ) return( mid );
+		if( cmp > 0 ){
+			bot = mid+1;
+		} else {
+			top = mid-1;
+		}
+	}
+	return( -1 );
+}
+
+static void Read_queue_index( void )
+{
+	char *image, *s, *end, *t, *entry;
+	int len, n;
+
+	if( Queue_index_dir && !safestrcmp( Queue_index_dir, Spool_dir_DYN ) ){
+		DEBUG3("Read_queue_index: using cached index for '%s', %d entries",
+			Queue_index_dir, Queue_index.count );
+		return;
+	}
+	Free_line_list( &Queue_index );
+	Set_DYN( &Queue_index_dir, Spool_dir_DYN );
+	Queue_index_changed = 0;
+
+	image = Get_file_image( Queue_index_file_DYN, 0 );
+	len = safestrlen(QUEUE_INDEX_MAGIC);
+	if( image == 0 || strncmp( image, QUEUE_INDEX_MAGIC, len )
+		|| image[len] != '\n' ){
+		DEBUG1("Read_queue_index: no index in '%s'", Queue_index_file_DYN );
+		Queue_index_changed = 1;
+		free(image);
+		return;
+	}
+	end = image + safestrlen(image);
+	for( s = image + len + 1; s < end; s = t + n ){
+		n = strtol( s, &t, 10 );
+		if( t == s || *t++ != '\n' || n <= 0 || n > end - t
+			|| !memchr( t, '=', n ) ){
+			DEBUG1("Read_queue_index: bad entry at offset %d",
+				(int)(s - image) );
+			Queue_index_changed = 1;
+			break;
+		}
+		entry = malloc_or_die( n+1,__FILE__,__LINE__);
+		memcpy( entry, t, n );
+		entry[n] = 0;
+		Check_max( &Queue_index, 1 );
+		Queue_index.list[Queue_index.count++] = entry;
+	}
+	free(image);
+	if( Mergesort( Queue_index.list, Queue_index.count,
+		sizeof( Queue_index.list[0] ), indexcmp, 0 ) ){
+		Errorcode = JABORT;
+		logerr_die(LOG_ERR, "Read_queue_index: Mergesort failed" );
+	}
+	DEBUG1("Read_queue_index: '%s' has %d entries",
+		Queue_index_file_DYN, Queue_index.count );
+}
+
+/*
+ * we write the index to a temporary file and then rename it;
+ *  if somebody else is writing it we let them do it.
+ */
+
+static void Write_queue_index( void )
+{
+	char tempfile[SMALLBUFFER], header[32];
+	char *image, *s;
+	struct stat statb, tempb;
+	int fd, i, n, len;
+
+	plp_snprintf( tempfile, sizeof(tempfile), "%s.new", Queue_index_file_DYN );
+	if( (fd = Checkwrite( tempfile, &statb, O_RDWR, 1, 0 )) < 0 ){
+		DEBUG1("Write_queue_index: cannot open '%s' - %s",
+			tempfile, Errormsg(errno) );
+		return;
+	}
+	if( Do_lock( fd, 0 ) || stat( tempfile, &tempb )
+		|| tempb.st_ino != statb.st_ino || tempb.st_dev != statb.st_dev ){
+		DEBUG1("Write_queue_index: '%s' being updated by another process",
+			tempfile );
+		close(fd);
+		return;
+	}
+
+	len = safestrlen(QUEUE_INDEX_MAGIC) + 1;
+	for( i = 0; i < Queue_index.count; ++i ){
+		len += safestrlen(Queue_index.list[i]) + sizeof(header);
+	}
+	image = malloc_or_die( len+1,__FILE__,__LINE__);
+	plp_snprintf( image, len+1, "%s\n", QUEUE_INDEX_MAGIC );
+	s = image + safestrlen(image);
+	for( i = 0; i < Queue_index.count; ++i ){
+		n = safestrlen(Queue_index.list[i]);
+		plp_snprintf( header, sizeof(header), "%d\n", n );
+		strcpy( s, header );
+		s += safestrlen(header);
+		memcpy( s, Queue_index.list[i], n );
+		s += n;
+	}
+	*s = 0;
+
+	if( ftruncate( fd, 0 ) || Write_fd_len( fd, image, s - image ) < 0 ){
+		logerr(LOG_INFO, "Write_queue_index: write to '%s' failed", tempfile );
+		unlink( tempfile );
+	} else if( rename( tempfile, Queue_index_file_DYN ) == -1 ){
+		logerr(LOG_INFO, "Write_queue_index: rename of '%s' to '%s' failed",
+			tempfile, Queue_index_file_DYN );
+		unlink( tempfile );
+	} else {
+		Queue_index_changed = 0;
+		DEBUG1("Write_queue_index: '%s' has %d entries, %d bytes",
+			Queue_index_file_DYN, Queue_index.count, (int)(s - image) );
+	}
+	close(fd);
+	free(image);
+}
+
+/*
+ * Get_job_ticket_indexed( struct job *job, char *job_ticket_name,
+ *   char *seen, struct line_list *new_index )
+ *
+ *  get the job ticket information from the queue index if the job ticket
+ *  file has not changed,  otherwise read the job ticket file.
+ *  The index entry is moved (or added) to the new_index list
+ *  and marked as seen in the current index.
+ */
+
+static void Get_job_ticket_indexed( struct job *job, char *job_ticket_name,
+	char *seen, struct line_list *new_index )
+{
+	struct stat statb;
+	char header[64];
+	char *s, *image = 0;
+	long mtime, size;
+	int fd, mid, len = 0;
+
+	if( stat( job_ticket_name, &statb ) ){
+		DEBUG1("Get_job_ticket_indexed: cannot stat '%s'", job_ticket_name );
+		return;
+	}
+	if( (mid = Find_queue_index( job_ticket_name )) >= 0 ){
+		s = strchr( Queue_index.list[mid], '=' ) + 1;
+		mtime = strtol( s, &s, 10 );
+		size = strtol( s, &s, 10 );
+		if( mtime && mtime == (long)statb.st_mtime
+			&& size == (long)statb.st_size && *s == '\n' ){
+			DEBUG3("Get_job_ticket_indexed: using index for '%s'", job_ticket_name );
+			Split( &job->info, s+1, Line_ends, 1, Option_value_sep,1,1,1,0);
+			Get_job_ticket_datafiles( job );
+			seen[mid] = 1;
+			Check_max( new_index, 1 );
+			new_index->list[new_index->count++] = Queue_index.list[mid];
+			return;
+		}
+	}
+
+	DEBUG3("Get_job_ticket_indexed: reading '%s'", job_ticket_name );
+	Queue_index_changed = 1;
+	if( (fd = Checkwrite( job_ticket_name, &statb, O_RDWR, 0, 0 )) < 0 ){
+		return;
+	}
+	if( !Do_lock( fd, 1 ) ){
+		image = Get_job_ticket_image( fd, &len );
+		if( fstat( fd, &statb ) ){
+			logerr_die(LOG_ERR, "Get_job_ticket_indexed: fstat '%s' failed",
+				job_ticket_name );
+		}
+	}
+	close(fd);
+	if( image == 0 ){
+		return;
+	}
+	Split_job_ticket_image( &job->info, image, len, job_ticket_name );
+	if( Is_binary_job_ticket( image, len ) ){
+		/* the index has the text form */
+		free(image);
+		image = Join_line_list( &job->info, "\n" );
+	}
+	Get_job_ticket_datafiles( job );
+	if(DEBUGL2)Dump_job("Get_job_ticket_indexed",job);
+
+	/* do not trust the mtime if the file may still be changing */
+	mtime = statb.st_mtime;
+	if( mtime >= time( (void *)0 ) - 1 ) mtime = 0;
+	plp_snprintf( header, sizeof(header), "=%ld %ld\n",
+		mtime, (long)statb.st_size );
+	Check_max( new_index, 1 );
+	new_index->list[new_index->count++] =
+		safestrdup3( job_ticket_name, header, image,__FILE__,__LINE__);
+	free(image);
+}
+
+/*
+ * Queue status snapshot
+ *
+ *  Reporting the queue status requires scanning the queue and reading
+ *  every job ticket.  To make lpq requests cheap, the queue server and
+ *  any lpd process that has scanned the queue to report status publish
+ *  the job status lines and job counts in a snapshot file in the spool
+ *  directory (Queue_snapshot_file_DYN).  lpd maps the snapshot file
+ *  and formats the status from it.
+ *
+ *  The snapshot file starts with a struct queue_snapshot header,
+ *  followed by the job status lines.  The header has two counters:
+ *   seq     - odd while the snapshot is being written.  Readers do not
+ *             lock the file;  they copy the snapshot and then check that
+ *             seq was even and has not changed.  Writers lock the file.
+ *   changes - incremented by Queue_status_changed() whenever a job or
+ *             the queue is modified,  with the file locked.  The writer
+ *             records the value that it read before it scanned the queue
+ *             in snap_changes; if they differ the snapshot is out of date.
+ *  The file is never made shorter, so a reader never has the mapped
+ *  file truncated under it.
+ */
+
+#define QUEUE_SNAPSHOT_MAGIC "LPRsnap2"
+#define QUEUE_SNAPSHOT_BLOCK 4096
+
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+/*
+ * map the first size bytes of the snapshot file
+ */
+static struct queue_snapshot *Map_queue_snapshot( int fd, int size, int writable )
+{
+	void *p;
+	p = mmap( 0, size, writable?(PROT_READ|PROT_WRITE):PROT_READ,
+		MAP_SHARED, fd, 0 );
+	if( p == MAP_FAILED ){
+		DEBUG1("Map_queue_snapshot: mmap of '%s' failed - %s",
+			Queue_snapshot_file_DYN, Errormsg(errno) );
+		return( 0 );
+	}
+	return( (struct queue_snapshot *)p );
+}
+#endif
+
+/*
+ * Queue_status_changed()
+ *  a job or the queue has been changed, so the cached lpq status and
+ *  the queue status snapshot are out of date
+ */
+
+void Queue_status_changed( void )
+{
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	struct queue_snapshot *snap;
+	struct stat statb;
+	int fd;
+#endif
+
+	if( Lpq_status_file_DYN ){
+		/* do not check to see if this works */
+		unlink(Lpq_status_file_DYN);
+	}
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	if( !Queue_snapshot_file_DYN
+		|| (fd = Checkwrite( Queue_snapshot_file_DYN, &statb, O_RDWR, 0, 0 )) < 0 ){
+		return;
+	}
+	if( statb.st_size >= (int)sizeof(*snap) && Do_lock( fd, 1 ) == 0
+		&& (snap = Map_queue_snapshot( fd, sizeof(*snap), 1 )) ){
+		++snap->changes;
+		DEBUG3("Queue_status_changed: changes now %d", snap->changes );
+		munmap( (void *)snap, sizeof(*snap) );
+	}
+	close(fd);
+#endif
+}
+
+/*
+ * int Begin_queue_snapshot( struct queue_snapshot *snap )
+ *  called before scanning the queue to make a snapshot;
+ *  creates the snapshot file if necessary and records the changes value
+ *  returns: 0 if a snapshot can be made, -1 otherwise
+ */
+
+int Begin_queue_snapshot( struct queue_snapshot *snap )
+{
+	int status = -1;
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	struct queue_snapshot *map;
+	struct stat statb;
+	int fd;
+
+	memset( snap, 0, sizeof(*snap) );
+	if( !Lpq_status_snapshot_DYN || !Queue_snapshot_file_DYN
+		|| (fd = Checkwrite( Queue_snapshot_file_DYN, &statb, O_RDWR, 1, 0 )) < 0 ){
+		return( -1 );
+	}
+	if( statb.st_size < QUEUE_SNAPSHOT_BLOCK && Do_lock( fd, 1 ) == 0
+		&& fstat( fd, &statb ) == 0 && statb.st_size < QUEUE_SNAPSHOT_BLOCK ){
+		/* new snapshot file, it has no valid snapshot yet */
+		if( ftruncate( fd, QUEUE_SNAPSHOT_BLOCK ) ){
+			logerr(LOG_INFO, "Begin_queue_snapshot: ftruncate '%s' failed",
+				Queue_snapshot_file_DYN );
+			close(fd);
+			return( -1 );
+		}
+		if( (map = Map_queue_snapshot( fd, sizeof(*map), 1 )) ){
+			memcpy( map->magic, QUEUE_SNAPSHOT_MAGIC, sizeof(map->magic) );
+			map->snap_changes = map->changes - 1;
+			munmap( (void *)map, sizeof(*map) );
+		}
+	}
+	if( (map = Map_queue_snapshot( fd, sizeof(*map), 0 )) ){
+		snap->snap_changes = map->changes;
+		munmap( (void *)map, sizeof(*map) );
+		status = 0;
+	}
+	close(fd);
+	DEBUG3("Begin_queue_snapshot: status %d, changes %d",
+		status, snap->snap_changes );
+#endif
+	return( status );
+}
+
+/*
+ * int Write_queue_snapshot( struct queue_snapshot *snap, const char *lines )
+ *  write the snapshot;  if another process is writing it we let them
+ *  returns: 0 if written
+ */
+
+int Write_queue_snapshot( struct queue_snapshot *snap, const char *lines )
+{
+	int status = -1;
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	struct queue_snapshot *map;
+	struct stat statb;
+	int fd, len, size;
+
+	if( !Lpq_status_snapshot_DYN || !Queue_snapshot_file_DYN
+		|| (fd = Checkwrite( Queue_snapshot_file_DYN, &statb, O_RDWR, 0, 0 )) < 0 ){
+		return( -1 );
+	}
+	if( Do_lock( fd, 0 ) || fstat( fd, &statb ) ){
+		DEBUG1("Write_queue_snapshot: '%s' being updated by another process",
+			Queue_snapshot_file_DYN );
+		close(fd);
+		return( -1 );
+	}
+	len = safestrlen(lines);
+	size = sizeof(*snap) + len + 1;
+	if( size > statb.st_size ){
+		size = (size/QUEUE_SNAPSHOT_BLOCK + 1) * QUEUE_SNAPSHOT_BLOCK;
+		if( ftruncate( fd, size ) ){
+			logerr(LOG_INFO, "Write_queue_snapshot: ftruncate '%s' failed",
+				Queue_snapshot_file_DYN );
+			close(fd);
+			return( -1 );
+		}
+	} else {
+		size = statb.st_size;
+	}
+	if( (map = Map_queue_snapshot( fd, size, 1 )) ){
+		++map->seq;
+		Memory_barrier();
+		memcpy( map->magic, QUEUE_SNAPSHOT_MAGIC, sizeof(map->magic) );
+		map->snap_changes = snap->snap_changes;
+		map->updated = time( (void *)0 );
+		map->format = snap->format;
+		map->jobs = snap->jobs;
+		map->printable = snap->printable;
+		map->held = snap->held;
+		map->move = snap->move;
+		map->matches = snap->matches;
+		map->total_held = snap->total_held;
+		map->total_move = snap->total_move;
+		map->removable = snap->removable;
+		map->oldest_removable = snap->oldest_removable;
+		map->len = len;
+		memcpy( (char *)(map+1), lines?lines:"", len+1 );
+		Memory_barrier();
+		++map->seq;
+		munmap( (void *)map, size );
+		status = 0;
+	}
+	close(fd);
+	DEBUG1("Write_queue_snapshot: status %d, changes %d, jobs %d, len %d",
+		status, snap->snap_changes, snap->jobs, len );
+#endif
+	return( status );
+}
+
+/*
+ * int Read_queue_snapshot( struct queue_snapshot *snap, char **lines )
+ *  get a copy of the snapshot and the job status lines
+ *  returns: 0 if the snapshot is current
+ *   *lines is set to malloc'd job status lines
+ */
+
+int Read_queue_snapshot( struct queue_snapshot *snap, char **lines )
+{
+	int status = -1;
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	struct queue_snapshot *map;
+	struct stat statb;
+	char *s = 0;
+	int fd, size, tries, seq;
+
+	*lines = 0;
+	if( !Lpq_status_snapshot_DYN || !Queue_snapshot_file_DYN
+		|| (fd = Checkread( Queue_snapshot_file_DYN, &statb )) < 0 ){
+		return( -1 );
+	}
+	size = statb.st_size;
+	if( size < (int)sizeof(*map) || !(map = Map_queue_snapshot( fd, size, 0 )) ){
+		close(fd);
+		return( -1 );
+	}
+	close(fd);
+	for( tries = 0; status && tries < 10; ++tries ){
+		seq = map->seq;
+		Memory_barrier();
+		if( seq & 1 ) continue;
+		memcpy( snap, map, sizeof(*snap) );
+		if( memcmp( snap->magic, QUEUE_SNAPSHOT_MAGIC, sizeof(snap->magic) )
+			|| snap->len < 0 || snap->len > size - (int)sizeof(*snap) - 1 ){
+			break;
+		}
+		s = realloc_or_die( s, snap->len+1,__FILE__,__LINE__);
+		memcpy( s, (char *)(map+1), snap->len );
+		s[snap->len] = 0;
+		Memory_barrier();
+		if( seq == map->seq ) status = 0;
+	}
+	munmap( (void *)map, size );
+	if( status == 0 && snap->snap_changes != snap->changes ){
+		DEBUG1("Read_queue_snapshot: out of date, changes %d, snapshot %d",
+			snap->changes, snap->snap_changes );
+		status = -1;
+	}
+	if( status == 0 && Lpq_status_stale_DYN
+		&& time( (void *)0 ) - snap->updated > Lpq_status_stale_DYN ){
+		DEBUG1("Read_queue_snapshot: stale" );
+		status = -1;
+	}
+	if( status ){
+		free(s);
+	} else {
+		*lines = s;
+	}
+	DEBUG1("Read_queue_snapshot: status %d", status );
+#endif
+	return( status );
+}
+
 /*
  * char *Get_fd_image( int fd, char *file )
  *  Get an image of a file from an fd
@@ -652,24 +1211,271 @@ char *Make_job_ticket_image( struct job *job )
 	return( outstr );
 }
 
+/*
+ * Binary job tickets
+ *
+ *  If binary_job_ticket is set the job ticket file is written as a
+ *  struct job_ticket_header followed by the job ticket lines:
+ *     int length; char line[length]; char nul;
+ *  The lines are written in the (sorted) order of the job->info list,
+ *  so they are added to the list as they are,  without any splitting
+ *  or sorting.
+ *
+ *  The job state values that change as the job is processed,  listed
+ *  in Job_ticket_fields,  are kept in the header as numbers rather
+ *  than as lines if they are in the form that Set_decimal_value() and
+ *  Set_flag_value() produce.  If only the job state and update time
+ *  of the job have changed we rewrite only the header.
+ *
+ *  Job ticket files are read in either form,  and the text form is
+ *  still made by Make_job_ticket_image() for the logger and lpq.
+ */
+
+#define JOB_TICKET_MAGIC "LPRngHF"
+#define JOB_TICKET_ORDER 0x01020304
+
+static const char **Job_ticket_fields[JOB_TICKET_FIELDS] = {
+	&ATTEMPT, &COPY_DONE, &DONE_TIME, &ERROR_TIME,
+	&HOLD_CLASS, &HOLD_TIME, &INCOMING_PID, &INCOMING_TIME,
+	&PRIORITY_TIME, &REMOVE_TIME, &SERVER, &START_TIME };
+
+/*
+ * find the header field for a key=value line and check that the
+ *  value will be the same when we print it from the header
+ */
+
+static int Job_ticket_field( const char *line, long *value, int *hex )
+{
+	char buffer[64];
+	const char *s;
+	char *end;
+	int i, len;
+
+	if( !(s = strchr( line, '=' )) ) return( -1 );
+	len = s - line;
+	for( i = 0; i < JOB_TICKET_FIELDS; ++i ){
+		if( !strncmp( line, *Job_ticket_fields[i], len )
+			&& (*Job_ticket_fields[i])[len] == 0 ) break;
+	}
+	if( i == JOB_TICKET_FIELDS ) return( -1 );
+	++s;
+	if( (*hex = (s[0] == '0' && s[1] == 'x')) ){
+		*value = strtoul( s+2, &end, 16 );
+		plp_snprintf( buffer, sizeof(buffer), "0x%lx", *value );
+	} else {
+		*value = strtol( s, &end, 10 );
+		plp_snprintf( buffer, sizeof(buffer), "%ld", *value );
+	}
+	if( strcmp( buffer, s ) ) return( -1 );
+	return( i );
+}
+
+static char *Make_job_ticket_binary( struct job *job, int *len )
+{
+	struct job_ticket_header header;
+	char *image, *s, *line;
+	int i, n, f, hex, size;
+	int openlen = safestrlen(OPENNAME);
+	int updatelen = safestrlen(UPDATE_TIME);
+	long value;
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, JOB_TICKET_MAGIC, sizeof(JOB_TICKET_MAGIC) );
+	header.order = JOB_TICKET_ORDER;
+	header.header_size = sizeof(header);
+
+	size = sizeof(header);
+	for( i = 0; i < job->info.count; ++i ){
+		size += safestrlen(job->info.list[i]) + sizeof(n) + 1;
+	}
+	image = malloc_or_die( size+1,__FILE__,__LINE__);
+	s = image + sizeof(header);
+	for( i = 0; i < job->info.count; ++i ){
+		line = job->info.list[i];
+		if( ISNULL(line) || safestrpbrk(line,Line_ends)
+			|| !safestrncasecmp(OPENNAME,line,openlen) ){
+			continue;
+		}
+		if( (f = Job_ticket_field( line, &value, &hex )) >= 0 ){
+			header.fields |= (1 << f);
+			if( hex ) header.hexfields |= (1 << f);
+			header.value[f] = value;
+			continue;
+		}
+		n = safestrlen(line);
+		if( !strncmp( line, UPDATE_TIME, updatelen ) && line[updatelen] == '='
+			&& n - updatelen - 1 < (int)sizeof(header.update_time) ){
+			strcpy( header.update_time, line+updatelen+1 );
+			continue;
+		}
+		memcpy( s, &n, sizeof(n) );
+		s += sizeof(n);
+		memcpy( s, line, n+1 );
+		s += n+1;
+		++header.records;
+	}
+	header.record_bytes = s - image - sizeof(header);
+	memcpy( image, &header, sizeof(header) );
+	*len = s - image;
+	return( image );
+}
+
+static int Is_binary_job_ticket( const char *image, int len )
+{
+	return( image && len >= (int)sizeof(struct job_ticket_header)
+		&& !memcmp( image, JOB_TICKET_MAGIC, sizeof(JOB_TICKET_MAGIC) ) );
+}
+
+/*
+ * Split_job_ticket_image( struct line_list *info, const char *image,
+ *   int len, const char *job_ticket_name )
+ *
+ *  add the job ticket lines from a text or binary job ticket file image
+ *  to the info list.  Returns nonzero if the binary image is damaged;
+ *  the info list is cleared.
+ */
+
+static int Split_job_ticket_image( struct line_list *info,
+	const char *image, int len, const char *job_ticket_name )
+{
+	struct job_ticket_header header;
+	char buffer[SMALLBUFFER];
+	const char *s, *end;
+	int i, n, append;
+
+	if( !Is_binary_job_ticket( image, len ) ){
+		Split( info, image, Line_ends, 1, Option_value_sep,1,1,1,0);
+		return( 0 );
+	}
+	memcpy( &header, image, sizeof(header) );
+	if( header.order != JOB_TICKET_ORDER
+		|| header.header_size != (int)sizeof(header)
+		|| header.record_bytes != len - (int)sizeof(header) ){
+		goto bad;
+	}
+	/* the lines are in sorted order */
+	append = (info->count == 0);
+	s = image + sizeof(header);
+	end = image + len;
+	for( i = 0; i < header.records; ++i ){
+		if( end - s < (int)sizeof(n) ) goto bad;
+		memcpy( &n, s, sizeof(n) );
+		s += sizeof(n);
+		if( n < 0 || end - s <= n || s[n] ) goto bad;
+		if( append ){
+			Add_line_list( info, s, 0, 0, 0 );
+		} else {
+			Add_line_list( info, s, Option_value_sep, 1, 1 );
+		}
+		s += n+1;
+	}
+	for( i = 0; i < JOB_TICKET_FIELDS; ++i ){
+		if( !(header.fields & (1 << i)) ) continue;
+		plp_snprintf( buffer, sizeof(buffer),
+			(header.hexfields & (1 << i)) ? "%s=0x%lx" : "%s=%ld",
+			*Job_ticket_fields[i], header.value[i] );
+		Add_line_list( info, buffer, Hash_value_sep, 1, 1 );
+	}
+	if( header.update_time[0] ){
+		header.update_time[sizeof(header.update_time)-1] = 0;
+		Set_str_value( info, UPDATE_TIME, header.update_time );
+	}
+	return( 0 );
+
+ bad:
+	logmsg(LOG_INFO, "Split_job_ticket_image: '%s' is damaged",
+		job_ticket_name );
+	Free_line_list( info );
+	return( 1 );
+}
+
+/*
+ * read a job ticket file image,  which may have nul characters
+ */
+
+static char *Get_job_ticket_image( int fd, int *len )
+{
+	char *s = 0;
+	char buffer[LARGEBUFFER];
+	int n;
+
+	*len = 0;
+	if( lseek(fd, 0, SEEK_SET) == -1 ){
+		Errorcode = JFAIL;
+		logerr_die(LOG_INFO, "Get_job_ticket_image: lseek failed" );
+	}
+	while( (n = ok_read(fd,buffer,sizeof(buffer))) > 0 ){
+		s = realloc_or_die(s,*len+n+1,__FILE__,__LINE__);
+		memcpy(s+*len,buffer,n);
+		*len += n;
+		s[*len] = 0;
+	}
+	DEBUG3("Get_job_ticket_image: fd %d, len %d", fd, *len );
+	return(s);
+}
+
+/*
+ * write a binary job ticket image to the locked job ticket file;
+ *  if the lines are the same as in the file we only write the header.
+ *  The file is opened with O_APPEND (see Checkwrite()),  so we turn
+ *  this off to write the header in place.
+ */
+
+static int Write_job_ticket_binary( int fd, const char *image, int len )
+{
+	char *old;
+	int oldlen, status = 0, mask = -1, n = len, inplace = 0;
+	int hlen = sizeof(struct job_ticket_header);
+
+	old = Get_job_ticket_image( fd, &oldlen );
+	if( oldlen == len && Is_binary_job_ticket( old, oldlen )
+		&& !memcmp( old+hlen, image+hlen, len-hlen )
+		&& (mask = fcntl( fd, F_GETFL, 0 )) != -1
+		&& fcntl( fd, F_SETFL, mask & ~O_APPEND ) != -1 ){
+		n = hlen;
+		inplace = 1;
+	}
+	free(old);
+	DEBUG4("Write_job_ticket_binary: writing %d of %d bytes", n, len );
+	if( lseek( fd, 0, SEEK_SET ) == -1 ){
+		logerr_die(LOG_ERR, "Write_job_ticket_binary: lseek failed" );
+	}
+	if( !inplace && ftruncate( fd, 0 ) ){
+		logerr_die(LOG_ERR, "Write_job_ticket_binary: ftruncate failed" );
+	}
+	if( Write_fd_len( fd, image, n ) < 0 ){
+		status = 1;
+	}
+	if( inplace && fcntl( fd, F_SETFL, mask ) == -1 ){
+		logerr_die(LOG_ERR, "Write_job_ticket_binary: fcntl F_SETFL failed" );
+	}
+	return( status );
+}
+
 /*
  * Write a job ticket file
  */
 
 int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int opened_fd )
 {
-	char *job_ticket_name, *outstr;
-	int status;
+	char *job_ticket_name, *outstr, *image;
+	int status, len = 0;
 	int fd = opened_fd;
 	struct stat statb;
 
 	status = 0;
-	outstr = 0;
+	outstr = image = 0;
 
 	Set_job_ticket_datafile_info( job );
 	if(DEBUGL4)Dump_job("Set_job_ticket_file - init",job);
 	Set_str_value(&job->info,UPDATE_TIME,Time_str(0,0));
-	outstr = Make_job_ticket_image( job );
+	if( Binary_job_ticket_DYN ){
+		image = Make_job_ticket_binary( job, &len );
+	}
+	/* the text form is still needed for the logger */
+	if( !image || Logger_fd > 0 || DEBUGL4 ){
+		outstr = Make_job_ticket_image( job );
+	}
 	DEBUG4("Set_job_ticket_file: '%s'", outstr );
 	if( !(job_ticket_name = Find_str_value(&job->info,HF_NAME)) ){
 		Errorcode = JABORT;
@@ -683,7 +1489,15 @@ int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int open
 			close(fd); fd = -1;
 		}
 	}
-	if( fd > 0 ){
+	if( fd > 0 && image ){
+		if( Write_job_ticket_binary( fd, image, len ) ){
+			logerr(LOG_INFO, "Set_job_ticket_file: write to '%s' failed", job_ticket_name );
+			status = 1;
+		}
+		if( opened_fd <= 0 ){
+			close(fd); fd = -1;
+		}
+	} else if( fd > 0 ){
 		if( lseek( fd, 0, SEEK_SET ) == -1 ){
 			logerr_die(LOG_ERR, "Set_job_ticket_file: lseek failed" );
 		}
@@ -699,9 +1513,7 @@ int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int open
 		}
 	}
 
-	if( Lpq_status_file_DYN ){
-		unlink(Lpq_status_file_DYN );
-	}
+	Queue_status_changed();
 
 	/* we do this when we have a logger */
 	if( status == 0 && Logger_fd > 0 ){
@@ -716,6 +1528,7 @@ int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int open
 		send_to_logger(-1, -1, job,UPDATE,outstr);
 	}
         free( outstr ); 
+	free( image );
 	return( status );
 }
 
@@ -727,9 +1540,9 @@ int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int open
 
 void Get_job_ticket_file( int *lock_fd, struct job *job, char *job_ticket_name )
 {
-	char *s;
+	char *s, *image = 0;
 	struct stat statb;
-	int fd = -1;
+	int fd = -1, len = 0;
 	if( (s = safestrchr(job_ticket_name, '=')) ){
 		job_ticket_name = s+1;
 	}
@@ -738,8 +1551,7 @@ void Get_job_ticket_file( int *lock_fd, struct job *job, char *job_ticket_name )
 	if( fd <= 0 ){
 		if( (fd = Checkwrite( job_ticket_name, &statb, O_RDWR, 0, 0 )) > 0
 			&& !Do_lock(fd, 1 ) ){
-			Get_fd_image_and_split( fd, 0, 0,
-				&job->info, Line_ends, 1, Option_value_sep,1,1,1,0);
+			image = Get_job_ticket_image( fd, &len );
 			if( lock_fd ){
 				*lock_fd = fd;
 				fd = -1;
@@ -748,15 +1560,59 @@ void Get_job_ticket_file( int *lock_fd, struct job *job, char *job_ticket_name )
 		if( fd > 0 ) close(fd);
 		fd = -1;
 	} else {
-		Get_fd_image_and_split( fd, 0, 0,
-			&job->info, Line_ends, 1, Option_value_sep,1,1,1,0);
+		image = Get_job_ticket_image( fd, &len );
+	}
+	if( image ){
+		Split_job_ticket_image( &job->info, image, len, job_ticket_name );
+		free(image);
+	}
+	Get_job_ticket_datafiles( job );
+	if(DEBUGL2)Dump_job("Get_job_ticket_file",job);
+}
+
+/*
+ * Get_job_ticket_from_index( struct job *job, char *job_ticket_name )
+ *  get the job ticket information that the last Scan_queue() put in the
+ *  queue index,  so a job that was just scanned is not read again;
+ *  without an index entry we read the job ticket file
+ */
+
+void Get_job_ticket_from_index( struct job *job, char *job_ticket_name )
+{
+	char *s;
+	int mid;
+
+	if( (s = safestrchr(job_ticket_name, '=')) ){
+		job_ticket_name = s+1;
+	}
+	if( !ISNULL(Queue_index_file_DYN) && Queue_index_dir
+		&& !safestrcmp( Queue_index_dir, Spool_dir_DYN )
+		&& (mid = Find_queue_index( job_ticket_name )) >= 0
+		&& (s = strchr( Queue_index.list[mid], '\n' )) ){
+		DEBUG3("Get_job_ticket_from_index: '%s'", job_ticket_name );
+		Split( &job->info, s+1, Line_ends, 1, Option_value_sep,1,1,1,0);
+		Get_job_ticket_datafiles( job );
+		return;
 	}
+	Get_job_ticket_file( 0, job, job_ticket_name );
+}
+
+/*
+ * Get_job_ticket_datafiles( struct job *job )
+ *
+ *  split the HFDATAFILES value of the job ticket into the job->datafiles list
+ */
+
+static void Get_job_ticket_datafiles( struct job *job )
+{
 	if( job->info.count ) {
 		struct line_list cf_line_list, *datafile;
 		int i;
 		char *s;
 
 		Init_line_list(&cf_line_list);
+		/* the ticket is looked up by key many times while the job is handled */
+		Hash_line_list( &job->info );
 
 		if( (s = Find_str_value(&job->info,HFDATAFILES)) ){
 			Split(&cf_line_list,s,"\001",0,0,0,0,0,0);
@@ -769,11 +1625,12 @@ void Get_job_ticket_file( int *lock_fd, struct job *job, char *job_ticket_name )
 			datafile = malloc_or_die(sizeof(datafile[0]),__FILE__,__LINE__);
 			memset(datafile,0,sizeof(datafile[0]));
 			job->datafiles.list[job->datafiles.count++] = (void *)datafile;
+			/* the datafiles go with the job ticket information */
+			Use_line_arena( datafile, job->info.arena );
 			Split(datafile,s,"\002",1,Option_value_sep,1,1,1,0);
 		}
 		Free_line_list( &cf_line_list );
 	}
-	if(DEBUGL2)Dump_job("Get_job_ticket_file",job);
 }
 
 /*
@@ -822,10 +1679,7 @@ void Set_spool_control( struct line_list *perm_check, const char *file,
 	}
 	/* force and update of the cached status */
 
-	if( Lpq_status_file_DYN ){
-		/* do not check to see if this works */
-		unlink(Lpq_status_file_DYN);
-	}
+	Queue_status_changed();
 
 	if( Logger_fd ){
 		/* log the spool control file changes */
@@ -1096,6 +1950,33 @@ int Write_pid( int fd, int pid, char *str )
 	return 0;
 }
 
+/**************************************************************************
+ * Write_slot_pid( int fd, int slot, int pid )
+ *   - Write the pid on line 'slot' of a file that has a line for each
+ *     unspooler of a queue.  The lines are all the same length,  so
+ *     the unspoolers do not overwrite each other.
+ **************************************************************************/
+
+#define SLOT_PID_LEN 11
+
+int Write_slot_pid( int fd, int slot, int pid )
+{
+	char line[LINEBUFFER];
+	int flags;
+
+	plp_snprintf( line, sizeof(line), "%*d\n", SLOT_PID_LEN-1, pid );
+	DEBUG3( "Write_slot_pid: slot %d, pid %d", slot, pid );
+	/* Checkwrite() opens files for appending */
+	if( (flags = fcntl( fd, F_GETFL, 0 )) == -1
+		|| fcntl( fd, F_SETFL, flags & ~O_APPEND ) == -1
+		|| lseek( fd, (off_t)slot*SLOT_PID_LEN, SEEK_SET ) == -1
+		|| Write_fd_str( fd, line ) < 0 ){
+		logerr(LOG_ERR, "Write_slot_pid: write failed" );
+		return -1;
+	}
+	return 0;
+}
+
 /***************************************************************************
  * int Patselect( struct line_list *tokens, struct line_list *cf );
  *    check to see that the token value matches one of the following
@@ -1387,6 +2268,330 @@ char *Fix_job_number( struct job *job, int n )
 	return( Find_str_value(&job->info,NUMBER) );
 }
 
+/*
+ * Job number allocation
+ *
+ *  To find an unused job number for an incoming job lpd tries to create
+ *  the hfA<number> job ticket files in turn,  which takes many tries
+ *  when there are many jobs in the queue.  The job number file
+ *  (Queue_jobnumber_file_DYN) is a struct jobnumber_header followed by
+ *  a bitmap of the job numbers in use.  It is mapped and updated while
+ *  it is locked.
+ *
+ *  The bitmap is rebuilt from the job ticket files in the spool directory
+ *  when the file is new or is for a different range of job numbers
+ *  (long_number was changed),  and when all the numbers are in use;
+ *  this recovers numbers whose jobs were removed without releasing them.
+ */
+
+#define JOBNUMBER_MAGIC "LPRngJN"
+
+struct jobnumber_header {
+	char magic[8];
+	int max;			/* job numbers are 0 .. max-1 */
+	int used;			/* number of bits set */
+};
+
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+
+static int Rebuild_job_numbers( unsigned char *bits, int max )
+{
+	DIR *dir;
+	struct dirent *d;
+	char *end;
+	int n, used = 0;
+
+	memset( bits, 0, (max+7)/8 );
+	if( !(dir = opendir( "." )) ){
+		logerr(LOG_INFO, "Rebuild_job_numbers: cannot open '.'" );
+		return( 0 );
+	}
+	while( (d = readdir(dir)) ){
+		if( strncmp( d->d_name, "hfA", 3 ) ) continue;
+		n = strtol( d->d_name+3, &end, 10 );
+		if( end == d->d_name+3 || *end || n < 0 ) continue;
+		n %= max;
+		if( !(bits[n/8] & (1 << (n%8))) ){
+			bits[n/8] |= (1 << (n%8));
+			++used;
+		}
+	}
+	closedir(dir);
+	DEBUG1("Rebuild_job_numbers: %d of %d in use", used, max );
+	return( used );
+}
+
+/*
+ * find the first clear bit at or after n,  skipping full bytes
+ */
+
+static int Find_free_job_number( unsigned char *bits, int n, int max )
+{
+	int count;
+	for( count = 0; count < max; ){
+		if( (n % 8) == 0 && n + 8 <= max && bits[n/8] == 0xFF ){
+			n += 8;
+			count += 8;
+		} else if( !(bits[n/8] & (1 << (n%8))) ){
+			return( n );
+		} else {
+			++n;
+			++count;
+		}
+		if( n >= max ) n = 0;
+	}
+	return( -1 );
+}
+
+/*
+ * map the locked job number file;  returns the fd or -1
+ */
+
+static int Map_job_numbers( int create, int max, struct jobnumber_header **header,
+	int *size )
+{
+	struct stat statb;
+	void *map;
+	int fd;
+
+	if( ISNULL(Queue_jobnumber_file_DYN) ) return( -1 );
+	if( (fd = Checkwrite( Queue_jobnumber_file_DYN, &statb, O_RDWR, create, 0 )) < 0 ){
+		DEBUG1("Map_job_numbers: cannot open '%s' - %s",
+			Queue_jobnumber_file_DYN, Errormsg(errno) );
+		return( -1 );
+	}
+	if( Do_lock( fd, 1 ) < 0 || fstat( fd, &statb ) ){
+		logerr(LOG_INFO, "Map_job_numbers: cannot lock '%s'",
+			Queue_jobnumber_file_DYN );
+		close(fd);
+		return( -1 );
+	}
+	if( max <= 0 ){
+		/* use the size of the existing file */
+		if( statb.st_size <= (off_t)sizeof(**header) ){
+			close(fd);
+			return( -1 );
+		}
+		*size = statb.st_size;
+	} else {
+		*size = sizeof(**header) + (max+7)/8;
+		if( statb.st_size != *size && ftruncate( fd, *size ) ){
+			logerr(LOG_INFO, "Map_job_numbers: cannot extend '%s'",
+				Queue_jobnumber_file_DYN );
+			close(fd);
+			return( -1 );
+		}
+	}
+	map = mmap( 0, *size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	if( map == (void *)MAP_FAILED ){
+		logerr(LOG_INFO, "Map_job_numbers: mmap of '%s' failed",
+			Queue_jobnumber_file_DYN );
+		close(fd);
+		return( -1 );
+	}
+	*header = map;
+	return( fd );
+}
+
+/*
+ * int Allocate_job_number( int n, int max )
+ *  returns the first unused job number at or after n (modulo max)
+ *  and marks it as used,  or -1 if there is none or the job number
+ *  file cannot be used.
+ */
+
+int Allocate_job_number( int n, int max )
+{
+	struct jobnumber_header *header;
+	unsigned char *bits;
+	int fd, size, number = -1;
+
+	if( max <= 0 || (fd = Map_job_numbers( 1, max, &header, &size )) < 0 ){
+		return( -1 );
+	}
+	bits = (unsigned char *)(header+1);
+	n = (n < 0 ? 0 : n) % max;
+	if( memcmp( header->magic, JOBNUMBER_MAGIC, sizeof(JOBNUMBER_MAGIC) )
+		|| header->max != max ){
+		memcpy( header->magic, JOBNUMBER_MAGIC, sizeof(JOBNUMBER_MAGIC) );
+		header->max = max;
+		header->used = Rebuild_job_numbers( bits, max );
+	} else if( header->used >= max ){
+		header->used = Rebuild_job_numbers( bits, max );
+	}
+	if( header->used < max && (number = Find_free_job_number( bits, n, max )) >= 0 ){
+		bits[number/8] |= (1 << (number%8));
+		++header->used;
+	}
+	DEBUG1("Allocate_job_number: wanted %d, got %d, %d of %d in use",
+		n, number, header->used, max );
+	munmap( (void *)header, size );
+	close(fd);
+	return( number );
+}
+
+/*
+ * void Release_job_number( const char *job_ticket_name )
+ *  mark the number of a removed job ticket file as unused
+ */
+
+void Release_job_number( const char *job_ticket_name )
+{
+	struct jobnumber_header *header;
+	unsigned char *bits;
+	char *end;
+	int fd, size, n;
+
+	if( ISNULL(job_ticket_name) || strncmp( job_ticket_name, "hfA", 3 ) ) return;
+	n = strtol( job_ticket_name+3, &end, 10 );
+	if( end == job_ticket_name+3 || *end || n < 0 ) return;
+	if( (fd = Map_job_numbers( 0, 0, &header, &size )) < 0 ) return;
+	bits = (unsigned char *)(header+1);
+	if( !memcmp( header->magic, JOBNUMBER_MAGIC, sizeof(JOBNUMBER_MAGIC) )
+		&& header->max > 0 && size == (int)sizeof(*header) + (header->max+7)/8 ){
+		n %= header->max;
+		if( bits[n/8] & (1 << (n%8)) ){
+			bits[n/8] &= ~(1 << (n%8));
+			--header->used;
+		}
+	}
+	DEBUG1("Release_job_number: '%s'", job_ticket_name );
+	munmap( (void *)header, size );
+	close(fd);
+}
+
+#else
+
+int Allocate_job_number( int n, int max )
+{
+	return( -1 );
+}
+
+void Release_job_number( const char *job_ticket_name )
+{
+}
+
+#endif
+
+/*
+ * Group commit of received jobs
+ *
+ *  With durable_receive each receiver must get its job files onto the disk
+ *  before it accepts the job.  Rather than have each one sync on its own,
+ *  the receivers that finish at about the same time share one sync.  The
+ *  commit file (Queue_commit_file_DYN) has a count of the syncs started
+ *  and the number of the last one finished.  A receiver notes the started
+ *  count once its files are written and then waits for the lock on the
+ *  commit file.  If a sync started after that has finished by the time it
+ *  gets the lock,  its files are already on disk;  otherwise it does the
+ *  sync itself for everyone waiting behind it.
+ *
+ *  syncfs() flushes the files and directory in one call;  without it each
+ *  receiver fsyncs its own files and the shared sync is of the directory.
+ */
+
+#define COMMIT_MAGIC "LPRngGC"
+
+struct commit_header {
+	char magic[8];
+	long started;		/* syncs started */
+	long done;			/* last sync finished */
+};
+
+static int Sync_spool_dir( void )
+{
+	int fd, status;
+
+	if( (fd = open( Spool_dir_DYN, O_RDONLY )) < 0 ){
+		logerr(LOG_INFO, "Sync_spool_dir: cannot open '%s'", Spool_dir_DYN );
+		return( -1 );
+	}
+#if defined(HAVE_SYNCFS)
+	status = syncfs( fd );
+#else
+	status = fsync( fd );
+#endif
+	if( status ){
+		logerr(LOG_INFO, "Sync_spool_dir: sync of '%s' failed", Spool_dir_DYN );
+	}
+	close(fd);
+	return( status );
+}
+
+/*
+ * int Sync_spool_files( struct line_list *files )
+ *  make the files (spool directory paths) and the spool directory
+ *  entries safe on disk;  returns 0 on success
+ */
+
+int Sync_spool_files( struct line_list *files )
+{
+	int status = 0;
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	struct commit_header *header;
+	struct stat statb;
+	void *map;
+	long seen;
+	int fd;
+#endif
+
+#if !defined(HAVE_SYNCFS)
+	{
+		int i, file_fd;
+		for( i = 0; files && status == 0 && i < files->count; ++i ){
+			if( (file_fd = open( files->list[i], O_RDONLY )) < 0 || fsync( file_fd ) ){
+				logerr(LOG_INFO, "Sync_spool_files: sync of '%s' failed", files->list[i] );
+				status = -1;
+			}
+			if( file_fd >= 0 ) close(file_fd);
+		}
+		if( status ) return( status );
+	}
+#endif
+
+#if defined(QUEUE_SNAPSHOT_SUPPORTED)
+	if( ISNULL(Queue_commit_file_DYN)
+		|| (fd = Checkwrite( Queue_commit_file_DYN, &statb, O_RDWR, 1, 0 )) < 0 ){
+		return( Sync_spool_dir() );
+	}
+	if( statb.st_size != sizeof(*header)
+		&& (Do_lock( fd, 1 ) < 0 || ftruncate( fd, sizeof(*header) )) ){
+		logerr(LOG_INFO, "Sync_spool_files: cannot set up '%s'", Queue_commit_file_DYN );
+		close(fd);
+		return( Sync_spool_dir() );
+	}
+	map = mmap( 0, sizeof(*header), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+	if( map == (void *)MAP_FAILED ){
+		logerr(LOG_INFO, "Sync_spool_files: mmap of '%s' failed", Queue_commit_file_DYN );
+		close(fd);
+		return( Sync_spool_dir() );
+	}
+	header = map;
+	seen = header->started;
+	if( Do_lock( fd, 1 ) < 0 ){
+		logerr(LOG_INFO, "Sync_spool_files: cannot lock '%s'", Queue_commit_file_DYN );
+		status = Sync_spool_dir();
+	} else if( memcmp( header->magic, COMMIT_MAGIC, sizeof(COMMIT_MAGIC) ) ){
+		memset( header, 0, sizeof(*header) );
+		memcpy( header->magic, COMMIT_MAGIC, sizeof(COMMIT_MAGIC) );
+		status = Sync_spool_dir();
+	} else if( header->done > seen ){
+		DEBUG1("Sync_spool_files: covered by sync %ld", header->done );
+	} else {
+		seen = ++header->started;
+		if( (status = Sync_spool_dir()) == 0 ){
+			header->done = seen;
+		}
+		DEBUG1("Sync_spool_files: did sync %ld, status %d", seen, status );
+	}
+	munmap( map, sizeof(*header) );
+	close(fd);
+	return( status );
+#else
+	return( Sync_spool_dir() );
+#endif
+}
+
 /************************************************************************
  * Make_identifier - add an identifier field to the job
  *  the identifier has the format name@host%id
@@ -1560,18 +2765,31 @@ void Job_printable( struct job *job, struct line_list *spool_control,
 		printable, held, move, error, done, buffer );
 }
 
+/*
+ * Server_active( char *file )
+ *  the first active process of the ones whose pids are in the file;
+ *  the unspooler file has a line for each unspooler (see Write_slot_pid())
+ */
+
 int Server_active( char *file )
 {
 	struct stat statb;
 	int serverpid = 0;
+	char *image, *s, *end;
 	int fd = Checkread( file, &statb );
 	if( fd >= 0 ){
-		serverpid = Read_pid( fd );
+		image = Get_fd_image( fd, 0 );
 		close(fd);
-		DEBUG5("Server_active: checking file %s, serverpid %d", file, serverpid );
-		if( serverpid > 0 && kill(serverpid,0) ){
-			serverpid = 0;
+		for( s = image; s && *s && serverpid == 0; s = end ){
+			serverpid = strtol( s, &end, 10 );
+			DEBUG5("Server_active: checking file %s, serverpid %d", file, serverpid );
+			if( end == s ) break;
+			if( serverpid > 0 && kill(serverpid,0) ){
+				serverpid = 0;
+			}
 		}
+		if( serverpid < 0 ) serverpid = 0;
+		free( image ); image = 0;
 	}
 	DEBUG3("Server_active: file %s, serverpid %d", file, serverpid );
 	return( serverpid );
@@ -1654,17 +2872,22 @@ int Get_destination_by_name( struct job *job, char *name )
 
 /*
  * Trim_status_file - trim a status file to an acceptible length
+ *  The file is kept as two segments: the current one and the previous
+ *  one,  'file.1'.  When the current segment grows past its limit it is
+ *  renamed to be the previous segment and a new one is started,  so
+ *  trimming costs a rename rather than a copy of the file contents.
+ *  If status_fd is open on the current segment and it is not over its
+ *  limit, it is returned unchanged.  If another process has rotated the
+ *  file,  status_fd is reopened on the new segment.
+ *  The segment limit is max/2 (but at least min) K bytes,  so that the
+ *  two segments together hold between min and max K bytes.
  */
 
 int Trim_status_file( int status_fd, char *file, int max, int min )
 {
-	int tempfd, status;
-	char buffer[LARGEBUFFER];
-	struct stat statb;
-	char *tempfile, *s;
-	int count;
-
-	tempfd = status = -1;
+	int fd, segment;
+	struct stat statb, fdstatb;
+	char *previous;
 
 	DEBUG1("Trim_status_file: file '%s' max %d, min %d", file, max, min);
 
@@ -1673,49 +2896,87 @@ int Trim_status_file( int status_fd, char *file, int max, int min )
 	if( stat( file, &statb ) == 0 ){
 		DEBUG1("Trim_status_file: '%s' max %d, min %d, size %ld", file, max, min, 
 			(long)(statb.st_size) );
-		if( max > 0 && statb.st_size/1024 > max ){
-			status = Checkwrite( file, &statb,O_RDWR,0,0);
-			tempfd = Make_temp_fd(&tempfile);
-			if( min > max || min == 0 ){
-				min = max/4;
-			}
-			if( min == 0 ) min = 1;
-			DEBUG1("Trim_status_file: trimming to %d K", min);
-			lseek( status, 0, SEEK_SET );
-			lseek( status, -min*1024, SEEK_END );
-			while( (count = ok_read( status, buffer, sizeof(buffer) - 1 ) ) > 0 ){
-				buffer[count] = 0;
-				if( (s = safestrchr(buffer,'\n')) ){
-					*s++ = 0;
-					Write_fd_str( tempfd, s );
-					break;
-				}
-			}
-			while( (count = ok_read( status, buffer, sizeof(buffer) ) ) > 0 ){
-				if( write( tempfd, buffer, count) < 0 ){
-					Errorcode = JABORT;
-					logerr_die(LOG_ERR, "Trim_status_file: cannot write tempfile" );
-				}
-			}
-			lseek( tempfd, 0, SEEK_SET );
-			lseek( status, 0, SEEK_SET );
-			ftruncate( status, 0 );
-			while( (count = ok_read( tempfd, buffer, sizeof(buffer) ) ) > 0 ){
-				if( write( status, buffer, count) < 0 ){
-					Errorcode = JABORT;
-					logerr_die(LOG_ERR, "Trim_status_file: cannot write tempfile" );
+		if( min > max || min == 0 ){
+			min = max/4;
+		}
+		if( min == 0 ) min = 1;
+		segment = max/2;
+		if( segment < min ) segment = min;
+		if( status_fd > 0 && fstat( status_fd, &fdstatb ) == 0
+			&& fdstatb.st_dev == statb.st_dev && fdstatb.st_ino == statb.st_ino
+			&& (max <= 0 || statb.st_size/1024 <= segment) ){
+			return( status_fd );
+		}
+		if( max > 0 && statb.st_size/1024 > segment ){
+			/* lock the segment and make sure nobody else rotated it */
+			fd = Checkwrite( file, &fdstatb,O_RDWR,0,0);
+			if( fd > 0 && Do_lock( fd, 1 ) == 0
+				&& stat( file, &statb ) == 0
+				&& fdstatb.st_dev == statb.st_dev && fdstatb.st_ino == statb.st_ino
+				&& statb.st_size/1024 > segment ){
+				previous = Status_file_segment( file );
+				DEBUG1("Trim_status_file: rotating '%s' to '%s'", file, previous);
+				if( rename( file, previous ) == -1 ){
+					logerr(LOG_ERR, "Trim_status_file: rename '%s' to '%s' failed",
+						file, previous );
+					ftruncate( fd, 0 );
+				} else {
+					close( Checkwrite( file, &statb, O_RDWR, 1, 0 ) );
 				}
+				free( previous ); previous = 0;
 			}
-			unlink(tempfile);
-			close(status);
+			if( fd > 0 ) close( fd );
 		}
-		close( tempfd );
 		if( status_fd > 0 ) close( status_fd );
 		status_fd = Checkwrite( file, &statb,0,0,0);
 	}
 	return( status_fd );
 }
 
+/*
+ * Status_file_segment - name of the previous segment of a status file
+ */
+
+char *Status_file_segment( const char *file )
+{
+	return( safestrdup2( file, ".1", __FILE__,__LINE__ ) );
+}
+
+/*
+ * Get_status_file_image - get the last part of a status file
+ *  We read the current segment and,  if it does not have the number of
+ *  lines we want (or maxsize K bytes when lines is 0),  put the end of
+ *  the previous segment in front of it.
+ */
+
+char *Get_status_file_image( const char *file, off_t maxsize, int lines )
+{
+	char *image, *previous, *older, *s;
+	int count;
+	off_t len;
+
+	image = Get_file_image( file, maxsize );
+	if( ISNULL(file) ) return( image );
+	len = safestrlen( image );
+	count = 0;
+	for( s = image; s && (s = safestrchr( s, '\n' )); ++s ) ++count;
+	if( lines > 0 ? (count >= lines)
+		: (maxsize == 0 || len >= maxsize*1024) ){
+		return( image );
+	}
+	previous = Status_file_segment( file );
+	older = Get_file_image( previous, maxsize );
+	free( previous ); previous = 0;
+	if( older ){
+		DEBUG3("Get_status_file_image: '%s' using previous segment", file );
+		s = safestrdup2( older, image, __FILE__,__LINE__ );
+		free( older ); older = 0;
+		if( image ) free( image );
+		image = s;
+	}
+	return( image );
+}
+
 /********************************************************************
  * BSD and LPRng order
  * We use these values to determine the order of jobs in the file
@@ -230,16 +230,33 @@ void Setup_configuration()
 			Printer_perms_path_DYN );
 		Free_line_list(&Perm_line_list);
 		Merge_line_list(&Perm_line_list,&RawPerm_line_list,0,0,0);
+		Build_printcap_info( &PC_names_line_list, &PC_order_line_list,
+			&PC_info_line_list, &raw, &Host_IP );
+		/* now we can free up the raw list */
+		Free_line_list( &raw );
+		/* bring the client printcap cache up to date */
+		if( !ISNULL(Printcap_cache_DYN) ){
+			struct line_list names, pc_order, info, filters;
+			int server = Is_server;
+			Init_line_list(&names);
+			Init_line_list(&pc_order);
+			Init_line_list(&info);
+			Init_line_list(&filters);
+			Is_server = 0;
+			Read_printcap_files( Require_configfiles_DYN, Printcap_path_DYN,
+				Printcap_cache_DYN, &names, &pc_order, &info, &filters );
+			Is_server = server;
+			Free_line_list(&names);
+			Free_line_list(&pc_order);
+			Free_line_list(&info);
+			Free_line_list(&filters);
+		}
 	} else {
 		DEBUG2("Setup_configuration: Printcap_path '%s'", Printcap_path_DYN );
-		Getprintcap_pathlist( Require_configfiles_DYN,
-			&raw, &PC_filters_line_list,
-			Printcap_path_DYN );
+		Read_printcap_files( Require_configfiles_DYN, Printcap_path_DYN,
+			Printcap_cache_DYN, &PC_names_line_list, &PC_order_line_list,
+			&PC_info_line_list, &PC_filters_line_list );
 	}
-	Build_printcap_info( &PC_names_line_list, &PC_order_line_list,
-		&PC_info_line_list, &raw, &Host_IP );
-	/* now we can free up the raw list */
-	Free_line_list( &raw );
 
 	/* now we get the user level information */
 	DEBUG2("Setup_configuration: User_printcap '%s'", User_printcap_DYN );
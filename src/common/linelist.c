@@ -17,10 +17,22 @@
 #include "getprinter.h"
 #include "linelist.h"
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+#endif
+
 /* Forward declartions: */
 static int Find_last_key( struct line_list *l, const char *key, const char *sep, int *m );
 static int Find_last_casekey( struct line_list *l, const char *key, const char *sep, int *m );
 static int Find_first_casekey( struct line_list *l, const char *key, const char *sep, int *m );
+static int Key_cmp( const char *key, const char *s, const char *sep, int nocase );
+static int Find_key( struct line_list *l, const char *key, const char *sep, int *m );
+static int Find_hash_key( struct line_list *l, const char *key, const char *sep, int *m );
+static void Build_line_hash( struct line_list *l );
+static void Line_hash_insert( struct line_list *l, int mid );
+static void Line_hash_changed( struct line_list *l );
+static char *Line_strdup( struct line_list *l, const char *s );
+static void Free_line( struct line_list *l, char *s );
 static const char *Fix_val( const char *s );
 static void Read_file_and_split( struct line_list *list, char *file,
 	const char *linesep, int sort, const char *keysep, int uniq,
@@ -30,6 +42,21 @@ static void Find_pc_info( char *name, struct line_list *info,
 	struct line_list *order, struct line_list *input,
 	int depth, int wildcard );
 static void Config_value_conversion( struct keywords *key, const char *s );
+/* when not 0,  Read_file_list() records the files it reads here */
+static struct line_list *Printcap_sources;
+
+/* hashed key index for a line list, see Hash_line_list() */
+struct line_hash_slot {
+	unsigned int hash;	/* hash of the key */
+	int keylen;			/* length of the key */
+	int index;			/* line in list, -1 if slot is empty */
+};
+
+struct line_hash {
+	struct line_hash_slot *slot;
+	int size;			/* number of slots, power of 2 */
+	int count;			/* l->count when index was updated */
+};
 
 /* lowercase and uppercase (destructive) a string */
 void lowercase( char *s )
@@ -321,10 +348,15 @@ void Free_line_list( struct line_list *l )
 	if( l == NULL ) return;
 	if( l->list ){
 		for( i = 0; i < l->count; ++i ){
-			 free( l->list[i]); 
+			 Free_line( l, l->list[i]); 
 		}
 		free(l->list);
 	}
+	if( l->hash ){
+		free( l->hash->slot );
+		free( l->hash );
+	}
+	if( l->arena ) Free_line_arena( l->arena );
 	memset(l,0,sizeof(l[0]));
 }
 
@@ -359,6 +391,293 @@ void Check_max( struct line_list *l, int incr )
 	}
 }
 
+/*
+ * Line arenas
+ *
+ *  Reading a job ticket or a printcap entry into a list allocates a
+ *  copy of every line,  and freeing the list frees them one at a time.
+ *  A list that is filled and then discarded as a whole (the jobs read
+ *  while scanning a queue,  for example) can be given an arena with
+ *  Use_line_arena().  The lines added by Add_line_list() and the
+ *  functions that use it are then carved out of large chunks,  and are
+ *  released together when the arena is freed or reset.  Lines that
+ *  the caller puts into l->list directly are still malloc()ed and are
+ *  freed as usual;  lines in the arena are never passed to free(),  so
+ *  do not take a line out of such a list and free it yourself.
+ *
+ *  An arena may be shared by several lists (the info and datafiles
+ *  of a job).  Each list holds a reference,  dropped by
+ *  Free_line_list(),  and the creator holds one,  dropped by
+ *  Free_line_arena().  Reset_line_arena() reuses the storage when the
+ *  creator is the only holder.
+ */
+
+#define LINE_ARENA_CHUNK 8192
+
+struct line_arena_chunk {
+	struct line_arena_chunk *next;
+	int size, used;
+	double data[1];		/* aligned storage for the lines */
+};
+
+struct line_arena {
+	struct line_arena_chunk *chunk;	/* the current chunk is first */
+	int refs;
+};
+
+struct line_arena *Make_line_arena( void )
+{
+	struct line_arena *arena;
+	arena = malloc_or_die( sizeof(arena[0]),__FILE__,__LINE__);
+	memset( arena, 0, sizeof(arena[0]) );
+	arena->refs = 1;
+	return( arena );
+}
+
+void Use_line_arena( struct line_list *l, struct line_arena *arena )
+{
+	if( l->arena == arena ) return;
+	if( l->arena ) Free_line_arena( l->arena );
+	l->arena = arena;
+	if( arena ) ++arena->refs;
+}
+
+void Reset_line_arena( struct line_arena *arena )
+{
+	struct line_arena_chunk *chunk;
+	if( arena == 0 || arena->refs != 1 || arena->chunk == 0 ) return;
+	/* keep the current chunk for the next user */
+	while( (chunk = arena->chunk->next) ){
+		arena->chunk->next = chunk->next;
+		free( chunk );
+	}
+	arena->chunk->used = 0;
+}
+
+void Free_line_arena( struct line_arena *arena )
+{
+	struct line_arena_chunk *chunk;
+	if( arena == 0 || --arena->refs > 0 ) return;
+	while( (chunk = arena->chunk) ){
+		arena->chunk = chunk->next;
+		free( chunk );
+	}
+	free( arena );
+}
+
+static char *Line_strdup( struct line_list *l, const char *s )
+{
+	struct line_arena *arena = l->arena;
+	struct line_arena_chunk *chunk;
+	int len, size;
+	char *str;
+
+	if( arena == 0 ) return( safestrdup( s,__FILE__,__LINE__) );
+	len = safestrlen( s ) + 1;
+	if( (chunk = arena->chunk) == 0 || chunk->size - chunk->used < len ){
+		size = LINE_ARENA_CHUNK;
+		if( size < len ) size = len;
+		chunk = malloc_or_die( sizeof(chunk[0]) + size,__FILE__,__LINE__);
+		chunk->size = size;
+		chunk->used = 0;
+		chunk->next = arena->chunk;
+		arena->chunk = chunk;
+	}
+	str = (char *)chunk->data + chunk->used;
+	chunk->used += len;
+	memcpy( str, s?s:"", len );
+	return( str );
+}
+
+static void Free_line( struct line_list *l, char *s )
+{
+	struct line_arena_chunk *chunk;
+	if( s == 0 ) return;
+	if( l->arena ){
+		for( chunk = l->arena->chunk; chunk; chunk = chunk->next ){
+			if( s >= (char *)chunk->data && s < (char *)chunk->data + chunk->size ){
+				return;
+			}
+		}
+	}
+	free( s );
+}
+
+/*
+ * Hashed key index
+ *
+ *  A list that is searched by key much more often than it is changed
+ *  (job ticket information, printcap names) can be given a hash index
+ *  by calling Hash_line_list().  The index maps the key of each line,
+ *  the text up to the first Option_value_sep character compared
+ *  without case, to the position of the first line with that key.
+ *  The list itself is still kept sorted, so code that walks l->list
+ *  is not affected.  Find_first_key(), the Find_xxx_value() and
+ *  Set_xxx_value() functions use the index instead of the binary
+ *  search.  If the list is changed by other means l->count will
+ *  be different and the index is rebuilt on the next lookup.
+ *  Free_line_list() discards the index.
+ */
+
+void Hash_line_list( struct line_list *l )
+{
+	if( l->hash == 0 ){
+		l->hash = malloc_or_die( sizeof(l->hash[0]),__FILE__,__LINE__);
+		memset( l->hash, 0, sizeof(l->hash[0]) );
+	}
+	Build_line_hash( l );
+}
+
+/*
+ * hash of key, up to the first Option_value_sep character
+ */
+
+static unsigned int Line_hash_key( const char *s, int *len )
+{
+	unsigned int h = 2166136261U;
+	int c, n;
+	for( n = 0; (c = cval(s+n)) && !strchr( Option_value_sep, c ); ++n ){
+		if( isupper(c) ) c = tolower(c);
+		h = (h ^ c) * 16777619U;
+	}
+	*len = n;
+	return( h );
+}
+
+/*
+ * find the slot for the key, or the empty slot where it would go
+ */
+
+static struct line_hash_slot *Line_hash_slot( struct line_list *l,
+	const char *key, int keylen, unsigned int hash )
+{
+	struct line_hash *h = l->hash;
+	struct line_hash_slot *p;
+	int n;
+
+	for( n = hash & (h->size-1); ; n = (n+1) & (h->size-1) ){
+		p = &h->slot[n];
+		if( p->index < 0 ) break;
+		if( p->hash == hash && p->keylen == keylen && p->index < l->count
+			&& l->list[p->index]
+			&& !safestrncasecmp( l->list[p->index], key, keylen ) ) break;
+	}
+	return( p );
+}
+
+static void Build_line_hash( struct line_list *l )
+{
+	struct line_hash *h = l->hash;
+	struct line_hash_slot *p;
+	unsigned int hash;
+	int i, len, size;
+
+	for( size = 64; size < 2*l->count; size *= 2 );
+	if( size != h->size ){
+		h->slot = realloc_or_die( h->slot, size*sizeof(h->slot[0]),
+			__FILE__,__LINE__);
+		h->size = size;
+	}
+	for( i = 0; i < size; ++i ){
+		h->slot[i].index = -1;
+	}
+	for( i = 0; i < l->count; ++i ){
+		if( l->list[i] == 0 ) continue;
+		hash = Line_hash_key( l->list[i], &len );
+		p = Line_hash_slot( l, l->list[i], len, hash );
+		if( p->index < 0 ){
+			p->hash = hash;
+			p->keylen = len;
+			p->index = i;
+		}
+	}
+	h->count = l->count;
+	DEBUG5("Build_line_hash: count %d, size %d", l->count, size );
+}
+
+/*
+ * the line at mid was inserted in the list
+ */
+
+static void Line_hash_insert( struct line_list *l, int mid )
+{
+	struct line_hash *h = l->hash;
+	struct line_hash_slot *p;
+	unsigned int hash;
+	int i, len;
+
+	if( h->count != l->count - 1 || 2*l->count > h->size ){
+		/* out of date or full, rebuild on next lookup */
+		h->count = -1;
+		return;
+	}
+	if( mid < l->count - 1 ){
+		for( i = 0; i < h->size; ++i ){
+			if( h->slot[i].index >= mid ) ++h->slot[i].index;
+		}
+	}
+	hash = Line_hash_key( l->list[mid], &len );
+	p = Line_hash_slot( l, l->list[mid], len, hash );
+	if( p->index < 0 || p->index > mid ){
+		p->hash = hash;
+		p->keylen = len;
+		p->index = mid;
+	}
+	h->count = l->count;
+}
+
+/*
+ * the list was changed in a way that we do not track
+ */
+
+static void Line_hash_changed( struct line_list *l )
+{
+	if( l->hash ) l->hash->count = -1;
+}
+
+/*
+ * int Find_hash_key( struct line_list *l, char *key, char *sep, int *mid )
+ *  use the hash index to find the first line with the key
+ *  returns: 0 if found, 1 if not in the list,
+ *    -1 if the index cannot be used for this lookup
+ */
+
+static int Find_hash_key( struct line_list *l, const char *key, const char *sep, int *m )
+{
+	struct line_hash_slot *p;
+	unsigned int hash;
+	int len, c, i, retry;
+	const char *s;
+
+	if( l == 0 || l->hash == 0 || key == 0 || sep == 0
+		|| (sep != Option_value_sep && sep != Hash_value_sep)
+		|| safestrpbrk( key, Option_value_sep ) ){
+		return( -1 );
+	}
+	hash = Line_hash_key( key, &len );
+	for( retry = 0; retry < 2; ++retry ){
+		if( l->hash->count != l->count ) Build_line_hash( l );
+		p = Line_hash_slot( l, key, len, hash );
+		if( (i = p->index) < 0 ){
+			DEBUG5("Find_hash_key: key '%s' not found", key );
+			return( 1 );
+		}
+		/* make sure that the index is still correct */
+		s = l->list[i];
+		c = cval(s+len);
+		if( (c == 0 || strchr( Option_value_sep, c ))
+			&& (i == 0 || Key_cmp( key, l->list[i-1], Option_value_sep, 1 )) ){
+			/* key@ and key#v have different keys with Hash_value_sep */
+			if( c && !strchr( sep, c ) ) return( -1 );
+			if( m ) *m = i;
+			DEBUG5("Find_hash_key: key '%s' found at %d", key, i );
+			return( 0 );
+		}
+		l->hash->count = -1;
+	}
+	return( -1 );
+}
+
 /*
  *char *Add_line_list( struct line_list *l, char *str,
  *  char *sep, int sort, int uniq )
@@ -385,20 +704,31 @@ char *Add_line_list( struct line_list *l, const char *instr,
 	}
 
 	Check_max(l, 2);
-	str = safestrdup( instr,__FILE__,__LINE__);
+	str = Line_strdup( l, instr );
 	if( sort == 0 ){
 		l->list[l->count++] = str;
+		Line_hash_changed( l );
 	} else {
 		s = 0;
 		if( sep && (s = safestrpbrk( str, sep )) ){ c = *s; *s = 0; }
 		/* find everything <= the mid point */
 		/* cmp = key <> list[mid] */
-		cmp = Find_last_key( l, str, sep, &mid );
+		if( uniq && Find_hash_key( l, str, sep, &mid ) == 0
+			&& (mid+1 >= l->count || Key_cmp( str, l->list[mid+1], sep, 1 )) ){
+			cmp = 0;
+		} else if( l->count > 0
+			&& Key_cmp( str, l->list[l->count-1], sep, 1 ) > 0 ){
+			/* sorted input, goes at the end */
+			mid = l->count-1;
+			cmp = 1;
+		} else {
+			cmp = Find_last_key( l, str, sep, &mid );
+		}
 		if( s ) *s = c;
 		/* str < list[mid+1] */
 		if( cmp == 0 && uniq ){
 			/* we replace */
-			free( l->list[mid] );		
+			Free_line( l, l->list[mid] );
 			l->list[mid] = str;
 		} else if( cmp >= 0 ){
 			/* we need to insert after mid */
@@ -406,12 +736,14 @@ char *Add_line_list( struct line_list *l, const char *instr,
 			memmove( l->list+mid+2, l->list+mid+1,
 				sizeof( char * ) * (l->count - mid - 1));
 			l->list[mid+1] = str;
+			if( l->hash ) Line_hash_insert( l, mid+1 );
 		} else if( cmp < 0 ) {
 			/* we need to insert before mid */
 			++l->count;
 			memmove( l->list+mid+1, l->list+mid,
 				sizeof( char * ) * (l->count - mid));
 			l->list[mid] = str;
+			if( l->hash ) Line_hash_insert( l, mid );
 		}
 	}
 	if(DEBUGL5)Dump_line_list("Add_line_list: result", l);
@@ -442,7 +774,7 @@ static void Add_casekey_line_list( struct line_list *l, char *str,
 	}
 
 	Check_max(l, 2);
-	str = safestrdup( str,__FILE__,__LINE__);
+	str = Line_strdup( l, str );
 		s = 0;
 		if( sep && (s = safestrpbrk( str, sep )) ){ c = *s; *s = 0; }
 		/* find everything <= the mid point */
@@ -452,7 +784,7 @@ static void Add_casekey_line_list( struct line_list *l, char *str,
 		/* str < list[mid+1] */
 		if( cmp == 0 ){
 			/* we replace */
-			free( l->list[mid] );		
+			Free_line( l, l->list[mid] );
 			l->list[mid] = str;
 		} else if( cmp >= 0 ){
 			/* we need to insert after mid */
@@ -467,6 +799,7 @@ static void Add_casekey_line_list( struct line_list *l, char *str,
 				sizeof( char * ) * (l->count - mid));
 			l->list[mid] = str;
 		}
+		if( cmp ) Line_hash_changed( l );
 	/* if(DEBUGL4)Dump_line_list("Add_casekey_line_list: result", l); */
 }
 
@@ -627,6 +960,31 @@ void Dump_line_list_sub( const char *title, struct line_list *l )
 }
 
 
+/*
+ * int Key_cmp( char *key, char *s, char *sep, int nocase )
+ *  compare key to the part of s before the first sep character,
+ *  without modifying s
+ */
+
+static int Key_cmp( const char *key, const char *s, const char *sep, int nocase )
+{
+	int c1, c2, d;
+	if( key == s ) return( 0 );
+	if( key == 0 ) return( -1 );
+	if( s == 0 ) return( 1 );
+	for(;;){
+		c1 = cval(key); ++key;
+		c2 = cval(s); ++s;
+		if( c2 && sep && strchr( sep, c2 ) ) c2 = 0;
+		if( nocase ){
+			if( isupper(c1) ) c1 = tolower(c1);
+			if( isupper(c2) ) c2 = tolower(c2);
+		}
+		if( (d = (c1 - c2)) || c1 == 0 ) break;
+	}
+	return( d );
+}
+
 /*
  * int Find_first_key( struct line_list *l, char *key, char *sep, int *mid )
  * int Find_last_key( struct line_list *l, char *key, char *sep, int *mid )
@@ -642,17 +1000,14 @@ void Dump_line_list_sub( const char *title, struct line_list *l )
 
 static int Find_last_key( struct line_list *l, const char *key, const char *sep, int *m )
 {
-	int c=0, cmp=-1, cmpl = 0, bot, top, mid;
-	char *s, *t;
+	int cmp=-1, cmpl = 0, bot, top, mid;
+	char *s;
 	mid = bot = 0; top = l->count-1;
 	DEBUG5("Find_last_key: count %d, key '%s'", l->count, key );
 	while( cmp && bot <= top ){
 		mid = (top+bot)/2;
 		s = l->list[mid];
-		t = 0;
-		if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-		cmp = safestrcasecmp(key,s);
-		if( t ) *t = c;
+		cmp = Key_cmp(key,s,sep,1);
 		if( cmp > 0 ){
 			bot = mid+1;
 		} else if( cmp < 0 ){
@@ -661,10 +1016,7 @@ static int Find_last_key( struct line_list *l, const char *key, const char *sep,
 			s = l->list[mid+1];
 			DEBUG5("Find_last_key: existing entry, mid %d, '%s'",
 				mid, l->list[mid] );
-			t = 0;
-			if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-			cmpl = safestrcasecmp(s,key);
-			if( t ) *t = c;
+			cmpl = Key_cmp(key,s,sep,1);
 			if( cmpl ) break;
 			++mid;
 		}
@@ -692,17 +1044,14 @@ static int Find_last_key( struct line_list *l, const char *key, const char *sep,
 
 static int Find_last_casekey( struct line_list *l, const char *key, const char *sep, int *m )
 {
-	int c=0, cmp=-1, cmpl = 0, bot, top, mid;
-	char *s, *t;
+	int cmp=-1, cmpl = 0, bot, top, mid;
+	char *s;
 	mid = bot = 0; top = l->count-1;
 	DEBUG5("Find_last_casekey: count %d, key '%s'", l->count, key );
 	while( cmp && bot <= top ){
 		mid = (top+bot)/2;
 		s = l->list[mid];
-		t = 0;
-		if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-		cmp = safestrcmp(key,s);
-		if( t ) *t = c;
+		cmp = Key_cmp(key,s,sep,0);
 		if( cmp > 0 ){
 			bot = mid+1;
 		} else if( cmp < 0 ){
@@ -711,10 +1060,7 @@ static int Find_last_casekey( struct line_list *l, const char *key, const char *
 			s = l->list[mid+1];
 			DEBUG5("Find_last_key: existing entry, mid %d, '%s'",
 				mid, l->list[mid] );
-			t = 0;
-			if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-			cmpl = safestrcmp(s,key);
-			if( t ) *t = c;
+			cmpl = Key_cmp(key,s,sep,0);
 			if( cmpl ) break;
 			++mid;
 		}
@@ -728,28 +1074,25 @@ static int Find_last_casekey( struct line_list *l, const char *key, const char *
 
 int Find_first_key( struct line_list *l, const char *key, const char *sep, int *m )
 {
-	int c=0, cmp=-1, cmpl = 0, bot, top, mid;
-	char *s, *t;
+	int cmp=-1, cmpl = 0, bot, top, mid;
+	char *s;
+	if( l->hash && Find_hash_key( l, key, sep, m ) == 0 ){
+		return( 0 );
+	}
 	mid = bot = 0; top = l->count-1;
 	DEBUG5("Find_first_key: count %d, key '%s', sep '%s'",
 		l->count, key, sep );
 	while( cmp && bot <= top ){
 		mid = (top+bot)/2;
 		s = l->list[mid];
-		t = 0;
-		if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-		cmp = safestrcasecmp(key,s);
-		if( t ) *t = c;
+		cmp = Key_cmp(key,s,sep,1);
 		if( cmp > 0 ){
 			bot = mid+1;
 		} else if( cmp < 0 ){
 			top = mid -1;
 		} else while( mid > 0 ){
 			s = l->list[mid-1];
-			t = 0;
-			if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-			cmpl = safestrcasecmp(s,key);
-			if( t ) *t = c;
+			cmpl = Key_cmp(key,s,sep,1);
 			if( cmpl ) break;
 			--mid;
 		}
@@ -764,28 +1107,22 @@ int Find_first_key( struct line_list *l, const char *key, const char *sep, int *
 
 static int Find_first_casekey( struct line_list *l, const char *key, const char *sep, int *m )
 {
-	int c=0, cmp=-1, cmpl = 0, bot, top, mid;
-	char *s, *t;
+	int cmp=-1, cmpl = 0, bot, top, mid;
+	char *s;
 	mid = bot = 0; top = l->count-1;
 	DEBUG5("Find_first_casekey: count %d, key '%s', sep '%s'",
 		l->count, key, sep );
 	while( cmp && bot <= top ){
 		mid = (top+bot)/2;
 		s = l->list[mid];
-		t = 0;
-		if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-		cmp = safestrcmp(key,s);
-		if( t ) *t = c;
+		cmp = Key_cmp(key,s,sep,0);
 		if( cmp > 0 ){
 			bot = mid+1;
 		} else if( cmp < 0 ){
 			top = mid -1;
 		} else while( mid > 0 ){
 			s = l->list[mid-1];
-			t = 0;
-			if( sep && (t = safestrpbrk(s, sep )) ) { c = *t; *t = 0; }
-			cmpl = safestrcmp(s,key);
-			if( t ) *t = c;
+			cmpl = Key_cmp(key,s,sep,0);
 			if( cmpl ) break;
 			--mid;
 		}
@@ -798,6 +1135,20 @@ static int Find_first_casekey( struct line_list *l, const char *key, const char
 	return( cmp );
 }
 
+/*
+ * int Find_key( struct line_list *l, char *key, char *sep, int *mid )
+ *  Find_first_key(), but a hashed list also answers 'not found'
+ *  without the binary search.  Only for callers that do not use
+ *  the position of a missing key.
+ */
+
+static int Find_key( struct line_list *l, const char *key, const char *sep, int *m )
+{
+	int cmp;
+	if( (cmp = Find_hash_key( l, key, sep, m )) >= 0 ) return( cmp );
+	return( Find_first_key( l, key, sep, m ) );
+}
+
 /*
  * char *Find_value( struct line_list *l, char *key )
  *  Search the list for a corresponding key value
@@ -817,7 +1168,7 @@ static const char *Find_value( struct line_list *l, const char *key )
 	const char *sep = Option_value_sep;
 
 	DEBUG5("Find_value: key '%s', sep '%s'", key, sep );
-	if( l ) cmp = Find_first_key( l, key, sep, &mid );
+	if( l ) cmp = Find_key( l, key, sep, &mid );
 	DEBUG5("Find_value: key '%s', cmp %d, mid %d", key, cmp, mid );
 	if( cmp==0 ){
 		s = Fix_val( safestrpbrk(l->list[mid], sep ) );
@@ -842,7 +1193,7 @@ const char *Find_exists_value( struct line_list *l, const char *key, const char
 	const char *s = 0;
 	int mid, cmp = -1;
 
-	if( l ) cmp = Find_first_key( l, key, sep, &mid );
+	if( l ) cmp = Find_key( l, key, sep, &mid );
 	if( cmp==0 ){
 		if( sep ){
 			s = Fix_val( safestrpbrk(l->list[mid], sep ) );
@@ -871,7 +1222,7 @@ char *Find_str_value( struct line_list *l, const char *key )
 	int mid, cmp = -1;
 	const char *sep = Option_value_sep;
 
-	if( l ) cmp = Find_first_key( l, key, sep, &mid );
+	if( l ) cmp = Find_key( l, key, sep, &mid );
 	if( cmp==0 ){
 		/*
 		 *  value: NULL, "", "@", "=xx", "#xx".
@@ -947,7 +1298,7 @@ void Set_str_value( struct line_list *l, const char *key, const char *value )
 		s = safestrdup3(key,"=",value,__FILE__,__LINE__);
 		Add_line_list(l,s,Hash_value_sep,1,1);
 		free(s); s = NULL;
-	} else if( !Find_first_key(l, key, Hash_value_sep, &mid ) ){
+	} else if( !Find_key(l, key, Hash_value_sep, &mid ) ){
 		Remove_line_list(l,mid);
 	}
 }
@@ -1038,11 +1389,12 @@ void Remove_line_list( struct line_list *l, int mid )
 	char *s;
 	if( mid >= 0 && mid < l->count ){
 		if( (s = l->list[mid]) ){
-			free(s);
+			Free_line( l, s );
 			l->list[mid] = 0;
 		}
 		memmove(&l->list[mid],&l->list[mid+1],(l->count-mid-1)*sizeof(char *));
 		--l->count;
+		Line_hash_changed( l );
 	}
 }
 
@@ -1279,6 +1631,9 @@ void Read_file_list( int required, struct line_list *model, char *str,
 	Split( &l, str, File_sep, 0, 0, 0, 1, 0 ,0);
 	start = model->count;
 	for( i = 0; i < l.count; ++i ){
+		if( Printcap_sources ){
+			Add_line_list( Printcap_sources, l.list[i], 0, 0, 0 );
+		}
 		if( stat( l.list[i], &statb ) == -1 ){
 			if( required || depth ){
 				Errorcode = JABORT;
@@ -1533,6 +1888,8 @@ void Build_printcap_info(
 
 	DEBUG1("Build_printcap_info: list->count %d, raw->count %d",
 		list->count, raw->count );
+	/* names are looked up once for each alias in each entry */
+	Hash_line_list( names );
 	for( i = 0; i < raw->count; ++i ){
 		t = raw->list[i];
 		DEBUG4("Build_printcap_info: doing '%s'", t );
@@ -2243,6 +2600,306 @@ void Filterprintcap( struct line_list *raw, struct line_list *filters,
 	}
 }
 
+/***************************************************************************
+ * Compiled printcap cache
+ *
+ * Every client program reads the printcap files and builds the
+ * printcap name, order and entry lists (Getprintcap_pathlist(),
+ * Build_printcap_info()).  With a large printcap this is a good part
+ * of the run time of lpq and lpr.  Read_printcap_files() saves the lists
+ * and the printcap filters in the printcap_cache file, together with
+ * the inode, size and change times of every printcap file that was
+ * read or looked for.  The next program that reads the same printcap
+ * information checks that none of the files has changed and copies the
+ * lists from the (memory mapped) cache file instead of parsing the
+ * printcap files.  The cache file also has a key made from the
+ * printcap path, the host name and the client/server mode, as these
+ * change which entries are selected.
+ *
+ * Clients that cannot write the cache file just use it;  lpd brings it
+ * up to date when it starts or rereads the printcap.
+ *
+ * File layout: struct pc_cache_header, the source file records,
+ * and then 0 terminated strings:  the key, the source file names,
+ * and the lines of the name, order, entry and filter lists.
+ ***************************************************************************/
+
+#define PC_CACHE_MAGIC "LPRpcc01"
+
+struct pc_cache_header {
+	char magic[8];
+	int size;			/* file size */
+	int sources;		/* source file records */
+	int names, order, info, filters;	/* lines in lists */
+};
+
+struct pc_cache_source {
+	ino_t ino;			/* 0 if file did not exist */
+	off_t size;
+	time_t mtime, ctime;
+};
+
+static char *Printcap_cache_key( int required, char *path )
+{
+	char buffer[SMALLBUFFER];
+
+	plp_snprintf( buffer, sizeof(buffer), "server=%d\nrequired=%d\nhost=%s\npath=",
+		Is_server, required, FQDNHost_FQDN );
+	return( safestrdup2( buffer, path, __FILE__,__LINE__ ) );
+}
+
+/*
+ * int Read_printcap_cache( int required, char *path, char *cache,
+ *   struct line_list *names, struct line_list *order,
+ *   struct line_list *info, struct line_list *filters )
+ *  load the printcap lists from the cache file if it is current
+ *  returns: 0 if loaded
+ */
+
+static int Read_printcap_cache( int required, char *path, char *cache,
+	struct line_list *names, struct line_list *order,
+	struct line_list *info, struct line_list *filters )
+{
+	struct pc_cache_header header;
+	struct pc_cache_source source;
+	struct stat statb;
+	struct line_list *lists[4];
+	int counts[4];
+	char *image = 0, *s, *end, *key = 0;
+	int fd, i, j, n, size, mapped = 0, status = -1;
+
+	if( (fd = Checkread( cache, &statb )) < 0 ){
+		DEBUG1("Read_printcap_cache: no cache '%s'", cache );
+		return( -1 );
+	}
+	size = statb.st_size;
+	if( size < (int)sizeof(header) ) goto done;
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+	if( (image = mmap( 0, size, PROT_READ, MAP_SHARED, fd, 0 )) == MAP_FAILED ){
+		image = 0;
+	} else {
+		mapped = 1;
+	}
+#endif
+	if( image == 0 ){
+		image = malloc_or_die( size, __FILE__,__LINE__ );
+		for( i = 0; i < size && (n = ok_read( fd, image+i, size-i )) > 0; i += n );
+		if( i != size ) goto done;
+	}
+	memcpy( &header, image, sizeof(header) );
+	n = 0;
+	if( header.sources >= 0 && header.sources < size/(int)sizeof(source) ){
+		n = sizeof(header) + header.sources * sizeof(source);
+	}
+	if( memcmp( header.magic, PC_CACHE_MAGIC, sizeof(header.magic) )
+		|| header.size != size || n == 0 || n >= size
+		|| image[size-1] ){
+		DEBUG1("Read_printcap_cache: '%s' bad format", cache );
+		goto done;
+	}
+	s = image + n;
+	end = image + size;
+	key = Printcap_cache_key( required, path );
+	if( strcmp( s, key ) ){
+		DEBUG1("Read_printcap_cache: '%s' key does not match", cache );
+		goto done;
+	}
+	s += strlen(s)+1;
+	for( i = 0; i < header.sources; ++i ){
+		if( s >= end ) goto done;
+		memcpy( &source, image + sizeof(header) + i*sizeof(source),
+			sizeof(source) );
+		if( stat( s, &statb ) == -1 ){
+			if( source.ino ) break;
+		} else if( source.ino != statb.st_ino || source.size != statb.st_size
+			|| source.mtime != statb.st_mtime
+			|| source.ctime != statb.st_ctime ){
+			break;
+		}
+		s += strlen(s)+1;
+	}
+	if( i < header.sources ){
+		DEBUG1("Read_printcap_cache: '%s' file '%s' changed", cache, s );
+		goto done;
+	}
+	lists[0] = names; counts[0] = header.names;
+	lists[1] = order; counts[1] = header.order;
+	lists[2] = info; counts[2] = header.info;
+	lists[3] = filters; counts[3] = header.filters;
+	/* check that the lines are all there before we use them;
+	 * each line takes at least one byte of the image */
+	for( n = i = 0; i < 4; ++i ){
+		if( counts[i] < 0 || counts[i] > image + size - s - n ){
+			DEBUG1("Read_printcap_cache: '%s' bad line count", cache );
+			goto done;
+		}
+		n += counts[i];
+	}
+	for( end = s, i = 0; i < n && end < image + size; ++i ){
+		end += strlen(end)+1;
+	}
+	if( i < n ){
+		DEBUG1("Read_printcap_cache: '%s' truncated", cache );
+		goto done;
+	}
+	for( i = 0; i < 4; ++i ){
+		Check_max( lists[i], counts[i] );
+		for( j = 0; j < counts[i]; ++j ){
+			lists[i]->list[lists[i]->count++] = safestrdup( s, __FILE__,__LINE__ );
+			s += strlen(s)+1;
+		}
+	}
+	Hash_line_list( names );
+	status = 0;
+	DEBUG1("Read_printcap_cache: '%s' names %d, order %d, info %d, filters %d",
+		cache, header.names, header.order, header.info, header.filters );
+
+ done:
+	if( image ){
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+		if( mapped ) munmap( image, size ); else
+#endif
+		free( image );
+	}
+	close( fd );
+	if( key ) free( key );
+	return( status );
+}
+
+/*
+ * add a 0 terminated string to the cache image
+ */
+
+static void Add_cache_str( char **image, int *len, int *max, const char *s )
+{
+	int n = safestrlen(s) + 1;
+	if( *len + n > *max ){
+		*max += n + LARGEBUFFER;
+		*image = realloc_or_die( *image, *max, __FILE__,__LINE__ );
+	}
+	memcpy( *image + *len, s ? s : "", n );
+	*len += n;
+}
+
+/*
+ * void Write_printcap_cache( int required, char *path, char *cache,
+ *   time_t started, struct line_list *sources,
+ *   struct line_list *names, struct line_list *order,
+ *   struct line_list *info, struct line_list *filters )
+ *  save the printcap lists in the cache file;  the files in sources
+ *  were read at time 'started'
+ */
+
+static void Write_printcap_cache( int required, char *path, char *cache,
+	time_t started, struct line_list *sources,
+	struct line_list *names, struct line_list *order,
+	struct line_list *info, struct line_list *filters )
+{
+	struct pc_cache_header header;
+	struct pc_cache_source source;
+	struct stat statb;
+	struct line_list *lists[4];
+	char *image = 0, *key, *tempfile;
+	int fd, i, j, len, max;
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, PC_CACHE_MAGIC, sizeof(header.magic) );
+	header.sources = sources->count;
+	header.names = names->count;
+	header.order = order->count;
+	header.info = info->count;
+	header.filters = filters->count;
+	len = max = sizeof(header) + sources->count * sizeof(source);
+	image = malloc_or_die( max, __FILE__,__LINE__ );
+	for( i = 0; i < sources->count; ++i ){
+		memset( &source, 0, sizeof(source) );
+		if( stat( sources->list[i], &statb ) == 0 ){
+			/* do not save it if a file might have changed while we read it */
+			if( statb.st_mtime >= started - 1 || statb.st_ctime >= started - 1 ){
+				DEBUG1("Write_printcap_cache: '%s' changed recently",
+					sources->list[i] );
+				free( image );
+				return;
+			}
+			source.ino = statb.st_ino;
+			source.size = statb.st_size;
+			source.mtime = statb.st_mtime;
+			source.ctime = statb.st_ctime;
+		}
+		memcpy( image + sizeof(header) + i*sizeof(source), &source, sizeof(source) );
+	}
+	key = Printcap_cache_key( required, path );
+	Add_cache_str( &image, &len, &max, key );
+	free( key );
+	for( i = 0; i < sources->count; ++i ){
+		Add_cache_str( &image, &len, &max, sources->list[i] );
+	}
+	lists[0] = names; lists[1] = order; lists[2] = info; lists[3] = filters;
+	for( i = 0; i < 4; ++i ){
+		for( j = 0; j < lists[i]->count; ++j ){
+			Add_cache_str( &image, &len, &max, lists[i]->list[j] );
+		}
+	}
+	header.size = len;
+	memcpy( image, &header, sizeof(header) );
+
+	/* write a new file and rename it,  so readers see the old or new one */
+	tempfile = safestrdup2( cache, ".XXXXXX", __FILE__,__LINE__ );
+	if( (fd = mkstemp( tempfile )) < 0 ){
+		DEBUG1("Write_printcap_cache: cannot create '%s' - %s",
+			tempfile, Errormsg(errno) );
+	} else {
+		Max_open(fd);
+		if( fchmod( fd, 0644 ) == -1
+			|| Write_fd_len( fd, image, len ) < 0
+			|| close( fd ) == -1
+			|| rename( tempfile, cache ) == -1 ){
+			logerr(LOG_INFO, "Write_printcap_cache: cannot write '%s'", cache );
+			close( fd );
+			unlink( tempfile );
+		} else {
+			DEBUG1("Write_printcap_cache: '%s' size %d", cache, len );
+		}
+	}
+	free( tempfile );
+	free( image );
+}
+
+/*
+ * void Read_printcap_files( int required, char *path, char *cache,
+ *   struct line_list *names, struct line_list *order,
+ *   struct line_list *info, struct line_list *filters )
+ *  get the printcap entries from the files and filters in path,
+ *  using and updating the compiled printcap cache file if there is one
+ */
+
+void Read_printcap_files( int required, char *path, char *cache,
+	struct line_list *names, struct line_list *order,
+	struct line_list *info, struct line_list *filters )
+{
+	struct line_list raw, sources;
+	time_t started;
+
+	if( !ISNULL(cache)
+		&& Read_printcap_cache( required, path, cache,
+			names, order, info, filters ) == 0 ){
+		return;
+	}
+	Init_line_list(&raw);
+	Init_line_list(&sources);
+	started = time( (void *)0 );
+	Printcap_sources = &sources;
+	Getprintcap_pathlist( required, &raw, filters, path );
+	Printcap_sources = 0;
+	Build_printcap_info( names, order, info, &raw, &Host_IP );
+	Free_line_list( &raw );
+	if( !ISNULL(cache) ){
+		Write_printcap_cache( required, path, cache, started, &sources,
+			names, order, info, filters );
+	}
+	Free_line_list( &sources );
+}
+
 
 /***************************************************************************
  * int In_group( char* *group, char *user );
@@ -985,7 +985,11 @@ int Link_send( char *host, int *sock, int timeout,
  *    if timeout == 0, wait indefinitely
  *    if count < 0, will read until end of file
  *      returns 0 if successful, LINK errorcode if failure
+ *    A regular file is copied with sendfile() where it is available,
+ *    in chunks of SENDFILE_CHUNK bytes with the write timeout applied
+ *    to each chunk;  other files are read and written through a buffer.
  ***************************************************************************/
+
 int Link_copy( char *host, int *sock, int readtimeout, int writetimeout,
 	const char *src, int fd, double pcount)
 {
@@ -994,6 +998,8 @@ int Link_copy( char *host, int *sock, int readtimeout, int writetimeout,
 	int status;				/* status of operation */
 	double count;	/* might be clobbered by longjmp */
 	int err;					/* saved error status */
+	int done = 0, sent = 0;
+	struct stat statb;
 
 	count = pcount;
 	len = status = 0;	/* shut up GCC */
@@ -1004,8 +1010,40 @@ int Link_copy( char *host, int *sock, int readtimeout, int writetimeout,
 		DEBUGF(DNW4)( "Link_copy: bad socket" );
 		return (LINK_OPEN_FAIL);
 	}
+	/* let the kernel copy a regular file */
+	if( fstat( fd, &statb ) == 0 && S_ISREG( statb.st_mode ) ){
+		while( !done && (count > 0 || pcount == 0) ){
+			len = SENDFILE_CHUNK;
+			if( pcount && len > count ) len = count;
+			len = Sendfile_fd_len_timeout( writetimeout, *sock, fd, len );
+			err = errno;
+			DEBUGF(DNW4)("Link_copy: sendfile %d bytes", len );
+			if( len == -2 && !sent ){
+				/* not supported, use read and write */
+				break;
+			}
+			done = 1;
+			if( len < 0 || Alarm_timed_out ){
+				DEBUGF(DNW4)("Link_copy: sendfile to '%s' failed - %s",
+					host, Alarm_timed_out?"timeout":Errormsg(err) );
+				status = LINK_TRANSFER_FAIL;
+			} else if( len == 0 ){
+				/* EOF on input */
+				if( pcount && count > 0 ){
+					DEBUGF(DNW4)(
+						"Link_copy: read from '%s' failed, %0.0f bytes left",
+						src, count );
+					status = LINK_TRANSFER_FAIL;
+				}
+			} else {
+				sent = 1;
+				done = 0;
+				if( pcount ) count -= len;
+			}
+		}
+	}
 	/* do the read */
-	while( status == 0 && (count > 0 || pcount == 0) ){
+	while( !done && status == 0 && (count > 0 || pcount == 0) ){
 		len = sizeof(buf);
 		if( pcount && len > count ) len = count;
 		/* do the read with timeout */
@@ -1044,7 +1082,8 @@ int Link_copy( char *host, int *sock, int readtimeout, int writetimeout,
 		}
 	}
 	
-	if( status == 0 ){
+	/* with forward_pipeline the ACKs arrive while we copy */
+	if( status == 0 && Check_for_protocol_violations_DYN ){
 		/* check to see if you have some additional stuff pending */
 		fd_set readfds;
 		struct timeval delay;
@@ -1261,6 +1300,9 @@ int Link_read(char *host, int *sock, int timeout,
  *      terminate action with error.
  *    if timeout == 0, wait indefinitely
  *    returns 0 *count not read
+ *    If the count is known and fd is a regular file the data is
+ *    moved from the socket to the file through a pipe with splice()
+ *    where it is available, and does not pass through our buffer.
  *
  ***************************************************************************/
 
@@ -1273,6 +1315,8 @@ int Link_file_read(char *host, int *sock, int readtimeout, int writetimeout,
 	int err;					/* error */
 	double len;
 	double readcount;
+	int pipefd[2];
+	struct stat statb;
 
 	len = i = status = cnt = 0;	/* shut up GCC */
 	readcount = 0;
@@ -1288,8 +1332,49 @@ int Link_file_read(char *host, int *sock, int readtimeout, int writetimeout,
 	 * set up timeout and then do the transfer
 	 */
 
-	/* do the read */
 	len = *count;
+	if( len > 0 && fstat( fd, &statb ) == 0 && S_ISREG( statb.st_mode )
+		&& pipe( pipefd ) == 0 ){
+		while( status == 0 && len > 0 ){
+			l = SENDFILE_CHUNK;
+			if( l > len ) l = len;
+			i = Splice_fd_len_timeout( readtimeout, *sock, pipefd[1], l );
+			err = errno;
+			if( i == -2 && readcount == 0 ){
+				/* not supported, use read and write */
+				DEBUGF(DNW2)("Link_file_read: cannot splice from '%s'", host );
+				break;
+			}
+			if( Alarm_timed_out ){
+				DEBUGF(DNW2)( "Link_file_read: read from '%s' timed out", host);
+				status = LINK_TRANSFER_FAIL;
+			} else if( i > 0 ){
+				DEBUGF(DNW2)("Link_file_read: len %0.0f, readlen %d, spliced %d", len, l, i );
+				len -= i;
+				readcount += i;
+				/* now empty the pipe into the file */
+				while( status == 0 && i > 0 ){
+					cnt = Splice_fd_len_timeout( writetimeout, pipefd[0], fd, i );
+					err = errno;
+					if( Alarm_timed_out || cnt <= 0 ){
+						DEBUGF(DNW2)( "Link_file_read: write %d to fd %d failed - %s",
+							i, fd, Errormsg(err) );
+						status = LINK_TRANSFER_FAIL;
+					} else {
+						i -= cnt;
+					}
+				}
+			} else {
+				DEBUGF(DNW2)("Link_file_read: read from '%s' failed - %s",
+					host, Errormsg(err) );
+				status = LINK_TRANSFER_FAIL;
+			}
+		}
+		close( pipefd[0] );
+		close( pipefd[1] );
+	}
+
+	/* do the read */
 	while( status == 0 && (*count == 0 || len > 0) ){
 		DEBUGF(DNW2)("Link_file_read: doing data read" );
 		l = sizeof(str);
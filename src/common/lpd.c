@@ -21,7 +21,9 @@
 #include "lpd_worker.h"
 #include "lpd_jobs.h"
 #include "lpd_dispatch.h"
+#include "lpd_pool.h"
 #include "user_auth.h"
+#include "permission.h"
 
 /* force local definitions */
 #undef EXTERN
@@ -40,6 +42,8 @@
 #endif /* not IPP_STUBS */
  char* Lpd_port_arg;	/* command line port value */
  char* Lpd_socket_arg; /* command line unix socket value */
+ int Notify_fd = -1;	/* spool directory notification fd */
+ struct line_list Notify_line_list;	/* watch descriptor=printer */
 
 #if HAVE_TCPD_H
 #include <tcpd.h>
@@ -47,6 +51,11 @@
  int deny_severity = LOG_WARNING;
 #endif
 
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_INOTIFY_INIT)
+#include <sys/inotify.h>
+#define SPOOL_NOTIFY 1
+#endif
+
 
 /**** ENDINCLUDE ****/
 
@@ -165,6 +174,8 @@ int main(int argc, char *argv[], char *envp[])
 	}
 
 	Setup_configuration();
+	/* compile the permissions once,  the server processes inherit them */
+	Compile_perms( &Perm_line_list );
 
 	/* get the maximum number of servers allowed */
 	max_servers = Get_max_servers();
@@ -302,6 +313,7 @@ int main(int argc, char *argv[], char *envp[])
 	Set_lpd_pid( lockfd );
 #endif
 
+	Make_daemon_files();
 
 	if( Drop_root_DYN ){
 		Full_daemon_perms();
@@ -334,6 +346,9 @@ int main(int argc, char *argv[], char *envp[])
 	/* open a connection to logger */
 	setmessage(0,LPD,"Starting");
 
+	/* watch the spool directories reported by Start_all() */
+	Setup_spool_notify();
+
 	/*
 	 * set up the select parameters
 	 */
@@ -345,6 +360,7 @@ int main(int argc, char *argv[], char *envp[])
 	if( ipp_sock > 0 ) FD_SET( ipp_sock, &defreadfds );
 #endif /* not IPP_STUBS */
 	FD_SET( request_pipe[0], &defreadfds );
+	if( Notify_fd > 0 ) FD_SET( Notify_fd, &defreadfds );
 
 	/*
 	 * start waiting for connections from processes
@@ -422,6 +438,7 @@ int main(int argc, char *argv[], char *envp[])
 			if( pid == start_pid ){
 				start_pid = -1;
 			}
+			Pool_reaped( pid );
 			last_fork_pid_value = 0;
 		}
 
@@ -618,7 +635,8 @@ int main(int argc, char *argv[], char *envp[])
 			Started_server, (long)last_fork_pid_value, Countpid(), max_servers );
 		/* do not accept incoming call if no worker available */
 		readfds = defreadfds;
-		if( Countpid() >= max_servers || last_fork_pid_value < 0 ){
+		if( (Countpid() >= max_servers && !Pool_idle_workers())
+			|| last_fork_pid_value < 0 ){
 			DEBUG1( "lpd: not accepting requests" );
 			if( sock > 0 ) FD_CLR( sock, &readfds );
 			if( unix_sock > 0 ) FD_CLR( unix_sock, &readfds );
@@ -632,12 +650,16 @@ int main(int argc, char *argv[], char *envp[])
 		if( request_pipe[0] >= max_socks ){
 			max_socks = request_pipe[0]+1;
 		}
+		if( Notify_fd >= max_socks ){
+			max_socks = Notify_fd+1;
+		}
 		if( start_fd > 0 ){
 			FD_SET( start_fd, &readfds );
 			if( start_fd >= max_socks ){
 				max_socks = start_fd+1;
 			}
 		}
+		Pool_fdset( &readfds, &max_socks );
 
 		DEBUG1( "lpd: starting select timeout '%s', %d sec, max_socks %d",
 		timeout?"yes":"no", (int)(timeout?timeout->tv_sec:0), max_socks );
@@ -673,8 +695,12 @@ int main(int argc, char *argv[], char *envp[])
 				if( logger_process_pid > 0 ) kill( logger_process_pid, SIGINT );
 				setmessage(0,LPD,"Restart");
 				Reread_config = 0;
+				/* pool workers have the old configuration */
+				Pool_shutdown();
 			}
 			Setup_configuration();
+			Compile_perms( &Perm_line_list );
+			Make_daemon_files();
 		}
 		/* mark this as a timeout */
 		if( fd_available < 0 ){
@@ -690,6 +716,8 @@ int main(int argc, char *argv[], char *envp[])
 			if( last_fork_pid_value < 0 ) last_fork_pid_value = 1;
 			continue;
 		}
+		/* find the pool workers that are ready for another connection */
+		Pool_read( &readfds );
 		if( sock > 0 && FD_ISSET( sock, &readfds ) ){
 			DEBUG1("lpd: accept on LPD socket");
 			Accept_connection( sock );
@@ -712,6 +740,12 @@ int main(int argc, char *argv[], char *envp[])
 		if( start_fd > 0 && FD_ISSET( start_fd, &readfds ) ){
 			start_fd = Read_server_status( start_fd );
 		}
+		if( Notify_fd > 0 && FD_ISSET( Notify_fd, &readfds )
+			&& Read_spool_notify() ){
+			/* we lost events, so force a rescan */
+			Started_server = 1;
+			last_time = 0;
+		}
 	}while( 1 );
 	Free_line_list(&args);
 	cleanup(0);
@@ -821,19 +855,84 @@ int Lock_lpd_pid(void)
 	return(lockfd);
 }
 
+/*
+ * Make_daemon_file( char *path )
+ *  create a file that lpd updates after it has given up root,
+ *  such as the dns cache and the queue scan summary,  and give it
+ *  to the daemon user,  as is done for the lock file
+ */
+
+static void Make_daemon_file( char *path )
+{
+	int fd;
+	struct stat statb;
+	int euid = geteuid();
+
+	if( ISNULL(path) ) return;
+	To_euid_root();
+	fd = Checkwrite( path, &statb, O_RDWR, 1, 0 );
+	if( fd < 0 ){
+		logerr(LOG_INFO, _("lpd: Cannot create '%s'"), path );
+	} else {
+#if !defined(__CYGWIN__)
+		if( fchown( fd, DaemonUID, DaemonGID ) ){
+			logerr(LOG_INFO, _("lpd: Cannot chown '%s'"), path );
+		}
+		fchmod( fd, (statb.st_mode & ~0777) | 0644 );
+#endif
+		close( fd );
+	}
+	To_euid(euid);
+}
+
+static void Make_daemon_files( void )
+{
+	Make_daemon_file( Dns_cache_DYN );
+	Make_daemon_file( Queue_scan_summary_DYN );
+}
+
+/*
+ * the requests are written one per line;  a line that has not all
+ * arrived is kept until the next call for the same fd:  lpd reads
+ * the request pipe and the output of the queue scan
+ */
+struct server_status_tail {
+	int fd;			/* fd the line came from,  -1 if unused */
+	int len;
+	char buffer[LARGEBUFFER];
+};
+static struct server_status_tail Server_status_tails[2] =
+	{ { -1, 0, {0} }, { -1, 0, {0} } };
+
 int Read_server_status( int fd )
 {
-	int status, count, found, n;
-	char buffer[LINEBUFFER];
-	char *name;
+	int status, len, i;
+	char *buffer, *end;
 	fd_set readfds;	/* for select() */
 	struct timeval timeval;
 	struct line_list l;
+	struct server_status_tail *tail;
 
-	buffer[0] = 0;
+	tail = 0;
+	for( i = 0; !tail && i < 2; ++i ){
+		if( Server_status_tails[i].fd == fd ) tail = &Server_status_tails[i];
+	}
+	for( i = 0; !tail && i < 2; ++i ){
+		if( Server_status_tails[i].len == 0 ) tail = &Server_status_tails[i];
+	}
+	if( !tail ){
+		tail = &Server_status_tails[1];
+		logmsg( LOG_INFO, "Read_server_status: dropping partial line from fd %d",
+			tail->fd );
+		tail->len = 0;
+	}
+	tail->fd = fd;
+	buffer = tail->buffer;
 	errno = 0;
+	len = tail->len;
+	buffer[len] = 0;
 
-	DEBUG1( "Read_server_status: starting" );
+	DEBUG1( "Read_server_status: starting, %d bytes kept", len );
 
 	Init_line_list(&l);
 	while(1){
@@ -848,34 +947,38 @@ int Read_server_status( int fd )
 		} else if( status < 0 ){
 			close(fd);
 			fd = 0;
+			len = 0;
 			break;
 		}
-		status = ok_read(fd,buffer,sizeof(buffer)-1);
+		status = ok_read(fd,buffer+len,sizeof(tail->buffer)-1-len);
 		DEBUG1( "Read_server_status: read status %d", status );
 		if( status <= 0 ){
+			/* a line cut short by the writer exiting is dropped */
 			close(fd);
 			fd = -1;
+			len = 0;
 			break;
 		}
-		buffer[status] = 0;
+		len += status;
+		buffer[len] = 0;
 		DEBUG1( "Read_server_status: read status %d '%s'", status, buffer );
-		/* we split up read line and record information */
-		Split(&l,buffer,Whitespace,0,0,0,0,0,0);
-		if(DEBUGL1)Dump_line_list("Read_server_status - input", &l );
-		for( count = 0; count < l.count; ++count ){ 
-			name = l.list[count];
-			if( ISNULL(name) ) continue;
-			found = 0;
-			for( n = 0;!found && n < Servers_line_list.count; ++n ){
-				found = !safestrcasecmp( Servers_line_list.list[n], name);
+		if( (end = strrchr( buffer, '\n' )) == 0 ){
+			if( len >= (int)sizeof(tail->buffer)-1 ){
+				logmsg( LOG_INFO, "Read_server_status: line too long, discarded" );
+				len = 0;
 			}
-			if( !found ){
-				Add_line_list(&Servers_line_list,name,0,0,0);
-			}
-			Started_server = 1;
+			continue;
 		}
+		/* we split up the complete lines and record information */
+		*end++ = 0;
+		Split(&l,buffer,Whitespace,0,0,0,0,0,0);
+		len = buffer+len - end;
+		memmove(buffer,end,len+1);
+		Add_server_requests( &l );
 		Free_line_list(&l);
 	}
+	tail->len = len;
+	if( len == 0 ) tail->fd = -1;
 	Free_line_list(&l);
 
 #ifdef DMALLOC
@@ -900,6 +1003,133 @@ int Read_server_status( int fd )
 	return(fd);
 }
 
+/***************************************************************************
+ * Add_server_requests( struct line_list *l )
+ *  - names of queues that need service are added to Servers_line_list
+ *  - @printer=spooldir entries are spool directories to watch
+ ***************************************************************************/
+
+static void Add_server_requests( struct line_list *l )
+{
+	int count;
+	char *name;
+
+	if(DEBUGL1)Dump_line_list("Add_server_requests - input", l );
+	for( count = 0; count < l->count; ++count ){ 
+		name = l->list[count];
+		if( ISNULL(name) ) continue;
+		if( cval(name) == '@' ){
+			Add_spool_notify( name+1 );
+			continue;
+		}
+		Add_server_request( name );
+		Started_server = 1;
+	}
+}
+
+static void Add_server_request( const char *name )
+{
+	int found, n;
+	for( found = n = 0; !found && n < Servers_line_list.count; ++n ){
+		found = !safestrcasecmp( Servers_line_list.list[n], name);
+	}
+	if( !found ){
+		Add_line_list(&Servers_line_list,name,0,0,0);
+	}
+}
+
+/***************************************************************************
+ * Spool directory notification
+ *  On systems with inotify, lpd watches the spool directories
+ *  reported by Service_all() and starts a queue server when a job
+ *  ticket file is renamed into the spool directory.  Jobs received by
+ *  lpd itself already request service using the Lpd_request pipe,
+ *  so we only watch for renames, not for every update of the files.
+ ***************************************************************************/
+
+static void Setup_spool_notify( void )
+{
+#if defined(SPOOL_NOTIFY)
+	if( Spool_notify_DYN && Notify_fd < 0 ){
+		if( (Notify_fd = inotify_init()) < 0 ){
+			logerr(LOG_INFO, _("lpd: inotify_init failed, not watching spool directories") );
+		} else {
+			Max_open(Notify_fd);
+			DEBUG1( "Setup_spool_notify: fd %d", Notify_fd );
+		}
+	}
+#endif
+}
+
+static void Add_spool_notify( char *entry )
+{
+#if defined(SPOOL_NOTIFY)
+	char *dir, wd[32];
+	int n;
+
+	if( Notify_fd <= 0 || !(dir = safestrchr( entry, '=' )) ) return;
+	*dir = 0;
+	if( (n = inotify_add_watch( Notify_fd, dir+1, IN_MOVED_TO )) < 0 ){
+		DEBUG1( "Add_spool_notify: cannot watch '%s' - %s",
+			dir+1, Errormsg(errno) );
+	} else {
+		plp_snprintf( wd, sizeof(wd), "%d", n );
+		DEBUG2( "Add_spool_notify: printer '%s', dir '%s', wd %s",
+			entry, dir+1, wd );
+		Set_str_value( &Notify_line_list, wd, entry );
+	}
+	*dir = '=';
+#endif
+}
+
+/*
+ * returns nonzero if events were lost and the queues need to be rescanned
+ */
+
+static int Read_spool_notify( void )
+{
+	int rescan = 0;
+#if defined(SPOOL_NOTIFY)
+	union {
+		struct inotify_event event;
+		char buffer[LARGEBUFFER];
+	} in;
+	struct inotify_event *event;
+	char *s, wd[32];
+	int n, i;
+
+	n = ok_read( Notify_fd, in.buffer, sizeof(in.buffer) );
+	DEBUG1( "Read_spool_notify: read %d", n );
+	if( n <= 0 ){
+		logerr(LOG_INFO, _("lpd: read of spool directory events failed") );
+		close( Notify_fd );
+		Notify_fd = -1;
+		Free_line_list( &Notify_line_list );
+		return( 1 );
+	}
+	for( i = 0; i + (int)sizeof(in.event) <= n; i += sizeof(in.event) + event->len ){
+		event = (struct inotify_event *)(in.buffer + i);
+		plp_snprintf( wd, sizeof(wd), "%d", event->wd );
+		if( event->mask & IN_Q_OVERFLOW ){
+			rescan = 1;
+			continue;
+		}
+		if( event->mask & IN_IGNORED ){
+			Set_str_value( &Notify_line_list, wd, 0 );
+			continue;
+		}
+		s = event->len ? event->name : 0;
+		if( !s || cval(s) != 'h' || cval(s+1) != 'f' ) continue;
+		if( (s = Find_str_value( &Notify_line_list, wd )) ){
+			DEBUG1( "Read_spool_notify: '%s' in queue '%s'", event->name, s );
+			Add_server_request( s );
+			Started_server = 1;
+		}
+	}
+#endif
+	return( rescan );
+}
+
 /***************************************************************************
  * void Get_parms(int argc, char *argv[])
  * 1. Scan the argument list and get the flags
@@ -968,6 +1198,7 @@ static void Accept_connection( int sock )
 	int newsock, err;
 	pid_t pid;
 	socklen_t len;
+	char buffer[SMALLBUFFER];
 	Init_line_list(&args);
 	len = sizeof( sinaddr );
 	newsock = accept( sock, &sinaddr, &len );
@@ -996,6 +1227,22 @@ static void Accept_connection( int sock )
 		}
 #endif
 
+		/* try to hand it to a pool worker first */
+		if( Pool_dispatch( newsock ) == 0 ){
+			close( newsock );
+			Free_line_list(&args);
+			return;
+		}
+		/* we may have accepted this for an idle pool worker that
+		 * could not take it,  so check the process limit */
+		if( Countpid() >= Get_max_servers() ){
+			logmsg(LOG_INFO, "lpd: no pool worker available and server limit reached" );
+			plp_snprintf( buffer, sizeof(buffer), "\002%s\n", _("Server load too high") );
+			Write_fd_str( newsock, buffer );
+			close( newsock );
+			Free_line_list(&args);
+			return;
+		}
 		pid = Start_worker( "server", Service_connection, &args, newsock );
 		if( pid < 0 ){
 			logerr(LOG_INFO, _("lpd: fork() failed") );
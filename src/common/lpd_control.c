@@ -396,7 +396,7 @@ static void Do_queue_control( char *user, int action, int *sock,
 			*end = 0;
 		}
 		DEBUGF(DCTRL1)("Do_queue_control: msg '%s'", start );
-		if( Lpq_status_file_DYN ) unlink(Lpq_status_file_DYN );
+		Queue_status_changed();
 		Set_str_value(&Spool_control,MSG,start);
 		break;
 
@@ -438,7 +438,7 @@ static void Do_queue_control( char *user, int action, int *sock,
 		break;
 
 	case OP_FLUSH:
-		if( Lpq_status_file_DYN ) unlink(Lpq_status_file_DYN );
+		Queue_status_changed();
 		{
 			char *file;
 			int fd = -1;
@@ -452,6 +452,16 @@ static void Do_queue_control( char *user, int action, int *sock,
 				ftruncate( fd, 0);
 				close(fd);
 			}
+			if( (file = Queue_status_file_DYN) ){
+				file = Status_file_segment( file );
+				unlink( file );
+				free( file ); file = 0;
+			}
+			if( (file = Status_file_DYN) ){
+				file = Status_file_segment( file );
+				unlink( file );
+				free( file ); file = 0;
+			}
 		}
 		signal_server = 0;
 		break;
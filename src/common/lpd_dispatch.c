@@ -21,6 +21,7 @@
 #include "fileopen.h"
 #include "permission.h"
 #include "proctitle.h"
+#include "lockfile.h"
 #include "lpd_rcvjob.h"
 #include "lpd_remove.h"
 #include "lpd_status.h"
@@ -28,7 +29,11 @@
 #include "lpd_secure.h"
 #include "krb5_auth.h"
 #include "lpd_dispatch.h"
+#include "lpd_pool.h"
+#include "fanout.h"
 
+static void Setup_connection( int talk, char *from_addr, int from_len );
+static int Read_request( int talk, const char *from_addr, char *input, int maxlen );
 static void Service_lpd( int talk, const char *from_addr ) NORETURN;
 
 void Dispatch_input(int *talk, char *input, const char *from_addr )
@@ -65,73 +70,246 @@ void Dispatch_input(int *talk, char *input, const char *from_addr )
 	}
 }
 
+/***************************************************************************
+ * Service_all( struct line_list *args, int reportfd )
+ *  check all of the queues and report the ones that need a server
+ *  to lpd on reportfd.  The queues are checked in batches by up to
+ *  queue_scan_workers processes at once (see Fanout_status()).
+ *
+ *  A queue that was empty and idle when it was last checked is recorded
+ *  in the queue_scan_summary file with its spool directory and the
+ *  modification time of the directory:
+ *     printer=mtime name spooldir
+ *  A job arriving or leaving, or a change to the queue control file,
+ *  updates the directory modification time.  If it has not changed we
+ *  do not need to set up the printer and scan the queue again.
+ *  Recently changed directories are not recorded, as a job may arrive
+ *  within the resolution of the time stamp.
+ ***************************************************************************/
+
+struct service_all {
+	struct line_list *summary;	/* last summary */
+	struct line_list *newsummary;	/* summary being collected */
+	int batch;			/* queues per batch */
+	int reportfd;
+	time_t start_time;
+};
+
+static int Service_batch( int n, int fd, void *arg );
+static int Service_batch_summary( int n, char *output, int len, void *arg );
+static void Service_queue( char *pr, int reportfd, int summaryfd,
+	struct service_all *all );
+
 void Service_all( struct line_list *args, int reportfd )
 {
-	int i, printable, held, move, printing_enabled,
-		server_pid, change, error, done, do_service;
-	char buffer[SMALLBUFFER], *pr, *forwarding;
-	int first_scan;
-	char *remove_prefix = 0;
+	struct line_list summary, newsummary;
+	struct service_all all;
+	int i, batches, workers, fd, len, size;
+	char *buffer;
+	struct stat statb;
 
 	/* we start up servers while we can */
 	Name = "SERVICEALL";
 	setproctitle( "lpd %s", Name );
 
-	first_scan = Find_flag_value(args,FIRST_SCAN);
 	Free_line_list(args);
+	Init_line_list(&summary);
+	Init_line_list(&newsummary);
+	buffer = 0; len = size = 0;
 
 	if(All_line_list.count == 0 ){
 		Get_all_printcap_entries();
 	}
-	for( i = 0; i < All_line_list.count; ++i ){
-		Set_DYN(&Printer_DYN,0);
-		Set_DYN(&Spool_dir_DYN,0);
-		pr = All_line_list.list[i];
-		DEBUG1("Service_all: checking '%s'", pr );
-		if( Setup_printer( pr, buffer, sizeof(buffer), 0) ) continue;
-		/* now check to see if there is a server and unspooler process active */
-		server_pid = 0;
-		remove_prefix = 0;
-		if( first_scan ){
-			remove_prefix = Fifo_lock_file_DYN;
+	/* lpd creates the summary file as root when it starts up;
+	 * if another process is updating it we do without */
+	fd = -1;
+	if( !ISNULL(Queue_scan_summary_DYN)
+		&& (fd = Checkwrite( Queue_scan_summary_DYN, &statb, O_RDWR, 1, 0 )) >= 0 ){
+		if( Do_lock( fd, 0 ) < 0 ){
+			DEBUG1("Service_all: '%s' locked by another process",
+				Queue_scan_summary_DYN );
+			close( fd ); fd = -1;
+		} else {
+			Get_fd_image_and_split( fd, 0, 0, &summary,
+				Line_ends, 1, Hash_value_sep, 1, 0, 0, 0 );
 		}
-		server_pid = Read_pid_from_file( Printer_DYN );
-		DEBUG3("Service_all: printer '%s' checking server pid %d", Printer_DYN, server_pid );
-		if( server_pid > 0 && kill( server_pid, 0 ) == 0 ){
-			DEBUG3("Get_queue_status: server %d active", server_pid );
-			continue;
+	}
+	memset( &all, 0, sizeof(all) );
+	all.summary = &summary;
+	all.newsummary = &newsummary;
+	all.reportfd = reportfd;
+	all.start_time = time( (void *)0 );
+
+	/* a few batches per worker, so a slow queue does not hold up the rest */
+	workers = Queue_scan_workers_DYN;
+	if( workers < 1 ) workers = 1;
+	all.batch = (All_line_list.count + 4*workers - 1)/(4*workers);
+	if( all.batch < 32 ) all.batch = 32;
+	batches = (All_line_list.count + all.batch - 1)/all.batch;
+	DEBUG1("Service_all: %d queues, %d batches of %d, %d workers",
+		All_line_list.count, batches, all.batch, workers );
+
+	if( workers > 1 && batches > 1 ){
+		Fanout_status( batches, workers, Service_batch,
+			Service_batch_summary, &all );
+	} else {
+		for( i = 0; i < All_line_list.count; ++i ){
+			Service_queue( All_line_list.list[i], reportfd, -1, &all );
 		}
-		change = Find_flag_value(&Spool_control,CHANGE);
-		printing_enabled = !(Pr_disabled(&Spool_control) || Pr_aborted(&Spool_control));
+	}
 
-		Free_line_list( &Sort_order );
-		if( Scan_queue( &Spool_control, &Sort_order,
-				&printable,&held,&move, 1, &error, &done, 0, 0  ) ){
-			continue;
+	/* save the summary for the next time,  in place:  the daemon user
+	 * cannot create a new file in the directory.  A summary cut short
+	 * only causes the queues that are missing to be checked again. */
+	if( fd >= 0 ){
+		for( i = 0; i < newsummary.count; ++i ){
+			Put_buf_str( newsummary.list[i], &buffer, &size, &len );
+			Put_buf_str( "\n", &buffer, &size, &len );
 		}
-		forwarding = Find_str_value(&Spool_control,FORWARDING);
-		do_service = 0;
-		if( !(Save_when_done_DYN || Save_on_error_DYN )
-			&& (Done_jobs_DYN || Done_jobs_max_age_DYN)
-			&& (error || done ) ){
-			do_service = 1;
-		}
-		if( do_service || change || move || (printable && (printing_enabled||forwarding)) ){
-			if( Server_queue_name_DYN ){
-				pr = Server_queue_name_DYN;
-			} else {
-				pr = Printer_DYN;;
-			}
-			DEBUG1("Service_all: starting '%s'", pr );
-			plp_snprintf(buffer,sizeof(buffer), ".%s\n",pr );
-			if( Write_fd_str(reportfd,buffer) < 0 ) cleanup(0);
+		if( lseek( fd, 0, SEEK_SET ) == -1 || ftruncate( fd, 0 ) == -1
+			|| (len && Write_fd_len( fd, buffer, len ) < 0) ){
+			logerr(LOG_INFO, "Service_all: cannot update '%s'",
+				Queue_scan_summary_DYN );
 		}
+		close( fd ); fd = -1;
+		free( buffer ); buffer = 0;
 	}
+	Free_line_list( &summary );
+	Free_line_list( &newsummary );
 	Free_line_list( &Sort_order );
 	Errorcode = 0;
 	cleanup(0);
 }
 
+/*
+ * check batch n of the queues.  The start requests go to lpd directly
+ *  so the servers are started as soon as possible;  the summary lines
+ *  are written to fd and collected by Service_batch_summary()
+ */
+
+static int Service_batch( int n, int fd, void *arg )
+{
+	struct service_all *all = arg;
+	int i;
+
+	setproctitle( "lpd %s %d", Name, n );
+	for( i = n*all->batch; i < (n+1)*all->batch && i < All_line_list.count; ++i ){
+		Service_queue( All_line_list.list[i], all->reportfd, fd, all );
+	}
+	Free_line_list( &Sort_order );
+	return( 0 );
+}
+
+static int Service_batch_summary( int n, char *output, int len, void *arg )
+{
+	struct service_all *all = arg;
+	struct line_list l;
+	int i;
+
+	DEBUG3("Service_batch_summary: batch %d, len %d", n, len );
+	if( output ){
+		Init_line_list(&l);
+		Split(&l,output,Line_ends,0,0,0,0,0,0);
+		for( i = 0; i < l.count; ++i ){
+			Add_line_list(all->newsummary,l.list[i],Hash_value_sep,1,1);
+		}
+		Free_line_list(&l);
+	}
+	return( 0 );
+}
+
+/*
+ * check the queue and tell lpd on reportfd if it needs service.
+ *  If summaryfd < 0 we add the summary line directly.
+ */
+
+static void Service_queue( char *pr, int reportfd, int summaryfd,
+	struct service_all *all )
+{
+	int printable, held, move, printing_enabled,
+		server_pid, change, error, done, do_service;
+	char buffer[SMALLBUFFER], *s, *name, *forwarding;
+	struct stat statb;
+	time_t mtime;
+
+	/* no change since the last time it was checked and idle */
+	if( (s = Find_str_value( all->summary, pr ))
+		&& (mtime = strtol( s, &s, 10 )) > 0
+		&& (name = strtok( s, Whitespace )) && (s = strtok( 0, Whitespace ))
+		&& stat( s, &statb ) == 0 && statb.st_mtime == mtime ){
+		DEBUG2("Service_all: '%s' unchanged", pr );
+		if( Spool_notify_DYN ){
+			plp_snprintf(buffer,sizeof(buffer), "@%s=%s\n", name, s );
+			if( Write_fd_str(reportfd,buffer) < 0 ) cleanup(0);
+		}
+		plp_snprintf(buffer,sizeof(buffer), "%s=%ld %s %s",
+			pr, (long)mtime, name, s );
+		goto summary;
+	}
+
+	Set_DYN(&Printer_DYN,0);
+	Set_DYN(&Spool_dir_DYN,0);
+	DEBUG1("Service_all: checking '%s'", pr );
+	if( Setup_printer( pr, buffer, sizeof(buffer), 0) ) return;
+	name = Server_queue_name_DYN?Server_queue_name_DYN:Printer_DYN;
+	/* tell lpd which spool directory to watch for this queue */
+	if( Spool_notify_DYN && !safestrpbrk( Spool_dir_DYN, Whitespace )
+		&& safestrlen(Spool_dir_DYN) + safestrlen(Printer_DYN) + 4 < (int)sizeof(buffer) ){
+		plp_snprintf(buffer,sizeof(buffer), "@%s=%s\n", name, Spool_dir_DYN );
+		if( Write_fd_str(reportfd,buffer) < 0 ) cleanup(0);
+	}
+	/* now check to see if there is a server and unspooler process active */
+	server_pid = Read_pid_from_file( Printer_DYN );
+	DEBUG3("Service_all: printer '%s' checking server pid %d", Printer_DYN, server_pid );
+	if( server_pid > 0 && kill( server_pid, 0 ) == 0 ){
+		DEBUG3("Get_queue_status: server %d active", server_pid );
+		return;
+	}
+	/* the directory time before we look at the jobs */
+	mtime = 0;
+	if( !safestrpbrk( Spool_dir_DYN, Whitespace )
+		&& stat( Spool_dir_DYN, &statb ) == 0
+		&& statb.st_mtime < all->start_time - 1 ){
+		mtime = statb.st_mtime;
+	}
+	change = Find_flag_value(&Spool_control,CHANGE);
+	printing_enabled = !(Pr_disabled(&Spool_control) || Pr_aborted(&Spool_control));
+
+	Free_line_list( &Sort_order );
+	if( Scan_queue( &Spool_control, &Sort_order,
+			&printable,&held,&move, 1, &error, &done, 0, 0  ) ){
+		return;
+	}
+	forwarding = Find_str_value(&Spool_control,FORWARDING);
+	do_service = 0;
+	if( !(Save_when_done_DYN || Save_on_error_DYN )
+		&& (Done_jobs_DYN || Done_jobs_max_age_DYN)
+		&& (error || done ) ){
+		do_service = 1;
+	}
+	if( do_service || change || move || (printable && (printing_enabled||forwarding)) ){
+		DEBUG1("Service_all: starting '%s'", name );
+		plp_snprintf(buffer,sizeof(buffer), ".%s\n",name );
+		if( Write_fd_str(reportfd,buffer) < 0 ) cleanup(0);
+		return;
+	}
+	if( mtime == 0 || Sort_order.count
+		|| safestrlen(Spool_dir_DYN) + safestrlen(pr) + safestrlen(name) + 32
+			> (int)sizeof(buffer) ){
+		return;
+	}
+	plp_snprintf(buffer,sizeof(buffer), "%s=%ld %s %s",
+		pr, (long)mtime, name, Spool_dir_DYN );
+
+ summary:
+	if( summaryfd < 0 ){
+		Add_line_list(all->newsummary,buffer,Hash_value_sep,1,1);
+	} else if( Write_fd_str( summaryfd, buffer ) < 0
+		|| Write_fd_str( summaryfd, "\n" ) < 0 ){
+		cleanup(0);
+	}
+}
+
 /***************************************************************************
  * Service_connection( struct line_list *args )
  *  Service the connection on the talk socket
@@ -149,11 +327,7 @@ void Service_connection( struct line_list *args, int talk )
 	int status;		/* status of operation */
 #endif /* IPP_STUBS */
 	char from_addr[128];
-	int permission;
-	int port = 0;
-	struct sockaddr sinaddr;
 
-	memset( &sinaddr, 0, sizeof(sinaddr) );
 	Name = "SERVER";
 	setproctitle( "lpd %s", Name );
 	(void) plp_signal (SIGHUP, cleanup );
@@ -167,6 +341,63 @@ void Service_connection( struct line_list *args, int talk )
 
 	Free_line_list(args);
 
+	Setup_connection( talk, from_addr, sizeof(from_addr) );
+
+#ifdef IPP_STUBS
+	memset(input,0,sizeof(input));
+
+	do {
+		int my_len = sizeof( input ) - 1;
+		static int timeout;
+		timeout = (Send_job_rw_timeout_DYN>0)?Send_job_rw_timeout_DYN:
+					((Connect_timeout_DYN>0)?Connect_timeout_DYN:10);
+		DEBUG1( "Service_connection: doing peek for %d on fd %d, timeout %d",
+			my_len, talk, timeout );
+		if( Set_timeout() ){
+			Set_timeout_alarm( timeout );
+			status = recv( talk, input, my_len, MSG_PEEK );
+		} else {
+			status = -1;
+		}
+		Clear_timeout();
+
+		if( status <= 0 ){
+			logerr_die(LOG_DEBUG, _("Service_connection: peek of length %d failed"), my_len );
+		}
+		DEBUG1("Service_connection: status %d 0x%02x%02x%02x%02x (%c%c%c%c)", status,
+			cval(input+0), cval(input+1), cval(input+2), cval(input+3),
+			cval(input+0), cval(input+1), cval(input+2), cval(input+3));
+	} while( status < 2 );
+
+	if( isalpha(cval(input+0)) &&
+		isalpha(cval(input+1)) && isalpha(cval(input+2)) ){
+		/* 
+			Service_ipp( talk, from_addr );
+		*/
+	} else if( cval(input+0) == 0x80 ) {
+		/*
+			Service_ssh_ipp( talk, from_addr );
+		*/
+	}
+#endif /* not IPP_STUBS */
+	Service_lpd( talk, from_addr );
+}
+
+/***************************************************************************
+ * Setup_connection( int talk, char *from_addr, int from_len )
+ *  find the remote host and port of the connection, set up Perm_check,
+ *  and check the connect permissions.  Does not return if the
+ *  connection is rejected.
+ ***************************************************************************/
+
+static void Setup_connection( int talk, char *from_addr, int from_len )
+{
+	int permission;
+	int port = 0;
+	struct sockaddr sinaddr;
+
+	memset( &sinaddr, 0, sizeof(sinaddr) );
+
 	/* make sure you use blocking IO */
 	Set_block_io(talk);
 
@@ -229,10 +460,10 @@ void Service_connection( struct line_list *args, int talk )
 	} else {
 		fatal(LOG_INFO, _("Service_connection: bad protocol family '%d'"), sinaddr.sa_family );
 	}
-	inet_ntop_sockaddr( &sinaddr, from_addr, sizeof(from_addr) );
+	inet_ntop_sockaddr( &sinaddr, from_addr, from_len );
 	{
 		int len = strlen(from_addr);
-		plp_snprintf(from_addr+len,sizeof(from_addr)-len, " port %d", ntohs(port));
+		plp_snprintf(from_addr+len,from_len-len, " port %d", ntohs(port));
 	}
 
 	DEBUG2("Service_connection: socket %d, from %s", talk, from_addr );
@@ -261,56 +492,22 @@ void Service_connection( struct line_list *args, int talk )
 		safefprintf(talk, "\001%s\n", _("no connect permissions"));
 		cleanup(0);
 	}
-
-#ifdef IPP_STUBS
-	memset(input,0,sizeof(input));
-
-	do {
-		int my_len = sizeof( input ) - 1;
-		static int timeout;
-		timeout = (Send_job_rw_timeout_DYN>0)?Send_job_rw_timeout_DYN:
-					((Connect_timeout_DYN>0)?Connect_timeout_DYN:10);
-		DEBUG1( "Service_connection: doing peek for %d on fd %d, timeout %d",
-			my_len, talk, timeout );
-		if( Set_timeout() ){
-			Set_timeout_alarm( timeout );
-			status = recv( talk, input, my_len, MSG_PEEK );
-		} else {
-			status = -1;
-		}
-		Clear_timeout();
-
-		if( status <= 0 ){
-			logerr_die(LOG_DEBUG, _("Service_connection: peek of length %d failed"), my_len );
-		}
-		DEBUG1("Service_connection: status %d 0x%02x%02x%02x%02x (%c%c%c%c)", status,
-			cval(input+0), cval(input+1), cval(input+2), cval(input+3),
-			cval(input+0), cval(input+1), cval(input+2), cval(input+3));
-	} while( status < 2 );
-
-	if( isalpha(cval(input+0)) &&
-		isalpha(cval(input+1)) && isalpha(cval(input+2)) ){
-		/* 
-			Service_ipp( talk, from_addr );
-		*/
-	} else if( cval(input+0) == 0x80 ) {
-		/*
-			Service_ssh_ipp( talk, from_addr );
-		*/
-	}
-#endif /* not IPP_STUBS */
-	Service_lpd( talk, from_addr );
 }
 
-static void Service_lpd( int talk, const char *from_addr )
+/***************************************************************************
+ * Read_request( int talk, const char *from_addr, char *input, int maxlen )
+ *  read the request line from the connection
+ *  returns: length of the request line, 0 if the connection was closed
+ ***************************************************************************/
+
+static int Read_request( int talk, const char *from_addr, char *input, int maxlen )
 {
-	char input[LINEBUFFER];
 	int status;
-	int len = sizeof( input ) - 1;
+	int len = maxlen - 1;
 	int timeout = (Send_job_rw_timeout_DYN>0)?Send_job_rw_timeout_DYN:
 					((Connect_timeout_DYN>0)?Connect_timeout_DYN:10);
 
-	memset(input,0,sizeof(input));
+	memset(input,0,maxlen);
 	DEBUG1( "Service_connection: starting read on fd %d, timeout %d", talk, timeout );
 
 	status = Link_line_read(ShortRemote_FQDN,&talk,
@@ -320,7 +517,7 @@ static void Service_lpd( int talk, const char *from_addr )
 		status, len, input );
 	if( len == 0 ){
 		DEBUG3( "Service_connection: zero length read" );
-		cleanup(0);
+		return( 0 );
 	}
 	if( status ){
 		logerr_die(LOG_DEBUG, _("Service_connection: cannot read request from %s in %d seconds"),
@@ -330,6 +527,73 @@ static void Service_lpd( int talk, const char *from_addr )
 		fatal(LOG_INFO, _("Service_connection: short request line '%s', from '%s'"),
 			input, from_addr );
 	}
+	return( len );
+}
+
+static void Service_lpd( int talk, const char *from_addr )
+{
+	char input[LINEBUFFER];
+
+	if( Read_request( talk, from_addr, input, sizeof(input) ) == 0 ){
+		cleanup(0);
+	}
 	Dispatch_input(&talk,input,from_addr);
 	cleanup(0);
 }
+
+/***************************************************************************
+ * Service_pool( struct line_list *args, int channel )
+ *  Pool worker: get connections passed by lpd over the channel
+ *  and service them.  The status requests (lpq) leave no state behind,
+ *  so the worker reports that it is ready for the next connection
+ *  and waits for another one;  all other requests are handled
+ *  exactly as in Service_connection() and the worker exits.
+ ***************************************************************************/
+
+void Service_pool( struct line_list *args, int channel )
+{
+	char from_addr[128];
+	char input[LINEBUFFER];
+	int talk, count, debug, dbgflag;
+
+	Name = "POOL";
+	setproctitle( "lpd %s", Name );
+	(void) plp_signal (SIGHUP, cleanup );
+	Free_line_list(args);
+
+	debug = Debug; dbgflag = DbgFlag;
+	for( count = 0; ; ){
+		DEBUG1("Service_pool: waiting on channel %d", channel );
+		if( (talk = Receive_fd( channel )) < 0 ){
+			cleanup(0);
+		}
+		Name = "SERVER";
+		setproctitle( "lpd %s", Name );
+		Debug = debug; DbgFlag = dbgflag;
+		memset( &Perm_check, 0, sizeof(Perm_check) );
+
+		Setup_connection( talk, from_addr, sizeof(from_addr) );
+		if( Read_request( talk, from_addr, input, sizeof(input) ) == 0 ){
+			close( talk );
+		} else if( input[0] == REQ_DSHORT || input[0] == REQ_DLONG
+			|| input[0] == REQ_VERBOSE ){
+			Job_status( &talk, input );
+			if( talk >= 0 ) close( talk );
+		} else {
+			if( channel > 0 ) close( channel );
+			Dispatch_input(&talk,input,from_addr);
+			cleanup(0);
+		}
+		Remove_tempfiles();
+		Clear_tempfile_list();
+		if( ++count >= Pool_requests_DYN ){
+			DEBUG1("Service_pool: done after %d connections", count );
+			cleanup(0);
+		}
+		Name = "POOL";
+		setproctitle( "lpd %s", Name );
+		if( Write_fd_len( channel, "", 1 ) < 0 ){
+			cleanup(0);
+		}
+	}
+}
@@ -29,7 +29,9 @@
 #include "openprinter.h"
 
 #include "lpd_jobs.h"
+#include "lpd_pool.h"
 #include "lpd_rcvjob.h"
+#include "lpd_status.h"
 #include "lpd_worker.h"
 
 #if defined(USER_INCLUDE)
@@ -53,6 +55,18 @@ static void Setup_user_reporting( struct job *job );
 static void Filter_files_in_job( struct job *job, int outfd, char *user_filter );
 static int Move_job(int fd, struct job *job, struct line_list *sp,
 	char *errmsg, int errlen );
+static long Elapsed_ms( void );
+static int Choose_subserver( struct job *job, struct line_list *servers,
+	long *free_at, long now );
+static int Forward_channel( void );
+static void Collect_forward_connection( void );
+static void Close_forward_connection( void );
+
+static int Forward_sock = -1;	/* open connection to the remote queue */
+static int Forward_chan = -1;	/* channel to the worker sending a job */
+static int Forward_passed;		/* the worker was given Forward_sock */
+static int Forward_jobs;		/* jobs sent on the connection */
+static int Forward_off;			/* remote takes one job per connection */
 
 /***************************************************************************
  * Commentary:
@@ -182,6 +196,9 @@ static void Update_spool_info( struct line_list *sp )
 	Set_str_value(&info,IDENTIFIER, Find_str_value(sp,IDENTIFIER) );
 	Set_str_value(&info,SERVER, Find_str_value(sp,SERVER) );
 	Set_str_value(&info,DONE_TIME, Find_str_value(sp,DONE_TIME) );
+	Set_str_value(&info,UNSPOOLER, Find_str_value(sp,UNSPOOLER) );
+	Set_str_value(&info,START_MS, Find_str_value(sp,START_MS) );
+	Set_str_value(&info,JOB_MS, Find_str_value(sp,JOB_MS) );
 
 	sc = Find_str_value(&info,QUEUE_CONTROL_FILE);
 
@@ -310,6 +327,77 @@ static void Get_subserver_info( struct line_list *order,
 	if(DEBUGL1)Dump_subserver_info("Get_subserver_info - starting order",order);
 }
 
+/***************************************************************************
+ * Elapsed_ms()
+ *  milliseconds since the first call, used to time the subservers
+ ***************************************************************************/
+
+static long Elapsed_ms( void )
+{
+	static struct timeval start;
+	struct timeval now;
+
+	if( gettimeofday( &now, 0 ) == -1 ){
+		logerr_die(LOG_ERR, "Elapsed_ms: gettimeofday failed");
+	}
+	if( start.tv_sec == 0 ) start = now;
+	return( (now.tv_sec - start.tv_sec)*1000
+		+ (now.tv_usec - start.tv_usec)/1000 );
+}
+
+/***************************************************************************
+ * Choose_subserver( struct job *job, struct line_list *servers,
+ *   long *free_at, long now )
+ *  pick the subserver of a load balance queue that will finish the
+ *  job first.  Each subserver has an average job time (JOB_MS) and
+ *  free_at[] has the time at which it is expected to be free,  which
+ *  counts the jobs earlier in the queue that are waiting for it.
+ *  If the best subserver is busy the job waits for it, so that a fast
+ *  subserver takes the next job as soon as it is done rather than
+ *  a slow subserver that happens to be idle.
+ *  returns: subserver to start the job on,
+ *           0 if the job waits for a busy subserver
+ *          -1 if no subserver can print the job
+ ***************************************************************************/
+
+static int Choose_subserver( struct job *job, struct line_list *servers,
+	long *free_at, long now )
+{
+	struct line_list *sp;
+	long finish, best_finish = 0;
+	int j, best = -1;
+
+	for( j = 1; j < servers->count; ++j ){
+		sp = (void *)servers->list[j];
+		if( Pr_disabled(sp) || Pr_aborted(sp) || Sp_disabled(sp)
+			|| Get_hold_class(&job->info,sp) ){
+			DEBUG1("Choose_subserver: cannot use [%d] '%s'",
+				j, Find_str_value(sp,PRINTER) );
+			continue;
+		}
+		finish = free_at[j] + Find_flag_value(sp,JOB_MS);
+		/* on a tie the idle subserver earliest in the server order wins */
+		if( best < 0 || finish < best_finish
+			|| (finish == best_finish && free_at[j] <= now
+				&& free_at[best] > now) ){
+			best = j;
+			best_finish = finish;
+		}
+	}
+	if( best > 0 ){
+		sp = (void *)servers->list[best];
+		DEBUG1("Choose_subserver: best [%d] '%s', free in %ld, finish in %ld ms",
+			best, Find_str_value(sp,PRINTER), free_at[best] - now,
+			best_finish - now );
+		if( free_at[best] > now || Find_flag_value(sp,SERVER) ){
+			/* this job waits for the subserver */
+			free_at[best] = best_finish;
+			best = 0;
+		}
+	}
+	return( best );
+}
+
 /***************************************************************************
  * Make_temp_copy - make a temporary copy in the directory
  ***************************************************************************/
@@ -385,6 +473,8 @@ int Do_queue_jobs( char *name, int subserver )
 	struct job job;
 	int jobs_printed = 0;
 	int errlen = sizeof(errmsg);
+	long *free_at = 0, now_ms = 0, next_free, busy_ms;
+	int idle, wait_time;
 
 	Init_line_list(&tinfo);
 
@@ -476,9 +566,7 @@ int Do_queue_jobs( char *name, int subserver )
 	Write_pid( lock_fd, pid, (char *)0 );
 
 	/* we now now new queue status so we force update */
-	if( Lpq_status_file_DYN ){
-		unlink(Lpq_status_file_DYN);
-	}
+	Queue_status_changed();
 	if( Log_file_DYN && !opened_logfile ){
 		fd = Trim_status_file( -1, Log_file_DYN, Max_log_file_size_DYN,
 			Min_log_file_size_DYN );
@@ -515,6 +603,7 @@ int Do_queue_jobs( char *name, int subserver )
 	change = Find_flag_value(&Spool_control,CHANGE);
 	if( change ){
 		Set_flag_value(sp,CHANGE,0);
+		Get_spool_control( Queue_control_file_DYN, &Spool_control );
 		Set_flag_value(&Spool_control,CHANGE,0);
 		Set_spool_control(0, Queue_control_file_DYN, &Spool_control);
 	}
@@ -541,6 +630,17 @@ int Do_queue_jobs( char *name, int subserver )
 		}
 		free(savename); savename = NULL;
 
+		/* the average job times of the subservers, see Choose_subserver() */
+		Free_line_list(&tinfo);
+		Split( &tinfo, Find_str_value(&Spool_control,SERVER_JOB_MS),
+			File_sep, 1, Hash_value_sep, 1, 1, 0, 0 );
+		for( i = 1; i < servers.count; ++i ){
+			sp = (void *)servers.list[i];
+			Set_flag_value(sp,JOB_MS,
+				Find_flag_value(&tinfo,Find_str_value(sp,PRINTER)));
+		}
+		Free_line_list(&tinfo);
+
 		master = 1;
 		/* start the queues that need it */
 		for( i = 1; i < servers.count; ++i ){
@@ -569,13 +669,37 @@ int Do_queue_jobs( char *name, int subserver )
 	}
 
 
+	/*
+	 * with unspoolers > 1 we add unspooler slots, each of which can
+	 * have a worker process for a job in this queue.  They are at
+	 * the end of the server list and have the UNSPOOLER flag set.
+	 * We give out the jobs in queue order,  marking each job with
+	 * the worker pid (SERVER) so it is not started twice.
+	 */
+	if( !master && Unspoolers_DYN > 1 && !Chooser_DYN && !Chooser_routine_DYN
+		&& !(Lp_device_DYN && Lp_device_DYN[0] == '/') ){
+		for( i = 1; i < Unspoolers_DYN; ++i ){
+			Check_max(&servers,1);
+			sp = malloc_or_die(sizeof(sp[0]),__FILE__,__LINE__);
+			memset(sp,0,sizeof(sp[0]));
+			Set_str_value(sp,PRINTER,Printer_DYN);
+			Set_str_value(sp,SPOOLDIR,Spool_dir_DYN);
+			Set_str_value(sp,QUEUE_CONTROL_FILE,Queue_control_file_DYN);
+			Set_flag_value(sp,UNSPOOLER,i);
+			servers.list[servers.count++] = (char *)sp;
+			Update_spool_info(sp);
+		}
+		DEBUG1("Do_queue_jobs: %d unspoolers", Unspoolers_DYN );
+	}
+
 	if(DEBUGL3)Dump_subserver_info("Do_queue_jobs - after setup",&servers);
 
 	if(DEBUGL4){ int fdx; fdx = dup(0);
 		LOGDEBUG("Do_queue_jobs: after subservers next fd %d",fdx);close(fdx);};
 	/* get new job values */
-	if( Scan_queue( &Spool_control, &Sort_order,
-			&printable, &held, &move, 1, &error, &done, 0, 0 ) ){
+	/* this also refreshes the status snapshot used by lpq */
+	if( Scan_queue_snapshot( &Sort_order,
+			&printable, &held, &move, &error, &done ) ){
 		Errorcode = JFAIL;
 		fatal(LOG_ERR, "Do_queue_jobs: cannot read queue directory '%s'",
 			Spool_dir_DYN );
@@ -653,8 +777,8 @@ int Do_queue_jobs( char *name, int subserver )
 			DEBUG1( "Do_queue_jobs: rescanning" );
 
 			Get_spool_control( Queue_control_file_DYN, &Spool_control);
-			if( Scan_queue( &Spool_control, &Sort_order,
-					&printable, &held, &move, 1, &error, &done, 0, 0 ) ){
+			if( Scan_queue_snapshot( &Sort_order,
+					&printable, &held, &move, &error, &done ) ){
 				logerr_die(LOG_ERR, "Do_queue_jobs: cannot read queue '%s'",
 					Spool_dir_DYN );
 			}
@@ -666,7 +790,8 @@ int Do_queue_jobs( char *name, int subserver )
 				Update_spool_info( sp );
 				change = Find_flag_value(sp,CHANGE);
 				pid = Find_flag_value(sp,SERVER);
-				if( i > 0 && change && pid == 0 ){
+				if( i > 0 && change && pid == 0
+					&& !Find_flag_value(sp,UNSPOOLER) ){
 					pid = Fork_subserver( &servers, i, 0 );
 					jobs_printed = 1;
 				}
@@ -716,6 +841,39 @@ int Do_queue_jobs( char *name, int subserver )
 			}
 		}
 
+		/*
+		 * for a load balance queue get the time at which each subserver
+		 * should be free, see Choose_subserver().  A busy subserver that
+		 * has taken longer than its average job time is expected to
+		 * take as long again.
+		 */
+		idle = wait_time = 0;
+		if( master && !Chooser_DYN && !Chooser_routine_DYN ){
+			now_ms = Elapsed_ms();
+			next_free = 0;
+			free_at = realloc_or_die( free_at, servers.count*sizeof(free_at[0]),
+				__FILE__,__LINE__);
+			for( j = 1; j < servers.count; ++j ){
+				sp = (void *)servers.list[j];
+				free_at[j] = now_ms;
+				if( !Find_flag_value(sp,SERVER) ){
+					++idle;
+					continue;
+				}
+				busy_ms = 2 * (now_ms - (long)Find_double_value(sp,START_MS));
+				if( busy_ms < Find_flag_value(sp,JOB_MS) ){
+					busy_ms = Find_flag_value(sp,JOB_MS);
+				}
+				free_at[j] = (long)Find_double_value(sp,START_MS) + busy_ms;
+				if( free_at[j] <= now_ms ) free_at[j] = now_ms + 1;
+				if( next_free == 0 || free_at[j] < next_free ) next_free = free_at[j];
+			}
+			if( next_free ){
+				/* check again when the next busy subserver should be done */
+				wait_time = (next_free - now_ms + 999)/1000;
+			}
+		}
+
 		fd = -1;
 		for( job_index = 0; job_to_do < 0 && job_index < Sort_order.count;
 			++job_index ){
@@ -852,6 +1010,18 @@ int Do_queue_jobs( char *name, int subserver )
 				/* we will start a process up to do move */
 				use_subserver = 0;
 				job_to_do = job_index;
+			} else if( printing_enabled && printable && master
+				&& !Chooser_DYN && !Chooser_routine_DYN ){
+				j = Choose_subserver( &job, &servers, free_at, now_ms );
+				if( j > 0 ){
+					use_subserver = j;
+					job_to_do = job_index;
+				} else if( j < 0 ){
+					chooser_did_not_find_server = 1;
+				} else if( !idle ){
+					/* the later jobs would have to wait as well */
+					break;
+				}
 			} else if( printing_enabled && printable ){
 				/*
 				 * find the subserver with a class that will print this job
@@ -914,7 +1084,7 @@ int Do_queue_jobs( char *name, int subserver )
 					Chooser_DYN, working, master);
 				if( (Chooser_routine_DYN || Chooser_DYN) && working && master == 0 ){
 					chooser_did_not_find_server = 1;
-				} else if( servers.count > 1 && printers_available == 0 ){
+				} else if( master && printers_available == 0 ){
 					chooser_did_not_find_server = 1;
 				} else if( Chooser_routine_DYN ){
 #if defined(CHOOSER_ROUTINE)
@@ -1039,6 +1209,7 @@ int Do_queue_jobs( char *name, int subserver )
 			DEBUG1("Do_queue_jobs: nothing to do");
 			if( fd > 0 ) close(fd);
 			fd = -1;
+			Close_forward_connection();
 			break;
 		}
 
@@ -1046,6 +1217,8 @@ int Do_queue_jobs( char *name, int subserver )
 		if( use_subserver < 0 ){
 			if( fd > 0 ) close(fd);
 			fd = -1;
+			/* the remote queue does not get the last job until we close */
+			if( !working ) Close_forward_connection();
 			if( chooser_did_not_find_server ){
 				setstatus(0, "chooser did not find subserver, waiting %d sec",
 					Chooser_interval_DYN );
@@ -1056,7 +1229,7 @@ int Do_queue_jobs( char *name, int subserver )
 				} else {
 					setstatus(0, "waiting for subserver to exit" );
 				}
-				Wait_for_subserver( 0, -1, &servers );
+				Wait_for_subserver( wait_time, -1, &servers );
 			}
 			continue;
 		}
@@ -1122,7 +1295,7 @@ int Do_queue_jobs( char *name, int subserver )
 		 * subserver process.  This job should have all of the characteristics
 		 * of a new job for this queue
 		 */
-		if( use_subserver > 0 ){
+		if( use_subserver > 0 && !Find_flag_value(sp,UNSPOOLER) ){
 			if( !Move_job( fd, &job, sp, buffer, sizeof(buffer)) ){
 				/* now we deal with the job in the original queue */
 				Set_str_value(sp,IDENTIFIER,id);
@@ -1236,9 +1409,9 @@ int Do_queue_jobs( char *name, int subserver )
 			Set_str_value(&tinfo,MOVE_DEST,move_dest);
 			Set_str_value(sp,HF_NAME,hf_name);
 			Set_str_value(sp,IDENTIFIER,id);
-			if( (pid = Fork_subserver( &servers, 0, &tinfo )) < 0 ){
+			if( (pid = Fork_subserver( &servers, use_subserver, &tinfo )) < 0 ){
 				setstatus( &job, _("sleeping, waiting for processes to exit"));
-				plp_sleep(1);
+				Wait_for_subserver( 1, -1, &servers );
 				Set_str_value(sp,HF_NAME,0);
 				Set_str_value(sp,IDENTIFIER,0);
 			}
@@ -1256,27 +1429,37 @@ int Do_queue_jobs( char *name, int subserver )
 	if( Server_names_DYN ){
 		if( jobs_printed ) setstatus( 0, "no more jobs to process in load balance queue" );
 		jobs_printed = 0;
+		Free_line_list(&chooser_list);
+		/* do not write back an old copy over an lpc change */
+		Get_spool_control( Queue_control_file_DYN, &Spool_control );
 		for( i = 1; i < servers.count; ++i ){
 			sp = (void *)servers.list[i];
 			s = Find_str_value(sp,PRINTER);
 			Add_line_list(&tinfo,s,0,0,0);
+			if( (j = Find_flag_value(sp,JOB_MS)) ){
+				plp_snprintf( buffer, sizeof(buffer), "%s=%d", s, j );
+				Add_line_list(&chooser_list,buffer,0,0,0);
+			}
 		}
 		s = Join_line_list_with_sep(&tinfo,",");
 		Set_str_value(&Spool_control,SERVER_ORDER,s);
-		Set_spool_control(0, Queue_control_file_DYN, &Spool_control);
 		free(s); s = NULL;
+		s = Join_line_list_with_sep(&chooser_list,",");
+		Set_str_value(&Spool_control,SERVER_JOB_MS,s);
+		free(s); s = NULL;
+		Set_spool_control(0, Queue_control_file_DYN, &Spool_control);
 		Free_line_list(&tinfo);
+		Free_line_list(&chooser_list);
 	}
 	Free_listof_line_list(&servers);
+	free(free_at); free_at = 0;
 
 	/* truncate and close the lock file then wait a short time for signal */
 	ftruncate( lock_fd, 0 );
 	close( lock_fd );
 	lock_fd = -1;
 	/* force status update */
-	if( Lpq_status_file_DYN ){
-		unlink(Lpq_status_file_DYN);
-	}
+	Queue_status_changed();
 	plp_unblock_all_signals( &oblock);
 	plp_usleep(500);
 	DEBUG1( "Do_queue_jobs: Susr1 at end %d", Susr1 );
@@ -1619,7 +1802,7 @@ static int Fork_subserver( struct line_list *server_info, int use_subserver,
 {
 	char *pr;
 	struct line_list *sp;
-	int pid;
+	int pid, fd;
 	struct line_list pl;
 
 	Init_line_list(&pl);
@@ -1631,16 +1814,28 @@ static int Fork_subserver( struct line_list *server_info, int use_subserver,
 	pr = Find_str_value(sp,PRINTER);
 	Set_str_value(parms,PRINTER,pr);
 	Set_flag_value(parms,SUBSERVER,use_subserver);
+	Set_flag_value(parms,UNSPOOLER,Find_flag_value(sp,UNSPOOLER));
 	DEBUG1( "Fork_subserver: starting '%s'", pr );
 	if(DEBUGL4)Dump_line_list("Fork_subserver - sp", sp );
-	if( use_subserver > 0 ){
+	if( use_subserver > 0 && !Find_flag_value(sp,UNSPOOLER) ){
 		pid = Start_worker( "queue", Service_queue, parms, 0 );
+	} else if( use_subserver == 0 ){
+		/* our own worker gets the queue accounting sink and
+		 * the channel for the connection to the remote queue */
+		fd = -1;
+		if( !Find_str_value(parms,NEW_DEST) && !Find_str_value(parms,MOVE_DEST) ){
+			fd = Forward_channel();
+		}
+		pid = Start_worker_fds( "printer", Service_worker, parms,
+			Start_accounting_sink(), FORWARD_FD, fd );
+		if( fd >= 0 ) close( fd );
 	} else {
 		pid = Start_worker( "printer", Service_worker, parms, 0 );
 	}
 
 	if( pid > 0 ){
 		Set_decimal_value(sp,SERVER,pid);
+		Set_decimal_value(sp,START_MS,Elapsed_ms());
 	} else {
 		logerr(LOG_ERR, _("Fork_subserver: fork failed") );
 	}
@@ -1648,6 +1843,108 @@ static int Fork_subserver( struct line_list *server_info, int use_subserver,
 	return( pid );
 }
 
+/***************************************************************************
+ * int Forward_channel()
+ *  With forward_batch the connection to the remote queue is kept open
+ *  between the jobs.  The queue server never connects or waits for
+ *  the remote server:  each worker that forwards a job gets one end of
+ *  a channel (a UNIX domain socket pair).  If we hold an open connection
+ *  we pass it over the channel,  otherwise the worker opens one and
+ *  sends the \2printer request itself.  When the job has been sent
+ *  the worker passes the connection back over the channel (see
+ *  Service_worker()),  and we pick it up when we start the next worker.
+ *  A worker that fails does not pass the connection back.
+ *  If the remote server closes the connection after accepting one or
+ *  two jobs we take it that it will only take one job per connection
+ *  and stop doing this.
+ *  Returns the worker end of the channel or -1.
+ ***************************************************************************/
+
+static int Forward_channel( void )
+{
+	fd_set readfds;
+	struct timeval delay;
+	int channel[2];
+
+	Collect_forward_connection();
+	if( !Forward_batch_DYN || Forward_off || ISNULL(RemotePrinter_DYN)
+		|| ISNULL(RemoteHost_DYN) || Auth_forward_DYN || Send_block_format_DYN ){
+		Close_forward_connection();
+		return( -1 );
+	}
+	if( Forward_sock >= 0 ){
+		/* nothing should be waiting;  EOF or an error message means closed */
+		memset( &delay,0,sizeof(delay));
+		FD_ZERO( &readfds );
+		FD_SET( Forward_sock, &readfds );
+		if( select( Forward_sock+1, &readfds, NULL, NULL, &delay ) != 0 ){
+			DEBUG1("Forward_channel: connection to %s@%s closed after %d jobs",
+				RemotePrinter_DYN, RemoteHost_DYN, Forward_jobs );
+			if( Forward_jobs <= 2 ){
+				logmsg( LOG_INFO,
+					"Forward_channel: %s@%s closed the connection after %d jobs, sending one job per connection",
+					RemotePrinter_DYN, RemoteHost_DYN, Forward_jobs );
+				Forward_off = 1;
+			}
+			Close_forward_connection();
+			if( Forward_off ) return( -1 );
+		}
+	}
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, channel ) == -1 ){
+		logerr(LOG_INFO, "Forward_channel: socketpair failed" );
+		Close_forward_connection();
+		return( -1 );
+	}
+	Max_open(channel[0]); Max_open(channel[1]);
+	Set_nonblock_io( channel[0] );
+	Forward_passed = 0;
+	if( Forward_sock >= 0 ){
+		if( Send_fd( channel[0], Forward_sock ) == 0 ){
+			Forward_passed = 1;
+		}
+		close( Forward_sock );
+		Forward_sock = -1;
+	}
+	DEBUG1("Forward_channel: channel %d, connection %s, %d jobs", channel[0],
+		Forward_passed ? "passed" : "not open", Forward_jobs );
+	Forward_chan = channel[0];
+	return( channel[1] );
+}
+
+/*
+ * pick up the connection passed back by the last worker
+ */
+
+static void Collect_forward_connection( void )
+{
+	int fd;
+
+	if( Forward_chan < 0 ) return;
+	fd = Receive_fd( Forward_chan );
+	close( Forward_chan );
+	Forward_chan = -1;
+	if( fd >= 0 ){
+		Forward_sock = fd;
+		Forward_jobs = Forward_passed ? Forward_jobs+1 : 1;
+	} else {
+		Forward_jobs = 0;
+	}
+	DEBUG1("Collect_forward_connection: fd %d, %d jobs", fd, Forward_jobs );
+}
+
+static void Close_forward_connection( void )
+{
+	Collect_forward_connection();
+	if( Forward_sock >= 0 ){
+		DEBUG1("Close_forward_connection: fd %d, %d jobs",
+			Forward_sock, Forward_jobs );
+		Forward_sock = Shutdown_or_close( Forward_sock );
+		if( Forward_sock >= 0 ) close( Forward_sock );
+	}
+	Forward_sock = -1;
+	Forward_jobs = 0;
+}
+
 /***************************************************************************
  * struct server_info *Wait_for_subserver( int timeout int pid,
  * struct line_list *servers,
@@ -1664,6 +1961,7 @@ static void Wait_for_subserver( int timeout, int pid_to_wait_for, struct line_li
 	pid_t pid;
 	plp_status_t procstatus;
 	int found, sigval, status, i, done, flags, fd;
+	long job_ms, avg_ms;
 	struct line_list *sp = 0;
 	struct job job;
 	char buffer[SMALLBUFFER], *pr, *hf_name, *id;
@@ -1740,6 +2038,17 @@ static void Wait_for_subserver( int timeout, int pid_to_wait_for, struct line_li
 				Free_job(&job);
 				Set_decimal_value(sp,SERVER,0);
 				Set_flag_value(sp,DONE_TIME,time((void *)0));
+				/* keep a running average of the subserver job time */
+				if( i > 0 && status == JSUCC && Find_str_value(sp,START_MS) ){
+					job_ms = Elapsed_ms() - (long)Find_double_value(sp,START_MS);
+					if( (avg_ms = Find_flag_value(sp,JOB_MS)) ){
+						job_ms = (3*avg_ms + job_ms)/4;
+					}
+					Set_decimal_value(sp,JOB_MS,job_ms);
+					DEBUG1("Wait_for_subserver: '%s' average job time %ld ms",
+						Find_str_value(sp,PRINTER), job_ms );
+				}
+				Set_str_value(sp,START_MS,0);
 
 				/* we get the job ticket file information */
 				hf_name = Find_str_value(sp,HF_NAME);
@@ -1757,7 +2066,7 @@ static void Wait_for_subserver( int timeout, int pid_to_wait_for, struct line_li
 				Set_str_value(sp,HF_NAME,0);
 				Set_str_value(sp,IDENTIFIER,0);
 				Update_spool_info(sp);
-				if( i == 0 ){
+				if( i == 0 || Find_flag_value(sp,UNSPOOLER) ){
 					/* this is the information for the master spool queue */
 					Get_spool_control(Queue_control_file_DYN, &Spool_control );
 				}
@@ -2317,9 +2626,10 @@ static void Setup_user_reporting( struct job *job )
 	free(host); 
 }
 
-void Service_worker( struct line_list *args, int param_fd UNUSED )
+void Service_worker( struct line_list *args, int param_fd )
 {
-	int pid, unspooler_fd, destinations, attempt, n, lpd_bounce;
+	int pid, unspooler_fd, destinations, attempt, n, lpd_bounce,
+		forward_chan = -1;
 	struct line_list *destination;
 	char *s, *path, *hf_name, *new_dest, *move_dest,
 		*id, *did;
@@ -2350,6 +2660,13 @@ void Service_worker( struct line_list *args, int param_fd UNUSED )
 	if(DEBUGL4){ int fd; fd = dup(0);
 	LOGDEBUG("Service_worker: after Setup_printer next fd %d",fd); close(fd); };
 
+	if( param_fd > 0 ) Set_accounting_sink( param_fd );
+	if( (forward_chan = Find_flag_value(args,FORWARD_FD)) > 0 ){
+		/* the queue server may have passed us an open connection */
+		Set_nonblock_io( forward_chan );
+		Set_forward_connection( Receive_fd( forward_chan ) );
+	}
+
 	pid = getpid();
 	DEBUG1( "Service_worker: pid %d", pid );
 	path = Make_pathname( Spool_dir_DYN, Queue_unspooler_file_DYN );
@@ -2358,7 +2675,8 @@ void Service_worker( struct line_list *args, int param_fd UNUSED )
 			path );
 	}
 	free(path); path = NULL;
-	Write_pid( unspooler_fd, pid, (char *)0 );
+	/* each unspooler has its own line */
+	Write_slot_pid( unspooler_fd, Find_flag_value(args,UNSPOOLER), pid );
 	close(unspooler_fd); unspooler_fd = -1;
 
 	DEBUG3("Service_worker: checking path '%s'", path );
@@ -2467,6 +2785,11 @@ void Service_worker( struct line_list *args, int param_fd UNUSED )
 		if( Remote_support_DYN ) uppercase( Remote_support_DYN );
 		if( safestrchr( Remote_support_DYN, 'R' ) ){
 			Errorcode = Remote_job( &job, lpd_bounce, move_dest, id );
+			if( forward_chan > 0 && (n = Get_forward_connection()) >= 0 ){
+				/* the queue server sends the next job over it */
+				if( Errorcode == JSUCC ) Send_fd( forward_chan, n );
+				close( n );
+			}
 		} else {
 			Errorcode = JABORT;
 			setstatus( &job, "no remote support to `%s@%s'",
@@ -2815,8 +3138,8 @@ int Remove_done_jobs( void )
 	}
 	Free_job(&job);
 	Free_line_list(&info);
-	if( removed && Lpq_status_file_DYN ){
-		unlink(Lpq_status_file_DYN);
+	if( removed ){
+		Queue_status_changed();
 	}
 	return( removed );
 }
@@ -10,6 +10,7 @@
 #include "lp.h"
 #include "child.h"
 #include "errorcodes.h"
+#include "fanout.h"
 #include "fileopen.h"
 #include "getopt.h"
 #include "getprinter.h"
@@ -53,9 +54,20 @@ pid_t Start_logger( int log_fd )
 	return(pid);
 }
 
-static int Dump_queue_status(int outfd)
+struct dump_status {
+	pid_t pid;		/* logger process */
+	int outfd;		/* logger output */
+};
+
+/*
+ * Dump_printer_status( int n, int outfd, void *arg )
+ *  write the status of printer n in All_line_list to outfd
+ *  returns: 1 if the write failed
+ */
+
+static int Dump_printer_status( int n, int outfd, void *arg )
 {
-	int i, count, fd;
+	int count, fd, status = 1;
 	char *s, *sp, *pr;
 	struct line_list info;
 	struct job job;
@@ -68,83 +80,114 @@ static int Dump_queue_status(int outfd)
 	s = sp = 0;
 	Init_job(&job);
 	Init_line_list(&info);
-	if(All_line_list.count == 0 ){
-		Get_all_printcap_entries();
+	Set_DYN(&Printer_DYN,0);
+	pr = All_line_list.list[n];
+	DEBUGF(DLOG2)("Dump_printer_status: checking '%s'", pr );
+	if( Setup_printer( pr, buffer, sizeof(buffer), 0 ) ) return(0);
+	Free_line_list( &Sort_order );
+	if( Scan_queue( &Spool_control, &Sort_order, 0,0,0,0,0,0,0,0 ) ){
+		return(0);
 	}
-	DEBUGF(DLOG2)("Dump_queue_status: writing to fd %d", outfd );
-	for( i = 0; i < All_line_list.count; ++i ){
-		Set_DYN(&Printer_DYN,0);
-		pr = All_line_list.list[i];
-		DEBUGF(DLOG2)("Dump_queue_status: checking '%s'", pr );
-		if( Setup_printer( pr, buffer, sizeof(buffer), 0 ) ) continue;
-		Free_line_list( &Sort_order );
-		if( Scan_queue( &Spool_control, &Sort_order, 0,0,0,0,0,0,0,0 ) ){
-			continue;
-		}
-		Free_line_list(&info);
-		Set_str_value(&info,PRINTER,Printer_DYN);
-		Set_str_value(&info,HOST,FQDNHost_FQDN);
-		Set_decimal_value(&info,PROCESS,getpid());
-		Set_str_value(&info,UPDATE_TIME,Time_str(0,0));
+	Set_str_value(&info,PRINTER,Printer_DYN);
+	Set_str_value(&info,HOST,FQDNHost_FQDN);
+	Set_decimal_value(&info,PROCESS,((struct dump_status *)arg)->pid);
+	Set_str_value(&info,UPDATE_TIME,Time_str(0,0));
 
-		if( Write_fd_str( outfd, "DUMP=" ) < 0 ){ return(1); }
-		s = Join_line_list(&info,"\n");
-		sp = Escape(s, 1);
-		if( Write_fd_str( outfd, sp ) < 0 ){ return(1); }
+	if( Write_fd_str( outfd, "DUMP=" ) < 0 ){ goto done; }
+	s = Join_line_list(&info,"\n");
+	sp = Escape(s, 1);
+	if( Write_fd_str( outfd, sp ) < 0 ){ goto done; }
 
-		free(s); s = NULL;
-		free(sp); sp = NULL;
+	free(s); s = NULL;
+	free(sp); sp = NULL;
 
-		if( Write_fd_str( outfd, "VALUE=" ) < 0 ){ return(1); }
+	if( Write_fd_str( outfd, "VALUE=" ) < 0 ){ goto done; }
 
-		if( Write_fd_str( outfd, "QUEUE%3d" ) < 0 ){ return(1); }
-		if( (fd = Checkread( Queue_control_file_DYN, &statb )) > 0 ){
-			while( (count = ok_read(fd, buffer, sizeof(buffer)-1)) > 0 ){
-				buffer[count] = 0;
-				s = Escape(buffer,3);
-				if( Write_fd_str( outfd, s ) < 0 ){ return(1); }
-				free(s); s = NULL;
-			}
-			close(fd);
-		}
-		if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ return(1); }
-
-		if( Write_fd_str( outfd, "PRSTATUS%3d" ) < 0 ){ return(1); }
-		if( (fd = Checkread( Queue_status_file_DYN, &statb )) > 0 ){
-			while( (count = ok_read(fd, buffer, sizeof(buffer)-1)) > 0 ){
-				buffer[count] = 0;
-				s = Escape(buffer,3);
-				if( Write_fd_str( outfd, s ) < 0 ){ return(1); }
-				free(s); s = NULL;
-			}
-			close(fd);
+	if( Write_fd_str( outfd, "QUEUE%3d" ) < 0 ){ goto done; }
+	if( (fd = Checkread( Queue_control_file_DYN, &statb )) > 0 ){
+		while( (count = ok_read(fd, buffer, sizeof(buffer)-1)) > 0 ){
+			buffer[count] = 0;
+			s = Escape(buffer,3);
+			if( Write_fd_str( outfd, s ) < 0 ){ close(fd); goto done; }
+			free(s); s = NULL;
 		}
-		if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ return(1); }
-
-		for( count = 0; count < Sort_order.count; ++count ){
-			Free_job(&job);
-			Get_job_ticket_file( 0, &job, Sort_order.list[count] );
-			
-			if( job.info.count == 0 ) continue;
-			if( Write_fd_str( outfd, "UPDATE%3d" ) < 0 ){ return(1); }
-			s = Join_line_list(&job.info,"\n");
-			sp = Escape(s, 3);
-			if( Write_fd_str( outfd, sp ) < 0 ){ return(1); }
+		close(fd);
+	}
+	if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ goto done; }
+
+	if( Write_fd_str( outfd, "PRSTATUS%3d" ) < 0 ){ goto done; }
+	if( (fd = Checkread( Queue_status_file_DYN, &statb )) > 0 ){
+		while( (count = ok_read(fd, buffer, sizeof(buffer)-1)) > 0 ){
+			buffer[count] = 0;
+			s = Escape(buffer,3);
+			if( Write_fd_str( outfd, s ) < 0 ){ close(fd); goto done; }
 			free(s); s = NULL;
-			free(sp); sp = NULL;
-			if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ return(1); }
 		}
-		if( Write_fd_str( outfd, "\n" ) < 0 ){ return(1); }
+		close(fd);
 	}
+	if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ goto done; }
 
-	if( Write_fd_str( outfd, "END\n" ) < 0 ){ return(1); }
-	Set_DYN(&Printer_DYN,0);
+	for( count = 0; count < Sort_order.count; ++count ){
+		Free_job(&job);
+		Get_job_ticket_file( 0, &job, Sort_order.list[count] );
+		
+		if( job.info.count == 0 ) continue;
+		if( Write_fd_str( outfd, "UPDATE%3d" ) < 0 ){ goto done; }
+		s = Join_line_list(&job.info,"\n");
+		sp = Escape(s, 3);
+		if( Write_fd_str( outfd, sp ) < 0 ){ goto done; }
+		free(s); s = NULL;
+		free(sp); sp = NULL;
+		if( Write_fd_str( outfd, esc_lf_1 ) < 0 ){ goto done; }
+	}
+	if( Write_fd_str( outfd, "\n" ) < 0 ){ goto done; }
+	status = 0;
 
-	Free_line_list( &Sort_order );
+ done:
 	Free_line_list(&info);
 	Free_job(&job);
 	free(s); s = NULL;
 	free(sp); sp = NULL;
+	return( status );
+}
+
+/*
+ * pass the status collected by Fanout_status() on to the logger output
+ */
+
+static int Dump_status_output( int n, char *output, int len, void *arg )
+{
+	struct dump_status *dump = arg;
+	if( len > 0 && Write_fd_len( dump->outfd, output, len ) < 0 ){
+		return( 1 );
+	}
+	return( 0 );
+}
+
+static int Dump_queue_status(int outfd)
+{
+	struct dump_status dump;
+	int i;
+
+	if(All_line_list.count == 0 ){
+		Get_all_printcap_entries();
+	}
+	DEBUGF(DLOG2)("Dump_queue_status: writing to fd %d", outfd );
+	dump.pid = getpid();
+	dump.outfd = outfd;
+	if( Queue_scan_workers_DYN > 1 && All_line_list.count > 1 ){
+		if( Fanout_status( All_line_list.count, Queue_scan_workers_DYN,
+			Dump_printer_status, Dump_status_output, &dump ) ){
+			return(1);
+		}
+	} else for( i = 0; i < All_line_list.count; ++i ){
+		if( Dump_printer_status( i, outfd, &dump ) ){ return(1); }
+	}
+
+	if( Write_fd_str( outfd, "END\n" ) < 0 ){ return(1); }
+	Set_DYN(&Printer_DYN,0);
+
+	Free_line_list( &Sort_order );
 	return(0);
 }
 
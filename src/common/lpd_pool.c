@@ -0,0 +1,314 @@
+/***************************************************************************
+ * LPRng - An Extended Print Spooler System
+ *
+ * Copyright 1988-2003, Patrick Powell, San Diego, CA
+ *     papowell@lprng.com
+ * See LICENSE for conditions of use.
+ *
+ ***************************************************************************/
+
+/***************************************************************************
+ * Connection worker pool
+ *
+ * Normally lpd forks a new process for every connection.  When
+ * lpd_pool_workers is non-zero, lpd keeps a pool of connection
+ * worker processes and passes each accepted connection to an idle
+ * worker over a UNIX domain socket (SCM_RIGHTS).  The pool is grown
+ * on demand up to lpd_pool_workers (and the maximum number of
+ * processes lpd will start).  A worker writes a single byte back on
+ * its channel when it is ready for another connection; it exits after
+ * lpd_pool_requests connections, or after servicing a request that
+ * cannot be done without changing the process state (see
+ * Service_pool()).  lpd notices this when the channel is closed or
+ * the process is reaped.
+ ***************************************************************************/
+
+#include "lp.h"
+#include "errorcodes.h"
+#include "child.h"
+#include "linelist.h"
+#include "lpd_worker.h"
+#include "lpd_dispatch.h"
+#include "lpd_pool.h"
+
+/**** ENDINCLUDE ****/
+
+#if defined(HAVE_SOCKETPAIR) && defined(SCM_RIGHTS) && defined(CMSG_SPACE)
+# define POOL_SUPPORTED 1
+#endif
+
+struct pool_worker {
+	pid_t pid;		/* worker process */
+	int fd;			/* channel to worker */
+	int busy;		/* servicing a connection */
+};
+
+static struct pool_worker *Pool;
+static int Pool_count, Pool_max;
+
+static int Start_pool_worker( void );
+static void Remove_pool_worker( int n );
+
+/*
+ * int Pool_dispatch( int talk )
+ *  pass the connection to an idle pool worker,  starting one if needed
+ *  returns: 0 if passed, -1 if the caller needs to service it
+ */
+
+int Pool_dispatch( int talk )
+{
+	int n;
+
+	if( Pool_workers_DYN <= 0 ){
+		return( -1 );
+	}
+	for( n = 0; n < Pool_count; ){
+		if( Pool[n].busy ){
+			++n;
+			continue;
+		}
+		if( Send_fd( Pool[n].fd, talk ) == 0 ){
+			DEBUG1("Pool_dispatch: fd %d to worker pid %ld",
+				talk, (long)Pool[n].pid );
+			Pool[n].busy = 1;
+			return( 0 );
+		}
+		DEBUG1("Pool_dispatch: worker pid %ld not available - %s",
+			(long)Pool[n].pid, Errormsg(errno) );
+		Remove_pool_worker( n );
+	}
+	if( (n = Start_pool_worker()) < 0 ){
+		return( -1 );
+	}
+	if( Send_fd( Pool[n].fd, talk ) ){
+		logerr(LOG_INFO, "Pool_dispatch: cannot pass connection to worker pid %ld",
+			(long)Pool[n].pid );
+		Remove_pool_worker( n );
+		return( -1 );
+	}
+	Pool[n].busy = 1;
+	return( 0 );
+}
+
+/*
+ * number of pool workers waiting for a connection
+ */
+
+int Pool_idle_workers( void )
+{
+	int n, idle = 0;
+	for( n = 0; n < Pool_count; ++n ){
+		if( !Pool[n].busy ) ++idle;
+	}
+	return( idle );
+}
+
+/*
+ * add the worker channels to the select() set
+ */
+
+void Pool_fdset( fd_set *readfds, int *max_socks )
+{
+	int n;
+	for( n = 0; n < Pool_count; ++n ){
+		FD_SET( Pool[n].fd, readfds );
+		if( Pool[n].fd >= *max_socks ){
+			*max_socks = Pool[n].fd+1;
+		}
+	}
+}
+
+/*
+ * read the ready messages from the workers
+ */
+
+void Pool_read( fd_set *readfds )
+{
+	char buffer[32];
+	int n, len;
+
+	for( n = 0; n < Pool_count; ){
+		if( !FD_ISSET( Pool[n].fd, readfds ) ){
+			++n;
+			continue;
+		}
+		len = ok_read( Pool[n].fd, buffer, sizeof(buffer) );
+		DEBUG1("Pool_read: worker pid %ld, read %d", (long)Pool[n].pid, len );
+		if( len <= 0 ){
+			Remove_pool_worker( n );
+			continue;
+		}
+		Pool[n].busy = 0;
+		++n;
+	}
+}
+
+/*
+ * the worker process has exited
+ */
+
+void Pool_reaped( pid_t pid )
+{
+	int n;
+	for( n = 0; n < Pool_count; ++n ){
+		if( Pool[n].pid == pid ){
+			Remove_pool_worker( n );
+			break;
+		}
+	}
+}
+
+/*
+ * close all of the channels;  the workers will exit when
+ * they have finished the current connection.  Used when the
+ * configuration is reread.
+ */
+
+void Pool_shutdown( void )
+{
+	while( Pool_count > 0 ){
+		Remove_pool_worker( Pool_count-1 );
+	}
+}
+
+static void Remove_pool_worker( int n )
+{
+	DEBUG1("Remove_pool_worker: worker pid %ld, fd %d",
+		(long)Pool[n].pid, Pool[n].fd );
+	close( Pool[n].fd );
+	--Pool_count;
+	memmove( &Pool[n], &Pool[n+1], (Pool_count - n)*sizeof(Pool[0]) );
+}
+
+/*
+ * start a new pool worker
+ *  returns: index of worker, -1 if we cannot start one
+ */
+
+static int Start_pool_worker( void )
+{
+#if defined(POOL_SUPPORTED)
+	struct line_list args;
+	int channel[2], max;
+	pid_t pid;
+
+	max = Get_max_servers() - 4;
+	if( max > Pool_workers_DYN ) max = Pool_workers_DYN;
+	if( Pool_count >= max || Countpid() >= Get_max_servers() ){
+		DEBUG1("Start_pool_worker: pool full, %d workers", Pool_count );
+		return( -1 );
+	}
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, channel ) == -1 ){
+		logerr(LOG_INFO, "Start_pool_worker: socketpair failed" );
+		return( -1 );
+	}
+	Max_open(channel[0]); Max_open(channel[1]);
+	Init_line_list(&args);
+	pid = Start_worker( "pool", Service_pool, &args, channel[1] );
+	close( channel[1] );
+	if( pid < 0 ){
+		logerr(LOG_INFO, "Start_pool_worker: fork failed" );
+		close( channel[0] );
+		return( -1 );
+	}
+	if( Pool_count >= Pool_max ){
+		Pool_max += 16;
+		Pool = realloc_or_die( Pool, Pool_max*sizeof(Pool[0]),
+			__FILE__,__LINE__);
+	}
+	Pool[Pool_count].pid = pid;
+	Pool[Pool_count].fd = channel[0];
+	Pool[Pool_count].busy = 0;
+	DEBUG1("Start_pool_worker: worker pid %ld, fd %d, %d workers",
+		(long)pid, channel[0], Pool_count+1 );
+	return( Pool_count++ );
+#else
+	return( -1 );
+#endif
+}
+
+/*
+ * Send_fd( int channel, int fd )
+ *  pass an open file descriptor over a UNIX domain socket
+ *  returns: 0 on success, -1 on failure
+ */
+
+int Send_fd( int channel, int fd )
+{
+#if defined(POOL_SUPPORTED)
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr cm;
+		char control[CMSG_SPACE(sizeof(int))];
+	} control;
+	char c = 0;
+	int n;
+
+	memset( &msg, 0, sizeof(msg) );
+	memset( &control, 0, sizeof(control) );
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.control;
+	msg.msg_controllen = sizeof(control.control);
+	cmsg = CMSG_FIRSTHDR( &msg );
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy( CMSG_DATA(cmsg), &fd, sizeof(int) );
+	do{
+		n = sendmsg( channel, &msg, 0 );
+	} while( n < 0 && errno == EINTR );
+	return( n == 1 ? 0 : -1 );
+#else
+	return( -1 );
+#endif
+}
+
+/*
+ * Receive_fd( int channel )
+ *  get a file descriptor passed by Send_fd()
+ *  returns: fd, or -1 if the channel was closed
+ */
+
+int Receive_fd( int channel )
+{
+#if defined(POOL_SUPPORTED)
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		struct cmsghdr cm;
+		char control[CMSG_SPACE(sizeof(int))];
+	} control;
+	char c;
+	int n, fd = -1;
+
+	memset( &msg, 0, sizeof(msg) );
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.control;
+	msg.msg_controllen = sizeof(control.control);
+	do{
+		n = recvmsg( channel, &msg, 0 );
+	} while( n < 0 && errno == EINTR );
+	if( n <= 0 ){
+		DEBUG1("Receive_fd: channel %d closed", channel );
+		return( -1 );
+	}
+	if( (cmsg = CMSG_FIRSTHDR( &msg ))
+		&& cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS ){
+		memcpy( &fd, CMSG_DATA(cmsg), sizeof(int) );
+		Max_open(fd);
+	}
+	DEBUG1("Receive_fd: channel %d, fd %d", channel, fd );
+	return( fd );
+#else
+	return( -1 );
+#endif
+}
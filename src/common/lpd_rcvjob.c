@@ -30,6 +30,8 @@ static int Get_route( struct job *job, char *error, int errlen );
 static int Do_incoming_control_filter( struct job *job, char *error, int errlen );
 static void Generate_control_file( struct job *job );
 static int Find_non_colliding_job_number( struct job *job );
+static int Lock_fifo_file( void );
+static int Publish_job( struct job *job, char *error, int errlen );
 
 /***************************************************************************
  * Commentary:
@@ -199,23 +201,9 @@ int Receive_job( int *sock, char *input )
 		goto error;
 	}
 
-	/* fifo order enforcement */
-	if( Fifo_DYN ){
-		char * path = Make_pathname( Spool_dir_DYN, Fifo_lock_file_DYN );
-		path = safestrdup3( path,"." , RemoteHost_IP.fqdn, __FILE__,__LINE__ );
-		DEBUGF(DRECV1)( "Receive_job: checking fifo_lock file '%s'", path );
-		fifo_fd = Checkwrite( path, &statb, O_RDWR, 1, 0 );
-		if( fifo_fd < 0 ){
-			Errorcode = JABORT;
-			logerr_die(LOG_ERR, _("Receive_job: cannot open lockfile '%s'"),
-				path ); 
-		}
-		if( Do_lock( fifo_fd, 1 ) < 0 ){
-			Errorcode = JABORT;
-			logerr_die(LOG_ERR, _("Receive_job: cannot lock lockfile '%s'"),
-				path ); 
-		}
-		free(path); path = NULL;
+	/* fifo order enforcement;  a durable receive locks only to publish */
+	if( Fifo_DYN && !Durable_receive_DYN ){
+		fifo_fd = Lock_fifo_file();
 	}
 
 	while( status == 0 ){
@@ -298,6 +286,20 @@ int Receive_job( int *sock, char *input )
 			goto error;
 		}
 
+		if( discarding_large_job ){
+			temp_fd = Checkwrite( "/dev/null", &statb,0,0,0);
+			tempfile = 0;
+		} else {
+			temp_fd = Make_temp_fd(&tempfile);
+			/* make sure that the space is really there */
+			if( Preallocate_fd( temp_fd, file_len ) ){
+				plp_snprintf( error, errlen,
+					_("%s: insufficient file space"), Printer_DYN );
+				ack = ACK_RETRY;
+				goto error;
+			}
+		}
+
 		/*
 		 * we are ready to read the file; send 0 ack saying so
 		 */
@@ -313,13 +315,6 @@ int Receive_job( int *sock, char *input )
 			goto error;
 		}
 
-		if( discarding_large_job ){
-			temp_fd = Checkwrite( "/dev/null", &statb,0,0,0);
-			tempfile = 0;
-		} else {
-			temp_fd = Make_temp_fd(&tempfile);
-		}
-
 		/*
 		 * If the file length is 0, then we transfer only as much as we have
 		 * space available. Note that this will be the last file in a job
@@ -376,7 +371,7 @@ int Receive_job( int *sock, char *input )
 							Errormsg( errno ) );
 						goto error;
 					}
-					if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+					Queue_status_changed();
 				}
 				Free_line_list(&files);
 				discarding_large_job = 0;
@@ -413,7 +408,7 @@ int Receive_job( int *sock, char *input )
 								Errormsg( errno ) );
 							goto error;
 						}
-						if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+						Queue_status_changed();
 					}
 					Free_line_list(&files);
 					discarding_large_job = 0;
@@ -464,7 +459,7 @@ int Receive_job( int *sock, char *input )
 					Errormsg( errno ) );
 				goto error;
 			}
-			if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+			Queue_status_changed();
 			discarding_large_job = 0;
 		}
 	}
@@ -482,7 +477,10 @@ int Receive_job( int *sock, char *input )
 		DEBUGF(DRECV1)("Receive_job: error, removing job" );
 		DEBUGFC(DRECV4)Dump_job("Receive_job - error", &job );
 		s = Find_str_value(&job.info,HF_NAME);
-		if( !ISNULL(s) ) unlink(s);
+		if( !ISNULL(s) ){
+			unlink(s);
+			Release_job_number(s);
+		}
 		if( ack == 0 ) ack = ACK_FAIL;
 		buffer[0] = ack;
 		plp_snprintf(buffer+1,sizeof(buffer)-1, "%s\n",error);
@@ -496,9 +494,7 @@ int Receive_job( int *sock, char *input )
 		Get_spool_control( Queue_control_file_DYN, &Spool_control );
 		Set_flag_value(&Spool_control,CHANGE,1);
 		Set_spool_control( 0, Queue_control_file_DYN, &Spool_control );
-		if( Lpq_status_file_DYN ){
-			unlink( Lpq_status_file_DYN );
-		}
+		Queue_status_changed();
 		s = Server_queue_name_DYN;
 		if( !s ) s = Printer_DYN;
 
@@ -629,6 +625,15 @@ int Receive_block_job( int *sock, char *input )
 		goto error;
 	}
 
+	temp_fd = Make_temp_fd( &tempfile );
+	/* make sure that the space is really there */
+	if( Preallocate_fd( temp_fd, file_len ) ){
+		plp_snprintf( error, errlen-4,
+			_("%s: insufficient file space"), Printer_DYN );
+		ack = ACK_RETRY;
+		goto error;
+	}
+
 	/*
 	 * we are ready to read the file; send 0 ack saying so
 	 */
@@ -642,7 +647,6 @@ int Receive_block_job( int *sock, char *input )
 		goto error;
 	}
 
-	temp_fd = Make_temp_fd( &tempfile );
 	DEBUGF(DRECV4)("Receive_block_job: receiving '%s' %0.0f bytes ", tempfile, file_len );
 	status = Link_file_read( ShortRemote_FQDN, sock,
 		Send_job_rw_timeout_DYN, 0, temp_fd, &read_len, &ack );
@@ -858,7 +862,7 @@ int Scan_block_file( int fd, char *error, int errlen, struct line_list *header_i
 							Errormsg( errno ) );
 						goto error;
 					}
-					if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+					Queue_status_changed();
 				} else {
 					if( Check_for_missing_files(&job, &files, error, errlen, header_info, job_ticket_fd) ){
 						goto error;
@@ -894,7 +898,7 @@ int Scan_block_file( int fd, char *error, int errlen, struct line_list *header_i
 							Errormsg( errno ) );
 						goto error;
 					}
-					if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+					Queue_status_changed();
 				} else {
 					if( Check_for_missing_files(&job, &files, error, errlen, header_info, job_ticket_fd) ){
 						goto error;
@@ -930,7 +934,7 @@ int Scan_block_file( int fd, char *error, int errlen, struct line_list *header_i
 					Errormsg( errno ) );
 				goto error;
 			}
-			if( Lpq_status_file_DYN ){ unlink(Lpq_status_file_DYN); }
+			Queue_status_changed();
 		} else {
 			if( Check_for_missing_files(&job, &files, error, errlen, header_info, job_ticket_fd) ){
 				goto error;
@@ -1320,6 +1324,12 @@ int Check_for_missing_files( struct job *job, struct line_list *files,
 		}
 	}
 
+	/* a durable receive stages,  syncs,  and publishes the job itself */
+	if( Durable_receive_DYN ){
+		status = Publish_job( job, error, errlen );
+		goto error;
+	}
+
 	/* now rename the data files */
 	status = 0;
 	for( count = 0; status == 0 && count < job->datafiles.count; ++count ){
@@ -1363,7 +1373,10 @@ int Check_for_missing_files( struct job *job, struct line_list *files,
 			if( openname ) unlink(openname);
 		}
 		openname = Find_str_value(&job->info,HF_NAME);
-		if( openname ) unlink(openname);
+		if( openname ){
+			unlink(openname);
+			Release_job_number(openname);
+		}
 	} else {
 		/*
 		logmsg(LOG_INFO, "Check_for_missing_files: SUCCESS '%s'", transfername);
@@ -1375,6 +1388,112 @@ int Check_for_missing_files( struct job *job, struct line_list *files,
 	return( status );
 }
 
+/***************************************************************************
+ * int Lock_fifo_file( void )
+ *  lock the fifo lock file for the remote host;  returns the locked fd
+ ***************************************************************************/
+
+static int Lock_fifo_file( void )
+{
+	int fifo_fd;
+	struct stat statb;
+	char * path = Make_pathname( Spool_dir_DYN, Fifo_lock_file_DYN );
+
+	path = safestrdup3( path,"." , RemoteHost_IP.fqdn, __FILE__,__LINE__ );
+	DEBUGF(DRECV1)( "Lock_fifo_file: checking fifo_lock file '%s'", path );
+	fifo_fd = Checkwrite( path, &statb, O_RDWR, 1, 0 );
+	if( fifo_fd < 0 ){
+		Errorcode = JABORT;
+		logerr_die(LOG_ERR, _("Receive_job: cannot open lockfile '%s'"),
+			path ); 
+	}
+	if( Do_lock( fifo_fd, 1 ) < 0 ){
+		Errorcode = JABORT;
+		logerr_die(LOG_ERR, _("Receive_job: cannot lock lockfile '%s'"),
+			path ); 
+	}
+	free(path); path = NULL;
+	return( fifo_fd );
+}
+
+/***************************************************************************
+ * int Publish_job( struct job *job, char *error, int errlen )
+ *  durable receive:  the data files are still in their temporary files,
+ *  so we put the job ticket in one as well,  sync them (shared with the
+ *  other receivers),  rename them all into place,  and sync the directory.
+ *  Until the job ticket is renamed the queue has only the incoming job
+ *  ticket written by Setup_temporary_job_ticket_file(),  so the job is
+ *  not printed before its files are on disk.
+ *  Returns 0 on success.
+ ***************************************************************************/
+
+static int Publish_job( struct job *job, char *error, int errlen )
+{
+	struct line_list files, *lp;
+	struct stat statb;
+	char *openname, *transfername, *hf_name, *tempfile;
+	int count, fd, fifo_fd = -1, status = 0;
+
+	Init_line_list(&files);
+	hf_name = Find_str_value(&job->info,HF_NAME);
+	fd = Make_temp_fd( &tempfile );
+	if( Set_job_ticket_file( job, 0, fd ) ){
+		plp_snprintf( error,errlen,
+			_("Error setting up job ticket file - %s"),
+			Errormsg( errno ) );
+		close(fd);
+		return( 1 );
+	}
+	close(fd);
+	Add_line_list(&files,tempfile,0,0,0);
+	for( count = 0; count < job->datafiles.count; ++count ){
+		lp = (void *)job->datafiles.list[count];
+		openname = Find_str_value(lp,OPENNAME);
+		if( !stat(openname,&statb) ) Add_line_list(&files,openname,0,0,0);
+	}
+	if( Sync_spool_files( &files ) ){
+		plp_snprintf( error,errlen, _("cannot sync job files to disk - %s"),
+			Errormsg( errno ) );
+		status = 1;
+		goto done;
+	}
+
+	if( Fifo_DYN ) fifo_fd = Lock_fifo_file();
+	for( count = 0; status == 0 && count < job->datafiles.count; ++count ){
+		lp = (void *)job->datafiles.list[count];
+		openname = Find_str_value(lp,OPENNAME);
+		if( stat(openname,&statb) ) continue;
+		transfername = Find_str_value(lp,DFTRANSFERNAME);
+		DEBUGF(DRECV1)("Publish_job: renaming '%s' to '%s'",
+			openname, transfername );
+		if( (status = rename(openname,transfername)) ){
+			plp_snprintf( error,errlen,
+				"error renaming '%s' to '%s' - %s",
+				openname, transfername, Errormsg( errno ) );
+		}
+	}
+	if( status == 0 && (status = rename(tempfile,hf_name)) ){
+		plp_snprintf( error,errlen,
+			"error renaming '%s' to '%s' - %s",
+			tempfile, hf_name, Errormsg( errno ) );
+	}
+	if( fifo_fd > 0 ) close(fifo_fd);
+	fifo_fd = -1;
+
+	/* the job has been published and may be printing,  so we
+	 * only report it if the renames cannot be synced */
+	if( status == 0 && Sync_spool_files( 0 ) ){
+		logerr( LOG_INFO, "Publish_job: cannot sync spool directory for '%s'",
+			hf_name );
+	}
+	if( status == 0 && DEBUGL1 ) Dump_job("Publish_job - ending", job );
+
+ done:
+	if( status ) unlink( tempfile );
+	Free_line_list(&files);
+	return( status );
+}
+
 /***************************************************************************
  * int Setup_temporary_job_ticket_file( struct job *job,
  *	char *error, int errlen )
@@ -1438,15 +1557,19 @@ static int Find_non_colliding_job_number( struct job *job )
 	int job_ticket_fd = -1;			/* job job ticket file fd */
 	struct stat statb;			/* for status */
 	char hold_file[SMALLBUFFER], *number;
-	int max, n, start;
+	int max, n, i, tries;
 
 	/* we set the job number to a reasonable range */
 	job_ticket_fd = -1;
 	number = Fix_job_number(job,0);
-	start = n = strtol(number,0,10);
+	n = strtol(number,0,10);
 	max = 1000;
-	if( Long_number_DYN ) max = 1000000;
-	while( job_ticket_fd < 0 ){
+	if( Long_number_DYN && !Backwards_compatible_DYN ) max = 1000000;
+	for( tries = 0; job_ticket_fd < 0 && tries < max; ++tries ){
+		/* skip the numbers the job number file has as in use */
+		if( (i = Allocate_job_number( n, max )) >= 0 ){
+			n = i;
+		}
 		number = Fix_job_number(job,n);
 		plp_snprintf(hold_file,sizeof(hold_file), "hfA%s",number);
 		DEBUGF(DRECV1)("Find_non_colliding_job_number: trying %s", hold_file );
@@ -1459,10 +1582,7 @@ static int Find_non_colliding_job_number( struct job *job )
 			job_ticket_fd = -1;
 			hold_file[0] = 0;
 			++n;
-			if( n > max ) n = 0;
-			if( n == start ){
-				break;
-			}
+			if( n >= max ) n = 0;
 		} else {
 			Set_str_value(&job->info,HF_NAME,hold_file);
 		}
@@ -479,15 +479,17 @@ int Remove_job( struct job *job )
 	openname = Find_str_value(&job->info,OPENNAME);
 	fail |= Remove_file( openname );
 	openname = Find_str_value(&job->info,HF_NAME);
-	fail |= Remove_file( openname );
+	if( Remove_file( openname ) ){
+		fail = 1;
+	} else {
+		Release_job_number( openname );
+	}
 
 	if( fail == 0 ){
 		setmessage( job, TRACE, "remove SUCCESS" );
 	} else {
 		setmessage( job, TRACE, "remove FAILED" );
 	}
-	if( Lpq_status_file_DYN ){
-		unlink(Lpq_status_file_DYN);
-	}
+	Queue_status_changed();
 	return( fail );
 }
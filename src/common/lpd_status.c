@@ -20,6 +20,7 @@
 #include "permission.h"
 #include "lockfile.h"
 #include "errorcodes.h"
+#include "fanout.h"
 
 #include "lpd_jobs.h"
 #include "lpd_status.h"
@@ -72,8 +73,32 @@
 #define SIZEW 6
 #define TIMEW 8
 
+static const char Long_status_header[] =
+/*
+ Rank  Owner/ID  Class Job Files   Size Time
+*/
+" Rank   Owner/ID               Pr/Class Job Files                 Size Time";
+
 static void Print_status_info( int *sock, char *file,
 	char *prefix, int status_lines, int max_size );
+static void Format_job_status( struct job *job, int count,
+	struct line_list *outbuf );
+static int Snapshot_format( void );
+
+/*
+ * status of all the queues,  scanned in parallel by Fanout_status()
+ */
+struct all_status {
+	struct line_list *tokens;
+	struct line_list *done_list;
+	int *sock;
+	int displayformat, status_lines;
+	int db, dbflag;
+	char *hash_key;
+};
+
+static int All_status_scan( int n, int fd, void *arg );
+static int All_status_report( int n, char *output, int len, void *arg );
 
 int Job_status( int *sock, char *input )
 {
@@ -213,7 +238,19 @@ int Job_status( int *sock, char *input )
 		/* note that we have already tried to get the 'all' list */
 		
 		Get_all_printcap_entries();
-		for( i = 0; i < All_line_list.count; ++i ){
+		if( Queue_scan_workers_DYN > 1 && All_line_list.count > 1 ){
+			struct all_status all;
+			all.tokens = &l;
+			all.done_list = &done_list;
+			all.sock = sock;
+			all.displayformat = displayformat;
+			all.status_lines = status_lines;
+			all.db = db;
+			all.dbflag = dbflag;
+			all.hash_key = hash_key;
+			Fanout_status( All_line_list.count, Queue_scan_workers_DYN,
+				All_status_scan, All_status_report, &all );
+		} else for( i = 0; i < All_line_list.count; ++i ){
 			Set_DYN(&Printer_DYN, All_line_list.list[i] );
 			Debug = db;
 			DbgFlag = dbflag;
@@ -243,6 +280,401 @@ int Job_status( int *sock, char *input )
 	return(0);
 }
 
+/*
+ * All_status_scan( int n, int fd, void *arg )
+ *  get the status of printer n in All_line_list,  writing it to fd.
+ *  The printers before it have already been reported,  so we do not
+ *  report them again as subservers or destinations.  The status is
+ *  followed by a 0 and the list of printers that it reported.
+ */
+
+static int All_status_scan( int n, int fd, void *arg )
+{
+	struct all_status *all = arg;
+	struct line_list earlier, done_list;
+	char *s;
+	int i;
+
+	Init_line_list(&earlier);
+	Init_line_list(&done_list);
+	for( i = 0; i < n; ++i ){
+		Add_line_list(&earlier,All_line_list.list[i],Hash_value_sep,1,1);
+		Add_line_list(&done_list,All_line_list.list[i],Hash_value_sep,1,1);
+	}
+	Set_DYN(&Printer_DYN, All_line_list.list[n] );
+	Debug = all->db;
+	DbgFlag = all->dbflag;
+	Get_queue_status( all->tokens, &fd, all->displayformat,
+		all->status_lines, &done_list, Max_status_size_DYN, all->hash_key );
+	if( Write_fd_len( fd, "", 1 ) < 0 ) return( 1 );
+	for( i = 0; i < done_list.count; ++i ){
+		s = done_list.list[i];
+		if( Find_exists_value(&earlier,s,Hash_value_sep) ) continue;
+		if( Write_fd_str( fd, s ) < 0 || Write_fd_str( fd, "\n" ) < 0 ){
+			return( 1 );
+		}
+	}
+	Free_line_list(&earlier);
+	Free_line_list(&done_list);
+	return( 0 );
+}
+
+/*
+ * All_status_report( int n, char *output, int len, void *arg )
+ *  send the status of printer n to the client,  unless it was
+ *  already reported as the subserver or destination of an earlier one
+ */
+
+static int All_status_report( int n, char *output, int len, void *arg )
+{
+	struct all_status *all = arg;
+	struct line_list reported;
+	char *s;
+	int i;
+
+	if( output == 0
+		|| Find_exists_value(all->done_list,All_line_list.list[n],Hash_value_sep) ){
+		return( 0 );
+	}
+	s = output + safestrlen(output);
+	if( s > output && Write_fd_len( *all->sock, output, s - output ) < 0 ){
+		cleanup(0);
+	}
+	if( s < output + len ){
+		Init_line_list(&reported);
+		Split(&reported,s+1,Line_ends,0,0,0,0,0,0);
+		for( i = 0; i < reported.count; ++i ){
+			Add_line_list(all->done_list,reported.list[i],Hash_value_sep,1,1);
+		}
+		Free_line_list(&reported);
+	}
+	return( 0 );
+}
+
+/*
+ * Format_job_status( struct job *job, int count, struct line_list *outbuf )
+ *  add the long format status lines for the job to outbuf
+ *  count is the job position in the queue
+ */
+
+static void Format_job_status( struct job *job, int count, struct line_list *outbuf )
+{
+	char msg[SMALLBUFFER], buffer[SMALLBUFFER], number[LINEBUFFER];
+	char sizestr[SIZEW+TIMEW+32], prclass[32];
+	const char *identifier, *cs;
+	char *s, *t, *jobname, *joberror, *class, *priority, *d_identifier,
+		*job_time, *d_error, *d_dest, *filenames;
+	int len, nx, nodest, dcount, destinations, d_copies, d_copy_done,
+		jobnumber;
+	double jobsize;
+
+	nodest = 0;
+	s = Find_str_value(&job->info,PRSTATUS);
+	if( s == 0 ){
+		plp_snprintf(number,sizeof(number), "%d",count+1);
+	} else {
+		plp_snprintf(number,sizeof(number), "%s",s);
+	}
+	identifier = Find_str_value(&job->info,IDENTIFIER);
+	if( identifier == 0 ){
+		identifier = Find_str_value(&job->info,LOGNAME);
+	}
+	if( identifier == 0 ){
+		identifier = "???";
+	}
+	priority = Find_str_value(&job->info,PRIORITY);
+	class = Find_str_value(&job->info,CLASS);
+	jobname = Find_str_value(&job->info,JOBNAME);
+	filenames = Find_str_value(&job->info,FILENAMES);
+	jobnumber = Find_decimal_value(&job->info,NUMBER);
+	joberror = Find_str_value(&job->info,ERROR);
+	jobsize = Find_double_value(&job->info,SIZE);
+	job_time = Find_str_value(&job->info,JOB_TIME );
+	destinations = Find_flag_value(&job->info,DESTINATIONS);
+
+	/* we report this jobs status */
+
+	DEBUGF(DLPQ3)("Format_job_status: class '%s', priority '%s'",
+		class, priority );
+
+	if( class ){
+		if( safestrcmp(class,priority)
+			|| Class_in_status_DYN || priority == 0 ){
+			plp_snprintf( prclass, sizeof(prclass), "%s/%s",
+				priority?priority:"?", class );
+			priority = prclass;
+		}
+	}
+
+	plp_snprintf( msg, sizeof(msg),
+		"%-*s %-*s ", RANKW-1, number, OWNERW-1, identifier );
+	while( (len = safestrlen(msg)) > (RANKW+OWNERW)
+		&& isspace(cval(msg+len-1)) && isspace(cval(msg+len-2)) ){
+		msg[len-1] = 0;
+	}
+	plp_snprintf( buffer, sizeof(buffer), "%-*s %*d ",
+		CLASSW-1,priority, JOBW-1,jobnumber);
+	DEBUGF(DLPQ3)("Format_job_status: msg len %d '%s', buffer %d, '%s'",
+		safestrlen(msg),msg, safestrlen(buffer), buffer );
+	DEBUGF(DLPQ3)("Format_job_status: RANKW %d, OWNERW %d, CLASSW %d, JOBW %d",
+		RANKW, OWNERW, CLASSW, JOBW );
+	s = buffer;
+	while( safestrlen(buffer) > CLASSW+JOBW && (s = safestrchr(s,' ')) ){
+		if( cval(s+1) == ' ' ){
+			memmove(s,s+1,safestrlen(s)+1);
+		} else {
+			++s;
+		}
+	}
+	s = msg+safestrlen(msg)-1;
+	while( safestrlen(msg) + safestrlen(buffer) > RANKW+OWNERW+CLASSW+JOBW ){
+		if( cval(s) == ' ' && cval(s-1) == ' ' ){
+			*s-- = 0;
+		} else {
+			break;
+		}
+	}
+	s = buffer;
+	while( safestrlen(msg) + safestrlen(buffer) > RANKW+OWNERW+CLASSW+JOBW
+		&& (s = safestrchr(s,' ')) ){
+		if( cval(s+1) == ' ' ){
+			memmove(s,s+1,safestrlen(s)+1);
+		} else {
+			++s;
+		}
+	}
+	len = safestrlen(msg);
+
+	plp_snprintf(msg+len, sizeof(msg)-len, "%s",buffer);
+	if( joberror ){
+		len = safestrlen(msg);
+			plp_snprintf(msg+len,sizeof(msg)-len,
+			"ERROR: %s", joberror );
+	} else {
+		char jobb[32];
+		DEBUGF(DLPQ3)("Format_job_status: jobname '%s'", jobname );
+
+		len = safestrlen(msg);
+		plp_snprintf(msg+len,sizeof(msg)-len, "%-s",jobname?jobname:filenames);
+		plp_snprintf(jobb,sizeof(jobb), "%0.0f", jobsize );
+
+		job_time = Time_str(1, Convert_to_time_t(job_time));
+		if( !Full_time_DYN && (t = safestrchr(job_time,'.')) ) *t = 0;
+		plp_snprintf( sizestr, sizeof(sizestr), "%*s %-s",
+			SIZEW-1,jobb, job_time );
+		DEBUGF(DLPQ3)("Format_job_status: size_str '%s'",sizestr);
+
+		len = Max_status_line_DYN;
+		if( len >= (int)sizeof(msg)) len = sizeof(msg)-1;
+		len = len-safestrlen(sizestr);
+		if( len > 0 ){
+			/* pad with spaces */
+			for( nx = safestrlen(msg); nx < len; ++nx ){
+				msg[nx] = ' ';
+			}
+			msg[nx] = 0;
+		}
+		/* remove spaces if necessary */
+		while( safestrlen(msg) + safestrlen(sizestr) > Max_status_line_DYN ){
+			if( isspace( cval(sizestr) ) ){
+				memmove(sizestr, sizestr+1, safestrlen(sizestr)+1);
+			} else {
+				s = msg+safestrlen(msg)-1;
+				if( isspace(cval(s)) && isspace(cval(s-1)) ){
+					s[0] = 0;
+				} else {
+					break;
+				}
+			}
+		}
+		if( safestrlen(msg) + safestrlen(sizestr) >= Max_status_line_DYN ){
+			len = Max_status_line_DYN - safestrlen(sizestr);
+			msg[len-1] = ' ';
+			msg[len] = 0;
+		}
+		strcpy( msg+safestrlen(msg), sizestr );
+	}
+
+	if( Max_status_line_DYN < (int)sizeof(msg) ) msg[Max_status_line_DYN] = 0;
+
+	DEBUGF(DLPQ3)("Format_job_status: adding '%s'", msg );
+	Add_line_list(outbuf,msg,0,0,0);
+	DEBUGF(DLPQ3)("Format_job_status: destinations '%d'", destinations );
+	if( nodest == 0 && destinations ){
+		for( dcount = 0; dcount < destinations; ++dcount ){
+			if( Get_destination( job, dcount ) ) continue;
+			DEBUGFC(DLPQ3)Dump_line_list("Format_job_status: destination",
+				&job->destination);
+			d_error =
+				Find_str_value(&job->destination,ERROR);
+			d_dest =
+				Find_str_value(&job->destination,DEST);
+			d_copies = 
+				Find_flag_value(&job->destination,COPIES);
+			d_copy_done = 
+				Find_flag_value(&job->destination,COPY_DONE);
+			d_identifier =
+				Find_str_value(&job->destination,IDENTIFIER);
+			cs = Find_str_value(&job->destination, PRSTATUS);
+			if( !cs ) cs = "";
+			plp_snprintf(number, sizeof(number), " - %-8s", cs );
+			plp_snprintf( msg, sizeof(msg),
+				"%-*s %-*s ", RANKW, number, OWNERW, d_identifier );
+			len = safestrlen(msg);
+			plp_snprintf(msg+len, sizeof(msg)-len, " ->%s", d_dest );
+			if( d_copies > 1 ){
+				len = safestrlen( msg );
+				plp_snprintf( msg+len, sizeof(msg)-len,
+					_(" <cpy %d/%d>"), d_copy_done, d_copies );
+			}
+			if( d_error ){
+				len = safestrlen(msg);
+				plp_snprintf( msg+len, sizeof(msg)-len, " ERROR: %s", d_error );
+			}
+			Add_line_list(outbuf,msg,0,0,0);
+		}
+	}
+	DEBUGF(DLPQ3)("Format_job_status: after dests" );
+}
+
+/*
+ * the status line format parameters recorded in a queue status snapshot;
+ *  a snapshot made with different values cannot be used
+ */
+
+static int Snapshot_format( void )
+{
+	return( Max_status_line_DYN * 4 + (Full_time_DYN != 0) * 2
+		+ (Class_in_status_DYN != 0) );
+}
+
+/*
+ * Publish_queue_snapshot( struct queue_snapshot *snap,
+ *   struct line_list *sort_order, int printable, int held, int move,
+ *   int only_queue_process )
+ *  write the queue status snapshot for the jobs in sort_order;
+ *  snap has been set up by Begin_queue_snapshot() before the queue
+ *  was scanned.  The job information comes from the queue index made
+ *  by the scan.  If only_queue_process is set the jobs that the queue
+ *  server has nothing to do with are then dropped from sort_order,
+ *  as Scan_queue() would have done.
+ */
+
+void Publish_queue_snapshot( struct queue_snapshot *snap,
+	struct line_list *sort_order, int printable, int held, int move,
+	int only_queue_process )
+{
+	struct line_list lines;
+	struct line_arena *arena;
+	struct job job;
+	int count, n, p, h, m, e, dn;
+	long remove, error, done, t;
+	char *s;
+
+	Init_line_list(&lines);
+	Init_job(&job);
+	snap->format = Snapshot_format();
+	snap->jobs = sort_order->count;
+	snap->printable = printable;
+	snap->held = held;
+	snap->move = move;
+	snap->matches = snap->total_held = snap->total_move = 0;
+	snap->removable = 0;
+	snap->oldest_removable = 0;
+	arena = Make_line_arena();
+	for( count = 0; count < sort_order->count; ++count ){
+		Free_job(&job);
+		Reset_line_arena( arena );
+		Use_line_arena( &job.info, arena );
+		Get_job_ticket_from_index( &job, sort_order->list[count] );
+		if( job.info.count == 0 ){
+			/* job was removed */
+			continue;
+		}
+		p = h = m = e = dn = 0;
+		Job_printable(&job,&Spool_control, &p,&h,&m,&e,&dn);
+		if( p ){
+			++snap->matches;
+		} else if( h ){
+			++snap->total_held;
+		} else if( m ){
+			++snap->total_move;
+		}
+		/* the jobs that Remove_done_jobs() looks at */
+		remove = Find_flag_value(&job.info,REMOVE_TIME);
+		error = Find_flag_value(&job.info,ERROR_TIME);
+		done = Find_flag_value(&job.info,DONE_TIME);
+		if( remove || (error && !Save_on_error_DYN) ){
+			++snap->removable;
+			t = error;
+			if( done && (!t || done < t) ) t = done;
+			if( t && (!snap->oldest_removable || t < snap->oldest_removable) ){
+				snap->oldest_removable = t;
+			}
+		}
+		Format_job_status( &job, count, &lines );
+		if( only_queue_process && !(p || m || e || dn) ){
+			free( sort_order->list[count] );
+			sort_order->list[count] = 0;
+		}
+	}
+	s = Join_line_list(&lines,"\n");
+	Write_queue_snapshot( snap, s );
+	if( s ) free(s);
+	Free_job(&job);
+	Free_line_arena( arena );
+	Free_line_list(&lines);
+	if( only_queue_process ){
+		for( count = n = 0; count < sort_order->count; ++count ){
+			if( sort_order->list[count] ){
+				sort_order->list[n++] = sort_order->list[count];
+			}
+		}
+		sort_order->count = n;
+	}
+}
+
+/*
+ * int Snapshot_removal_due( struct queue_snapshot *snap )
+ *  the queue has done or error jobs that Remove_done_jobs() would remove,
+ *  so the snapshot should not be used in place of a queue scan
+ */
+
+int Snapshot_removal_due( struct queue_snapshot *snap )
+{
+	if( Save_when_done_DYN || Save_on_error_DYN ) return( 0 );
+	if( Done_jobs_DYN > 0 && snap->removable > Done_jobs_DYN ) return( 1 );
+	if( Done_jobs_max_age_DYN > 0 && snap->oldest_removable
+		&& time( (void *)0 ) - snap->oldest_removable > Done_jobs_max_age_DYN ){
+		return( 1 );
+	}
+	return( 0 );
+}
+
+/*
+ * int Scan_queue_snapshot( struct line_list *sort_order, int *pprintable,
+ *   int *pheld, int *pmove, int *perr, int *pdone )
+ *  Scan_queue() for the queue server,  which also publishes the queue
+ *  status snapshot from the same scan;  sort_order only has the jobs the
+ *  queue server may need to process
+ */
+
+int Scan_queue_snapshot( struct line_list *sort_order, int *pprintable,
+	int *pheld, int *pmove, int *perr, int *pdone )
+{
+	struct queue_snapshot snap;
+	int status, snapshot;
+
+	snapshot = Lpq_status_snapshot_DYN && !Begin_queue_snapshot( &snap );
+	status = Scan_queue( &Spool_control, sort_order,
+		pprintable, pheld, pmove, !snapshot, perr, pdone, 0, 0 );
+	if( status == 0 && snapshot ){
+		Publish_queue_snapshot( &snap, sort_order,
+			*pprintable, *pheld, *pmove, 1 );
+	}
+	return( status );
+}
+
 /***************************************************************************
  * void Get_queue_status
  * sock - used to send information
@@ -258,22 +690,20 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 {
 	char msg[SMALLBUFFER], buffer[SMALLBUFFER], error[SMALLBUFFER],
 		number[LINEBUFFER], header[LARGEBUFFER];
-	char sizestr[SIZEW+TIMEW+32];
 	const char *identifier, *cs;
-	char *pr, *s, *t, *path,
-		*jobname, *joberror, *class, *priority, *d_identifier,
-		*job_time, *d_error, *d_dest, *cftransfername, *hf_name, *filenames,
-		*tempfile = 0, *file = 0, *end_of_name;
+	char *pr, *s, *t, *path, *joberror, *job_time, *cftransfername,
+		*tempfile = 0, *file = 0, *end_of_name, *snapshot_lines = 0;
 	struct line_list outbuf, info, lineinfo, cache, cache_info;
 	int status = 0, len, ix, nx, flag, count, held, move,
-		server_pid, unspooler_pid, fd, nodest,
-		printable, dcount, destinations = 0,
-		d_copies, d_copy_done, permission, jobnumber, db, dbflag,
+		server_pid, unspooler_pid, fd,
+		printable, permission, db, dbflag,
 		matches, tempfd, savedfd, lockfd, delta, err, cache_index,
-		total_held, total_move, jerror, jdone;
+		total_held, total_move, jerror, jdone, snapshot;
 	double jobsize;
 	struct stat statb;
 	struct job job;
+	struct line_arena *arena;
+	struct queue_snapshot snap;
 	time_t modified = 0;
 	time_t timestamp = 0;
 	time_t now = time( (void *)0 );
@@ -358,8 +788,25 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 		goto error;
 	}
 
+	/*
+	 * use the queue status snapshot if it is current;  otherwise
+	 * we make a new one when we scan the queue
+	 */
+	snapshot = -1;
+	if( Lpq_status_snapshot_DYN && tokens->count == 0
+		&& (displayformat == REQ_DSHORT || displayformat == REQ_DLONG) ){
+		if( Read_queue_snapshot( &snap, &snapshot_lines ) == 0
+			&& snap.format == Snapshot_format()
+			&& !Snapshot_removal_due( &snap ) ){
+			snapshot = 1;
+		} else {
+			snapshot = 0;
+		}
+		DEBUGF(DLPQ1)("Get_queue_status: snapshot %d", snapshot );
+	}
+
 	/* check to see if we have any cached information */
-	if( Lpq_status_cached_DYN > 0 && Lpq_status_file_DYN ){
+	if( snapshot < 0 && Lpq_status_cached_DYN > 0 && Lpq_status_file_DYN ){
 		fd = -1;
 		do{
 			DEBUGF(DLPQ1)("Job_status: getting lock on '%s'", Lpq_status_file_DYN);
@@ -512,11 +959,31 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 
 	/* get the spool entries */
 	Free_line_list( &outbuf );
+	if( snapshot > 0 ){
+		DEBUGF(DLPQ3)("Get_queue_status: using snapshot, %d jobs", snap.jobs );
+		printable = snap.printable;
+		held = snap.held;
+		move = snap.move;
+		matches = snap.matches;
+		total_held = snap.total_held;
+		total_move = snap.total_move;
+		count = snap.jobs;
+		if( displayformat == REQ_DLONG && count > 0 ){
+			Add_line_list(&outbuf,(char *)Long_status_header,0,0,0);
+			Split(&outbuf,snapshot_lines,Line_ends,0,0,0,0,0,0);
+		}
+		goto snapshot_done;
+	}
+	if( snapshot == 0 && Begin_queue_snapshot( &snap ) ) snapshot = -1;
 	Scan_queue( &Spool_control, &Sort_order, &printable,&held,&move,0,0,0,0,0 );
 	/* check for done jobs, remove any if there are some */
 	if( Remove_done_jobs() ){
+		if( snapshot == 0 && Begin_queue_snapshot( &snap ) ) snapshot = -1;
 		Scan_queue( &Spool_control, &Sort_order, &printable,&held,&move,0,0,0,0,0 );
 	}
+	if( snapshot == 0 ){
+		Publish_queue_snapshot( &snap, &Sort_order, printable, held, move, 0 );
+	}
 
 	DEBUGF(DLPQ3)("Get_queue_status: total files %d", Sort_order.count );
 	DEBUGFC(DLPQ3)Dump_line_list("Get_queue_status- Sort_order", &Sort_order );
@@ -525,24 +992,22 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 	/* set up the short format for folks */
 
 	if( displayformat == REQ_DLONG && Sort_order.count > 0 ){
-		/*
-		 Rank  Owner/ID  Class Job Files   Size Time
-		*/
-		Add_line_list(&outbuf,
-" Rank   Owner/ID               Pr/Class Job Files                 Size Time"
-		,0,0,0);
+		Add_line_list(&outbuf,(char *)Long_status_header,0,0,0);
 	}
 	error[0] = 0;
 
 	matches = 0;
 	total_held = 0;
 	total_move = 0;
+	arena = Make_line_arena();
 	for( count = 0; count < Sort_order.count; ++count ){
 		int printable, held, move;
-		char prclass[32];
 		printable = held = move = 0;
 		Free_job(&job);
-		Get_job_ticket_file( 0, &job, Sort_order.list[count] );
+		Reset_line_arena( arena );
+		Use_line_arena( &job.info, arena );
+		/* Scan_queue() has just read the job tickets */
+		Get_job_ticket_from_index( &job, Sort_order.list[count] );
 		if( job.info.count == 0 ){
 			/* job was removed */
 			continue;
@@ -560,7 +1025,6 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 		number[0] = 0;
 		error[0] = 0;
 		msg[0] = 0;
-		nodest = 0;
 		s = Find_str_value(&job.info,PRSTATUS);
 		if( s == 0 ){
 			plp_snprintf(number,sizeof(number), "%d",count+1);
@@ -574,163 +1038,17 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 		if( identifier == 0 ){
 			identifier = "???";
 		}
-		priority = Find_str_value(&job.info,PRIORITY);
-		class = Find_str_value(&job.info,CLASS);
-		jobname = Find_str_value(&job.info,JOBNAME);
-		filenames = Find_str_value(&job.info,FILENAMES);
-		jobnumber = Find_decimal_value(&job.info,NUMBER);
 		joberror = Find_str_value(&job.info,ERROR);
 		jobsize = Find_double_value(&job.info,SIZE);
 		job_time = Find_str_value(&job.info,JOB_TIME );
-		destinations = Find_flag_value(&job.info,DESTINATIONS);
 		cftransfername = Find_str_value(&job.info,XXCFTRANSFERNAME);
-		hf_name = Find_str_value(&job.info,HF_NAME);
 
 		/* we report this jobs status */
 
 		DEBUGF(DLPQ3)("Get_queue_status: joberror '%s'", joberror );
-		DEBUGF(DLPQ3)("Get_queue_status: class '%s', priority '%s'",
-			class, priority );
-
-		if( class ){
-			if( safestrcmp(class,priority)
-				|| Class_in_status_DYN || priority == 0 ){
-				plp_snprintf( prclass, sizeof(prclass), "%s/%s",
-					priority?priority:"?", class );
-				priority = prclass;
-			}
-		}
 
 		if( displayformat == REQ_DLONG ){
-			plp_snprintf( msg, sizeof(msg),
-				"%-*s %-*s ", RANKW-1, number, OWNERW-1, identifier );
-			while( (len = safestrlen(msg)) > (RANKW+OWNERW)
-				&& isspace(cval(msg+len-1)) && isspace(cval(msg+len-2)) ){
-				msg[len-1] = 0;
-			}
-			plp_snprintf( buffer, sizeof(buffer), "%-*s %*d ",
-				CLASSW-1,priority, JOBW-1,jobnumber);
-			DEBUGF(DLPQ3)("Get_queue_status: msg len %d '%s', buffer %d, '%s'",
-				safestrlen(msg),msg, safestrlen(buffer), buffer );
-			DEBUGF(DLPQ3)("Get_queue_status: RANKW %d, OWNERW %d, CLASSW %d, JOBW %d",
-				RANKW, OWNERW, CLASSW, JOBW );
-			s = buffer;
-			while( safestrlen(buffer) > CLASSW+JOBW && (s = safestrchr(s,' ')) ){
-				if( cval(s+1) == ' ' ){
-					memmove(s,s+1,safestrlen(s)+1);
-				} else {
-					++s;
-				}
-			}
-			s = msg+safestrlen(msg)-1;
-			while( safestrlen(msg) + safestrlen(buffer) > RANKW+OWNERW+CLASSW+JOBW ){
-				if( cval(s) == ' ' && cval(s-1) == ' ' ){
-					*s-- = 0;
-				} else {
-					break;
-				}
-			}
-			s = buffer;
-			while( safestrlen(msg) + safestrlen(buffer) > RANKW+OWNERW+CLASSW+JOBW
-				&& (s = safestrchr(s,' ')) ){
-				if( cval(s+1) == ' ' ){
-					memmove(s,s+1,safestrlen(s)+1);
-				} else {
-					++s;
-				}
-			}
-			len = safestrlen(msg);
-
-			plp_snprintf(msg+len, sizeof(msg)-len, "%s",buffer);
-			if( joberror ){
-				len = safestrlen(msg);
-					plp_snprintf(msg+len,sizeof(msg)-len,
-					"ERROR: %s", joberror );
-			} else {
-				char jobb[32];
-				DEBUGF(DLPQ3)("Get_queue_status: jobname '%s'", jobname );
-
-				len = safestrlen(msg);
-				plp_snprintf(msg+len,sizeof(msg)-len, "%-s",jobname?jobname:filenames);
-				plp_snprintf(jobb,sizeof(jobb), "%0.0f", jobsize );
-
-				job_time = Time_str(1, Convert_to_time_t(job_time));
-				if( !Full_time_DYN && (t = safestrchr(job_time,'.')) ) *t = 0;
-				plp_snprintf( sizestr, sizeof(sizestr), "%*s %-s",
-					SIZEW-1,jobb, job_time );
-				DEBUGF(DLPQ3)("XGet_queue_status: size_str '%s'",sizestr);
-
-				len = Max_status_line_DYN;
-				if( len >= (int)sizeof(msg)) len = sizeof(msg)-1;
-				len = len-safestrlen(sizestr);
-				if( len > 0 ){
-					/* pad with spaces */
-					for( nx = safestrlen(msg); nx < len; ++nx ){
-						msg[nx] = ' ';
-					}
-					msg[nx] = 0;
-				}
-				/* remove spaces if necessary */
-				while( safestrlen(msg) + safestrlen(sizestr) > Max_status_line_DYN ){
-					if( isspace( cval(sizestr) ) ){
-						memmove(sizestr, sizestr+1, safestrlen(sizestr)+1);
-					} else {
-						s = msg+safestrlen(msg)-1;
-						if( isspace(cval(s)) && isspace(cval(s-1)) ){
-							s[0] = 0;
-						} else {
-							break;
-						}
-					}
-				}
-				if( safestrlen(msg) + safestrlen(sizestr) >= Max_status_line_DYN ){
-					len = Max_status_line_DYN - safestrlen(sizestr);
-					msg[len-1] = ' ';
-					msg[len] = 0;
-				}
-				strcpy( msg+safestrlen(msg), sizestr );
-			}
-
-			if( Max_status_line_DYN < (int)sizeof(msg) ) msg[Max_status_line_DYN] = 0;
-
-			DEBUGF(DLPQ3)("Get_queue_status: adding '%s'", msg );
-			Add_line_list(&outbuf,msg,0,0,0);
-			DEBUGF(DLPQ3)("Get_queue_status: destinations '%d'", destinations );
-			if( nodest == 0 && destinations ){
-				for( dcount = 0; dcount < destinations; ++dcount ){
-					if( Get_destination( &job, dcount ) ) continue;
-					DEBUGFC(DLPQ3)Dump_line_list("Get_queue_status: destination",
-						&job.destination);
-					d_error =
-						Find_str_value(&job.destination,ERROR);
-					d_dest =
-						Find_str_value(&job.destination,DEST);
-					d_copies = 
-						Find_flag_value(&job.destination,COPIES);
-					d_copy_done = 
-						Find_flag_value(&job.destination,COPY_DONE);
-					d_identifier =
-						Find_str_value(&job.destination,IDENTIFIER);
-					cs = Find_str_value(&job.destination, PRSTATUS);
-					if( !cs ) cs = "";
-					plp_snprintf(number, sizeof(number), " - %-8s", cs );
-					plp_snprintf( msg, sizeof(msg),
-						"%-*s %-*s ", RANKW, number, OWNERW, d_identifier );
-					len = safestrlen(msg);
-					plp_snprintf(msg+len, sizeof(msg)-len, " ->%s", d_dest );
-					if( d_copies > 1 ){
-						len = safestrlen( msg );
-						plp_snprintf( msg+len, sizeof(msg)-len,
-							_(" <cpy %d/%d>"), d_copy_done, d_copies );
-					}
-					if( d_error ){
-						len = safestrlen(msg);
-						plp_snprintf( msg+len, sizeof(msg)-len, " ERROR: %s", d_error );
-					}
-					Add_line_list(&outbuf,msg,0,0,0);
-				}
-			}
-			DEBUGF(DLPQ3)("Get_queue_status: after dests" );
+			Format_job_status( &job, count, &outbuf );
 		} else if( displayformat == REQ_VERBOSE ){
 			plp_snprintf( header, sizeof(header),
 				_(" Job: %s"), identifier );
@@ -770,6 +1088,9 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 			}
 		}
 	}
+	Free_job(&job);
+	Free_line_arena( arena );
+ snapshot_done:
 	DEBUGF(DLPQ3)("Get_queue_status: matches %d", matches );
 	/* this gives a short 1 line format with minimum info */
 	if( displayformat == REQ_DSHORT ){
@@ -970,14 +1291,11 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 		server_pid = 0;
 	}
 
+	/* there is a line for each unspooler */
 	path = Make_pathname( Spool_dir_DYN, Queue_unspooler_file_DYN );
-	unspooler_pid = Read_pid_from_file( path );
+	unspooler_pid = Server_active( path );
 	free(path); path=NULL;
-	DEBUGF(DLPQ3)("Get_queue_status: checking unspooler pid %d", unspooler_pid );
-	if( unspooler_pid > 0 && kill( unspooler_pid, 0 ) ){
-		DEBUGF(DLPQ3)("Get_queue_status: unspooler %d not active", unspooler_pid );
-		unspooler_pid = 0;
-	}
+	DEBUGF(DLPQ3)("Get_queue_status: unspooler pid %d", unspooler_pid );
 
 	if( printable == 0 ){
 		safestrncpy( msg, _(" Queue: no printable jobs in queue\n") );
@@ -1243,11 +1561,14 @@ void Get_queue_status( struct line_list *tokens, int *sock,
 	if( Write_fd_str( *sock, header ) < 0 ) cleanup(0);
  done:
 	if( savedfd > 0 ) *sock = savedfd;
+	/* the cached status path leaves the lock file open */
+	if( lockfd > 0 ) close( lockfd );
 	Free_line_list(&info);
 	Free_line_list(&lineinfo);
 	Free_line_list(&outbuf);
 	Free_line_list(&cache);
 	Free_line_list(&cache_info);
+	if( snapshot_lines ) free( snapshot_lines );
 	return;
 }
 
@@ -1265,15 +1586,15 @@ static void Print_status_info( int *sock, char *file,
 	if( status_lines > 0 ){
 		i = (status_lines * 100)/1024;
 		if( i == 0 ) i = 1;
-		image = Get_file_image(file, i);
+		image = Get_status_file_image(file, i, status_lines);
 		Split(&l,image,Line_ends,0,0,0,0,0,0);
 		if( l.count < status_lines ){
 			free( image );
-			image = Get_file_image(file, 0);
+			image = Get_status_file_image(file, 0, status_lines);
 			Split(&l,image,Line_ends,0,0,0,0,0,0);
 		}
 	} else {
-		image = Get_file_image(file, max_size);
+		image = Get_status_file_image(file, max_size, 0);
 		Split(&l,image,Line_ends,0,0,0,0,0,0);
 	}
 
@@ -126,6 +126,17 @@ static void Do_work( const char *name, struct line_list *args, WorkerProc *proc,
  */
 
 pid_t Start_worker( const char *name, WorkerProc *proc, struct line_list *parms, int fd )
+{
+	return( Start_worker_fds( name, proc, parms, fd, 0, -1 ) );
+}
+
+/*
+ * Start_worker_fds - Start_worker that passes a second FD
+ *   - the worker finds its number in the args under 'key'
+ */
+
+pid_t Start_worker_fds( const char *name, WorkerProc *proc, struct line_list *parms, int fd,
+	const char *key, int fd2 )
 {
 	struct line_list args;
 	int passfd[20];
@@ -174,6 +185,10 @@ pid_t Start_worker( const char *name, WorkerProc *proc, struct line_list *parms,
 	}
 	Merge_line_list( &args, parms, Hash_value_sep,1,1);
 	Free_line_list( parms );
+	if( key && fd2 > 0 ){
+		Set_decimal_value( &args, key, passfd_count );
+		passfd[passfd_count++] = fd2;
+	}
 	if( fd ){
 		intern_fd = passfd_count;
 		passfd[passfd_count++] = fd;
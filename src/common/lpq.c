@@ -91,6 +91,7 @@
 #include "lp.h"
 
 #include "child.h"
+#include "fanout.h"
 #include "getopt.h"
 #include "getprinter.h"
 #include "getqueue.h"
@@ -198,7 +199,10 @@ int main(int argc, char *argv[], char *envp[])
 			DEBUG1("lpq: all printers");
 			Get_all_printcap_entries();
 			if(DEBUGL1)Dump_line_list("lpq- All_line_list", &All_line_list );
-			for( i = 0; i < All_line_list.count; ++i ){
+			if( Queue_scan_workers_DYN > 1 && All_line_list.count > 1 ){
+				Fanout_status( All_line_list.count, Queue_scan_workers_DYN,
+					Scan_status, Report_status, argv );
+			} else for( i = 0; i < All_line_list.count; ++i ){
 				Set_DYN(&Printer_DYN,All_line_list.list[i] );
 				Show_status(argv);
 			}
@@ -279,6 +283,55 @@ static void Show_status(char **argv)
 	DEBUG1("Show_status: end");
 }
 
+/*
+ * get the status of printer n in All_line_list,  writing it to fd;
+ *  used by Fanout_status() to ask for the status of several printers
+ *  at once.  The status from the server is put between 0 bytes,
+ *  so that Report_status() can leave out the printers that have
+ *  already been shown.
+ */
+
+static int Scan_status( int n, int fd, void *argv )
+{
+	int out;
+
+	/* Show_status() writes to STDOUT */
+	if( (out = dup(1)) < 0 || dup2( fd, 1 ) < 0 ){
+		logerr_die(LOG_INFO, "Scan_status: dup failed" );
+	}
+	Set_DYN(&Printer_DYN,All_line_list.list[n] );
+	Status_worker = 1;
+	Show_status( argv );
+	Status_worker = 0;
+	dup2( out, 1 );
+	close( out );
+	return( 0 );
+}
+
+static int Report_status( int n UNUSED, char *output, int len, void *argv UNUSED )
+{
+	struct line_list l;
+	char *s, *end = output + len;
+
+	Init_line_list(&l);
+	while( output < end ){
+		/* our messages */
+		s = output + safestrlen(output);
+		if( s > output && Write_fd_len( 1, output, s - output ) < 0 ) cleanup(0);
+		if( s >= end ) break;
+		/* the status from the server */
+		output = s + 1;
+		s = output + safestrlen(output);
+		Free_line_list(&l);
+		Split( &l, output, Line_ends, 0, 0, 0, 0, 0, 0 );
+		if( Print_status_lines( &l, 1, Displayformat, Status_line_count ) ){
+			cleanup(0);
+		}
+		output = s + 1;
+	}
+	Free_line_list(&l);
+	return( 0 );
+}
 
 /***************************************************************************
  *int Read_status_info( int ack, int fd, int timeout );
@@ -297,16 +350,13 @@ int Read_status_info( char *host UNUSED, int sock,
 	int output, int timeout, int displayformat,
 	int status_line_count )
 {
-	int n, status, count, line, last_line, same;
-	char header[SMALLBUFFER], buffer[SMALLBUFFER];
-	char *s, *t;
+	int n, status;
+	char buffer[SMALLBUFFER];
 	struct line_list l;
-	int look_for_pr = 0;
 
 	Init_line_list(&l);
 
-	header[0] = 0;
-	status = count = 0;
+	status = 0;
 	/* long status - trim lines */
 	DEBUG1("Read_status_info: output %d, timeout %d, dspfmt %d",
 		output, timeout, displayformat );
@@ -328,15 +378,49 @@ int Read_status_info( char *host UNUSED, int sock,
 		} while( n > 0 );
 		return 0;
 	}
+	/*
+	 * we are getting the status for Fanout_status();  the lpq
+	 * process checks the lines,  see Report_status()
+	 */
+	if( Status_worker ){
+		if( Write_fd_len( output, "", 1 ) < 0 ) return(1);
+		while( (n = Read_fd_len_timeout( Send_query_rw_timeout_DYN,
+				sock, buffer, sizeof(buffer)-1)) > 0 ){
+			if( Write_fd_len( output, buffer, n ) < 0 ) return(1);
+		}
+		if( Write_fd_len( output, "", 1 ) < 0 ) return(1);
+		return 0;
+	}
 
 	Read_fd_and_split( &l, sock, Line_ends, 0, 0, 0, 0, 0 );
-	if(DEBUGL1)Dump_line_list("lpq- status", &l );
+	status = Print_status_lines( &l, output, displayformat, status_line_count );
+	Free_line_list(&l);
+	DEBUG1("Read_status_info: done" );
+	return(status);
+}
+
+/*
+ * Print_status_lines( struct line_list *l, int output, int displayformat,
+ *   int status_line_count )
+ *  print the status lines from a server,  leaving out the printers
+ *  that we have already shown and trimming the long status
+ */
+
+static int Print_status_lines( struct line_list *l, int output,
+	int displayformat, int status_line_count )
+{
+	int n, line, last_line, same;
+	char header[SMALLBUFFER];
+	char *s, *t;
+	int look_for_pr = 0;
+
+	if(DEBUGL1)Dump_line_list("lpq- status", l );
 	last_line = -1;
 
 	/* now deal with the short status format */
 	if( displayformat == REQ_DSHORT ){
-		for( line = 0; line < l.count; ++line ){
-			s = l.list[line];
+		for( line = 0; line < l->count; ++line ){
+			s = l->list[line];
 			if( s && !Find_exists_value(&Printer_list,s,0) ){
 				if( Write_fd_str( output, s ) < 0
 					|| Write_fd_str( output, "\n" ) < 0 ) return(1);
@@ -350,7 +434,7 @@ int Read_status_info( char *host UNUSED, int sock,
 	header[0] = 0;
 	last_line = -1;
 	look_for_pr = 1;
-	for( line = 0; line < l.count; ){
+	for( line = 0; line < l->count; ){
 		/* we start by looking at the first line and seeing if it is
 		 * for a printer that we have already found
 		 * if look_for_pr is 1 then we have just started the search
@@ -360,8 +444,8 @@ int Read_status_info( char *host UNUSED, int sock,
 		 *    the end of a printer entry and we look for a line with
 		 *    Printer: in it that we have not seen 
 		 */
-		while( look_for_pr && line < l.count ){
-			s = l.list[line];
+		while( look_for_pr && line < l->count ){
+			s = l->list[line];
 			/* we do not want a line starting with a space or a blank line */
 			if( ISNULL(s) ){
 				look_for_pr = 1;
@@ -390,8 +474,8 @@ int Read_status_info( char *host UNUSED, int sock,
 		}
 		header[0] = 0;
 		last_line = -1;
-		while( !look_for_pr && line < l.count ){
-			s = l.list[line];
+		while( !look_for_pr && line < l->count ){
+			s = l->list[line];
 			DEBUG1("Read_status_info: last_line %d, header '%s', checking [%d] '%s'",
 				last_line, header, line, s );
 			/* find up to the first colon */
@@ -423,7 +507,7 @@ int Read_status_info( char *host UNUSED, int sock,
 				n = line - status_line_count;
 				if( n < last_line ) n = last_line; 
 				for( ; n < line; ++n ){
-					t = l.list[n];
+					t = l->list[n];
 					if( Write_fd_str( output, t ) < 0
 						|| Write_fd_str( output, "\n" ) < 0 ) return(1);
 				}
@@ -448,18 +532,16 @@ int Read_status_info( char *host UNUSED, int sock,
 	DEBUG1("Read_status_info: after checks look_for_pr %d, line %d, last_line %d",
 		look_for_pr, line, last_line);
 	if( !look_for_pr && last_line >= 0 ){
-		n = l.count - status_line_count;
+		n = l->count - status_line_count;
 		if( n < last_line ) n = last_line;
-		for( ; n < l.count; ++n ){
-			s = l.list[n];
+		for( ; n < l->count; ++n ){
+			s = l->list[n];
 			if( Write_fd_str( output, s ) < 0
 				|| Write_fd_str( output, "\n" ) < 0 ) return(1);
 		}
 	}
 
-	Free_line_list(&l);
-	Free_line_list(&l);
-	DEBUG1("Read_status_info: done" );
+	DEBUG1("Print_status_lines: done" );
 	return(0);
 }
 
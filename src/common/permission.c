@@ -55,13 +55,6 @@
 {0,0,0,0,0,0,0}
 };
 
-static int match_host( struct line_list *list, struct host_information *host,
-	int invert );
-static int match_range( struct line_list *list, int port, int invert );
-static int match_char( struct line_list *list, int value, int invert );
-static int match_group( struct line_list *list, const char *str, int invert );
-static int ingroup( char *group, const char *user );
-
 const char *perm_str( int n )
 {
 	return(Get_keystr(n,permwords));
@@ -75,6 +68,640 @@ static int perm_val( char *s )
 	return(Get_keyval(s,permwords));
 }
 
+/***************************************************************************
+ * Compiled permissions
+ *
+ * The permission lines are compiled into a program:  each line is a
+ * list of terms (keyword, NOT flag, values) and the values are parsed
+ * when they are compiled:
+ *   port ranges                    - low and high port
+ *   host patterns                  - lowercase glob, IPv4 and IPv6
+ *                                    address and mask
+ *   group names                    - the group ids and members of the
+ *                                    matching groups
+ *   </file lists                   - the values in the file
+ * Perms_check() then does one pass over the terms without splitting
+ * strings or allocating memory.  The program is reused until the
+ * permission lines change or one of the files it read (the </file
+ * lists and the group file) has a different size or modification time.
+ ***************************************************************************/
+
+/* value types */
+#define PV_NONE		0	/* never matches */
+#define PV_GLOB		1	/* glob pattern */
+#define PV_NETGROUP	2	/* @netgroup */
+#define PV_FILE		3	/* </file list, values are [start,start+count) */
+#define PV_HOST		4	/* host name pattern and address/mask */
+#define PV_RANGE	5	/* port range */
+#define PV_GROUP	6	/* group ids and members */
+#define PV_STR		7	/* SERVICE and CONTROLLINE strings */
+
+/* how the values of a keyword are compiled */
+#define PC_MATCH	1
+#define PC_HOST		2
+#define PC_GROUP	3
+#define PC_RANGE	4
+#define PC_STR		5
+
+#define PERM_ADDRLEN	16
+#define PERM_MAXDEPTH	8	/* </file lists in </file lists */
+
+struct perm_value {
+	int type;
+	int invert;				/* host list '!' prefix */
+	char *str;				/* pattern */
+	int start, count;		/* PV_FILE values */
+	int low, high;			/* PV_RANGE */
+	int addr_ok[2];			/* PV_HOST:  IPv4 and IPv6 address parsed */
+	char addr[2][PERM_ADDRLEN], mask[2][PERM_ADDRLEN];
+	gid_t *gids;			/* PV_GROUP */
+	int gid_count;
+	struct line_list members;
+};
+
+struct perm_term {
+	int key;
+	int invert;				/* NOT before term */
+	int start, count;		/* values */
+	int default_perm;		/* DEFAULT ACCEPT/REJECT */
+};
+
+struct perm_file {
+	char *path;
+	time_t mtime;			/* 0 if the file did not exist */
+	off_t size;
+};
+
+struct perm_program {
+	int valid;
+	struct line_list source;	/* the permission lines */
+	int *line_start;			/* terms of line i are [line_start[i],line_start[i+1]) */
+	struct perm_term *terms;
+	int term_count, term_max;
+	struct perm_value *values;
+	int value_count, value_max;
+	struct perm_file *files;
+	int file_count, file_max;
+};
+
+static struct perm_program Perm_program;
+
+/* user whose primary group Perms_check() looked up last */
+static char Perm_pw_user[64];
+static int Perm_pw_found;
+static gid_t Perm_pw_gid;
+
+static int Compile_values( struct perm_program *prog, int how,
+	struct line_list *args, int first, int depth );
+
+static void Free_perm_program( struct perm_program *prog )
+{
+	int i;
+	for( i = 0; i < prog->value_count; ++i ){
+		if( prog->values[i].str ) free( prog->values[i].str );
+		if( prog->values[i].gids ) free( prog->values[i].gids );
+		Free_line_list( &prog->values[i].members );
+	}
+	for( i = 0; i < prog->file_count; ++i ){
+		free( prog->files[i].path );
+	}
+	Free_line_list( &prog->source );
+	if( prog->line_start ) free( prog->line_start );
+	if( prog->terms ) free( prog->terms );
+	if( prog->values ) free( prog->values );
+	if( prog->files ) free( prog->files );
+	memset( prog, 0, sizeof(prog[0]) );
+}
+
+/*
+ * add count values,  return the index of the first one
+ */
+
+static int Add_perm_values( struct perm_program *prog, int count )
+{
+	int start = prog->value_count;
+	if( prog->value_count + count > prog->value_max ){
+		prog->value_max += count + 100;
+		prog->values = realloc_or_die( prog->values,
+			prog->value_max * sizeof(prog->values[0]), __FILE__,__LINE__ );
+	}
+	memset( &prog->values[start], 0, count * sizeof(prog->values[0]) );
+	prog->value_count += count;
+	return( start );
+}
+
+/*
+ * remember a file the program depends on
+ */
+
+static void Add_perm_file( struct perm_program *prog, const char *path )
+{
+	struct perm_file *f;
+	struct stat statb;
+	int i;
+
+	for( i = 0; i < prog->file_count; ++i ){
+		if( !strcmp( prog->files[i].path, path ) ) return;
+	}
+	if( prog->file_count >= prog->file_max ){
+		prog->file_max += 10;
+		prog->files = realloc_or_die( prog->files,
+			prog->file_max * sizeof(prog->files[0]), __FILE__,__LINE__ );
+	}
+	f = &prog->files[prog->file_count++];
+	f->path = safestrdup( path, __FILE__,__LINE__ );
+	f->mtime = 0;
+	f->size = 0;
+	if( stat( path, &statb ) == 0 ){
+		f->mtime = statb.st_mtime;
+		f->size = statb.st_size;
+	}
+}
+
+/*
+ * add the ids and members of a group to a PV_GROUP value
+ */
+
+static void Add_perm_group( struct perm_value *v, struct group *grent )
+{
+	char **members;
+
+	v->gids = realloc_or_die( v->gids, (v->gid_count+1) * sizeof(v->gids[0]),
+		__FILE__,__LINE__ );
+	v->gids[v->gid_count++] = grent->gr_gid;
+	for( members = grent->gr_mem; *members; ++members ){
+		Add_line_list( &v->members, *members, 0, 1, 1 );
+	}
+}
+
+/*
+ * compile a </file list into the values [v->start,v->start+v->count)
+ */
+
+static void Compile_perm_file( struct perm_program *prog, int n, int how,
+	const char *path, int depth )
+{
+	struct line_list users;
+	int start, count;
+
+	Init_line_list(&users);
+	Add_perm_file( prog, path );
+	if( depth < PERM_MAXDEPTH ){
+		Get_file_image_and_split(path,0,0,&users,Whitespace,
+			0,0,0,0,0,0);
+	} else {
+		logmsg( LOG_ERR, "Compile_perms: '%s' nested too deeply", path );
+	}
+	DEBUGFC(DDB3)Dump_line_list("Compile_perm_file- file contents'", &users );
+	start = Compile_values( prog, how, &users, 0, depth+1 );
+	count = users.count;
+	prog->values[n].type = PV_FILE;
+	prog->values[n].start = start;
+	prog->values[n].count = count;
+	Free_line_list(&users);
+}
+
+/*
+ * compile args->list[first..] into consecutive values,
+ *  return the index of the first one
+ */
+
+static int Compile_values( struct perm_program *prog, int how,
+	struct line_list *args, int first, int depth )
+{
+	struct perm_value *v;
+	struct group *grent;
+	char *s, *t, *end;
+	int i, n, start, low, high, err;
+
+	start = Add_perm_values( prog, args->count - first );
+	for( i = first; i < args->count; ++i ){
+		n = start + i - first;
+		s = args->list[i];
+		/* Compile_perm_file() can move the values */
+		v = &prog->values[n];
+		switch( how ){
+		case PC_MATCH:
+			if( cval(s) == '@' ){
+				v->type = PV_NETGROUP;
+				v->str = safestrdup( s+1, __FILE__,__LINE__ );
+			} else if( cval(s) == '<' && cval(s+1) == '/' ){
+				Compile_perm_file( prog, n, how, s+1, depth );
+			} else {
+				v->type = PV_GLOB;
+				v->str = safestrdup( s, __FILE__,__LINE__ );
+			}
+			break;
+		case PC_HOST:
+			if( cval(s) == '!' ){
+				v->invert = 1;
+				++s;
+			}
+			if( cval(s) == '@' ){
+				v->type = PV_NETGROUP;
+				v->str = safestrdup( s+1, __FILE__,__LINE__ );
+			} else if( cval(s) == '<' && cval(s+1) == '/' ){
+				Compile_perm_file( prog, n, how, s+1, depth );
+			} else {
+				v->type = PV_HOST;
+				v->str = safestrdup( s, __FILE__,__LINE__ );
+				lowercase( v->str );
+				v->addr_ok[0] = form_addr_and_mask( v->str, v->addr[0], v->mask[0],
+					4, AF_INET );
+#if defined(IPV6)
+				v->addr_ok[1] = form_addr_and_mask( v->str, v->addr[1], v->mask[1],
+					16, AF_INET6 );
+#endif
+			}
+			break;
+		case PC_GROUP:
+			if( cval(s) == '@' ){
+				v->type = PV_NETGROUP;
+				v->str = safestrdup( s+1, __FILE__,__LINE__ );
+			} else if( cval(s) == '<' && cval(s+1) == '/' ){
+				Compile_perm_file( prog, n, how, s+1, depth );
+			} else {
+				Add_perm_file( prog, "/etc/group" );
+				v->type = PV_GROUP;
+				v->str = safestrdup( s, __FILE__,__LINE__ );
+				if( (grent = getgrnam( s )) ){
+					Add_perm_group( v, grent );
+				} else if( safestrpbrk( s, "*[]") ){
+					/* wildcard in group name, use all matching groups */
+					setgrent();
+					while( (grent = getgrent()) ){
+						if( Globmatch( s, grent->gr_name ) == 0 ){
+							Add_perm_group( v, grent );
+						}
+					}
+					endgrent();
+				}
+				DEBUGF(DDB3)("Compile_values: group '%s' has %d groups, %d members",
+					s, v->gid_count, v->members.count );
+			}
+			break;
+		case PC_RANGE:
+			/* number or number-number */
+			v->type = PV_RANGE;
+			err = 0;
+			if( (t = safestrchr( s, '-' )) ) *t = 0;
+			low = strtol( s, &end, 10 );
+			if( end == s || *end ) err = 1;
+			high = low;
+			if( t ){
+				*t++ = '-';
+				high = strtol( t, &end, 10 );
+				if( t == end || *end ) err = 1;
+			}
+			if( err ){
+				logmsg( LOG_ERR, "portmatch: bad port range '%s'", s );
+			}
+			if( high < low ){
+				err = high; high = low; low = err;
+			}
+			v->low = low;
+			v->high = high;
+			break;
+		default:
+			v->type = PV_STR;
+			v->str = safestrdup( s, __FILE__,__LINE__ );
+			break;
+		}
+	}
+	return( start );
+}
+
+/*
+ * how the values for a keyword are matched
+ */
+
+static int Perm_value_kind( int key )
+{
+	switch( key ){
+	case P_IP: case P_HOST: case P_IFIP: case P_REMOTEHOST: case P_REMOTEIP:
+		return( PC_HOST );
+	case P_GROUP: case P_REMOTEGROUP:
+		return( PC_GROUP );
+	case P_PORT: case P_REMOTEPORT:
+		return( PC_RANGE );
+	case P_SERVICE: case P_CONTROLLINE:
+		return( PC_STR );
+	}
+	return( PC_MATCH );
+}
+
+/*
+ * void Compile_perms( struct line_list *perms )
+ *  compile the permission lines unless the current program is for them
+ */
+
+static int Perm_program_current( struct perm_program *prog,
+	struct line_list *perms )
+{
+	struct stat statb;
+	struct perm_file *f;
+	int i;
+
+	if( !prog->valid || prog->source.count != perms->count ) return( 0 );
+	for( i = 0; i < perms->count; ++i ){
+		if( safestrcmp( prog->source.list[i], perms->list[i] ) ) return( 0 );
+	}
+	for( i = 0; i < prog->file_count; ++i ){
+		f = &prog->files[i];
+		if( stat( f->path, &statb ) ){
+			if( f->mtime ) return( 0 );
+		} else if( statb.st_mtime != f->mtime || statb.st_size != f->size ){
+			DEBUGF(DDB1)("Perm_program_current: '%s' changed", f->path );
+			return( 0 );
+		}
+	}
+	return( 1 );
+}
+
+void Compile_perms( struct line_list *perms )
+{
+	struct perm_program *prog = &Perm_program;
+	struct perm_term *term;
+	struct line_list values, args;
+	int linecount, valuecount, key, invert;
+
+	if( perms == 0 || Perm_program_current( prog, perms ) ) return;
+	DEBUGF(DDB1)("Compile_perms: %d lines", perms->count );
+	Free_perm_program( prog );
+	Init_line_list(&values);
+	Init_line_list(&args);
+	prog->line_start = malloc_or_die( (perms->count+1) * sizeof(prog->line_start[0]),
+		__FILE__,__LINE__ );
+	for( linecount = 0; linecount < perms->count; ++linecount ){
+		Add_line_list( &prog->source, perms->list[linecount], 0, 0, 0 );
+		prog->line_start[linecount] = prog->term_count;
+		Free_line_list(&values);
+		Split(&values,perms->list[linecount],Whitespace,0,0,0,0,0,0);
+		invert = 0;
+		for( valuecount = 0; valuecount < values.count; ++valuecount ){
+			Free_line_list(&args);
+			Split(&args,values.list[valuecount],Perm_sep,0,0,0,0,0,0);
+			if( args.count == 0 ) continue;
+			key = perm_val( args.list[0] );
+			if( key == P_NOT ){
+				invert = 1;
+				continue;
+			}
+			if( prog->term_count >= prog->term_max ){
+				prog->term_max += 100;
+				prog->terms = realloc_or_die( prog->terms,
+					prog->term_max * sizeof(prog->terms[0]), __FILE__,__LINE__ );
+			}
+			term = &prog->terms[prog->term_count++];
+			memset( term, 0, sizeof(term[0]) );
+			term->key = key;
+			term->invert = invert;
+			invert = 0;
+			if( key == 0 ) break;
+			if( key == P_DEFAULT ){
+				if( values.count == 2 ){
+					switch( perm_val( values.list[1]) ){
+					case P_REJECT: term->default_perm = P_REJECT; break;
+					case P_ACCEPT: term->default_perm = P_ACCEPT; break;
+					}
+				}
+				break;
+			}
+			term->start = Compile_values( prog, Perm_value_kind(key),
+				&args, 1, 0 );
+			term->count = args.count - 1;
+		}
+		/* an empty line is skipped;  mark it with a P_NOT term */
+		if( values.count == 0 ){
+			if( prog->term_count >= prog->term_max ){
+				prog->term_max += 100;
+				prog->terms = realloc_or_die( prog->terms,
+					prog->term_max * sizeof(prog->terms[0]), __FILE__,__LINE__ );
+			}
+			term = &prog->terms[prog->term_count++];
+			memset( term, 0, sizeof(term[0]) );
+			term->key = P_NOT;
+		}
+	}
+	prog->line_start[linecount] = prog->term_count;
+	prog->valid = 1;
+	Free_line_list(&values);
+	Free_line_list(&args);
+	DEBUGF(DDB1)("Compile_perms: %d terms, %d values, %d files",
+		prog->term_count, prog->value_count, prog->file_count );
+}
+
+/***************************************************************************
+ * static int perm_match( prog, start, count, char *str, int invert );
+ *  returns 1 on failure, 0 on success
+ *  - match the string against the values
+ *    values are glob type regular expressions, @netgroup or </file
+ *  - if string is null then match fails
+ ***************************************************************************/
+
+static int perm_match( struct perm_program *prog, int start, int count,
+	const char *str, int invert )
+{
+ 	int result = 1, i;
+	struct perm_value *v;
+ 	DEBUGF(DDB3)("perm_match: str '%s', invert %d", str, invert );
+ 	if(str)for( i = start; result && i < start+count; ++i ){
+		v = &prog->values[i];
+		switch( v->type ){
+		case PV_NETGROUP:	/* look up host in netgroup */
+#ifdef HAVE_INNETGR
+			result = !innetgr( v->str, (char *)str, 0, 0 );
+#else /* HAVE_INNETGR */
+			DEBUGF(DDB3)("perm_match: no innetgr() call, netgroups not permitted");
+#endif /* HAVE_INNETGR */
+			break;
+		case PV_FILE:
+			result = perm_match( prog, v->start, v->count, str, 0 );
+			break;
+		default:
+	 		result = Globmatch( v->str, str );
+			break;
+		}
+		DEBUGF(DDB3)("perm_match: value[%d]='%s', result %d", i, v->str, result );
+	}
+	if( invert ) result = !result;
+ 	DEBUGF(DDB3)("perm_match: str '%s' final result %d", str, result );
+	return( result );
+}
+
+/***************************************************************************
+ * static int perm_ipaddr( prog, start, count, struct host_information *host )
+ *  returns 1 on failure, 0 on success
+ *  compiled version of Match_ipaddr_value():  a '!' prefix inverts the
+ *  result of that and the following values
+ ***************************************************************************/
+
+static int perm_ipaddr( struct perm_program *prog, int start, int count,
+	struct host_information *host )
+{
+	int result = 1, i, j, k, invert = 0;
+	struct perm_value *v;
+
+	if( host == 0 || host->fqdn == 0 ) return(result);
+	k = -1;
+	if( host->h_addrtype == AF_INET && host->h_length == 4 ) k = 0;
+#if defined(IPV6)
+	if( host->h_addrtype == AF_INET6 && host->h_length == 16 ) k = 1;
+#endif
+	for( i = start; result && i < start+count; ++i ){
+		v = &prog->values[i];
+		if( v->invert ) invert = 1;
+		switch( v->type ){
+		case PV_NETGROUP:	/* look up host in netgroup */
+#ifdef HAVE_INNETGR
+			result = !innetgr( v->str, host->shorthost, NULL, NULL );
+			if( result ) result = !innetgr( v->str, host->fqdn, NULL, NULL );
+#else /* HAVE_INNETGR */
+			DEBUGF(DDB3)("perm_ipaddr: no innetgr() call, netgroups not permitted");
+#endif /* HAVE_INNETGR */
+			break;
+		case PV_FILE:
+			result = perm_ipaddr( prog, v->start, v->count, host );
+			break;
+		case PV_HOST:
+			for( j = 0; result && j < host->host_names.count; ++j ){
+				lowercase(host->host_names.list[j]);
+				result = Globmatch( v->str, host->host_names.list[j] );
+			}
+			if( result && k >= 0 && v->addr_ok[k] ){
+				for( j = 0; result && j < host->h_addr_list.count; ++j ){
+					result = cmp_ip_addr( host->h_addr_list.list[j],
+						v->addr[k], v->mask[k], host->h_length );
+				}
+			}
+			break;
+		}
+		DEBUGF(DDB2)("perm_ipaddr: checked '%s', result %d", v->str, result);
+		if( invert ) result = !result;
+	}
+	return( result ? 1 : 0 );
+}
+
+static int perm_match_host( struct perm_program *prog, int start, int count,
+	struct host_information *host, int invert )
+{
+ 	int result = perm_ipaddr( prog, start, count, host );
+	if( invert ) result = !result;
+ 	DEBUGF(DDB3)("perm_match_host: host '%s' final result %d", host?host->fqdn:0,
+		result );
+	return( result );
+}
+
+/***************************************************************************
+ * static int perm_match_range( prog, start, count, int port, int invert );
+ * check the port number against the ranges
+ ***************************************************************************/
+
+static int perm_match_range( struct perm_program *prog, int start, int count,
+	int port, int invert )
+{
+	int result = 1;
+	int i;
+	struct perm_value *v;
+
+	for( i = start; result && i < start+count; ++i ){
+		v = &prog->values[i];
+		result = !( port >= v->low && port <= v->high );
+	}
+	if( invert ) result = !result;
+	DEBUGF(DDB3)("perm_match_range: port '%d' result %d", port, result );
+	return( result );
+}
+
+/***************************************************************************
+ * static int perm_match_char( prog, start, count, int value, int invert );
+ * check for the character value in one of the strings
+ ***************************************************************************/
+
+static int perm_match_char( struct perm_program *prog, int start, int count,
+	int value, int invert )
+{
+	int result = 1;
+	int i;
+	char *s;
+
+	for( i = start; result && i < start+count; ++i ){
+		s = prog->values[i].str;
+		result = (safestrchr( s, value ) == 0) && (safestrchr(s,'*') == 0) ;
+		DEBUGF(DDB3)("perm_match_char: val %c, str '%s', match %d",
+			value, s, result);
+	}
+	if( invert ) result = !result;
+	DEBUGF(DDB3)("perm_match_char: value '%c' result %d", value, result );
+	return( result );
+}
+
+/***************************************************************************
+ * static int perm_ingroup( prog, struct perm_value *v, char *user );
+ *  returns 1 on failure, 0 on success
+ *  check if the user is in a group:  the user's default group is one of
+ *  the group ids or the user is one of the members
+ ***************************************************************************/
+
+static int perm_match_group( struct perm_program *prog, int start, int count,
+	const char *user, int invert );
+
+static int perm_ingroup( struct perm_program *prog, struct perm_value *v,
+	const char *user )
+{
+	struct passwd *pwent;
+	int result = 1, i;
+
+	switch( v->type ){
+	case PV_NETGROUP:	/* look up user in netgroup */
+#ifdef HAVE_INNETGR
+		if( innetgr( v->str, 0, (char *)user, 0 ) ) result = 0;
+#else /* HAVE_INNETGR */
+		DEBUGF(DDB3)( "perm_ingroup: no innetgr() call, netgroups not permitted" );
+#endif /* HAVE_INNETGR */
+		break;
+	case PV_FILE:
+		result = perm_match_group( prog, v->start, v->count, user, 0 );
+		break;
+	case PV_GROUP:
+		if( v->gid_count && safestrcmp( user, Perm_pw_user ) ){
+			Perm_pw_user[0] = 0;
+			Perm_pw_found = 0;
+			if( (pwent = getpwnam(user)) ){
+				Perm_pw_found = 1;
+				Perm_pw_gid = pwent->pw_gid;
+			}
+			if( safestrlen(user) < (int)sizeof(Perm_pw_user) ){
+				strcpy( Perm_pw_user, user );
+			}
+		}
+		for( i = 0; result && Perm_pw_found && i < v->gid_count; ++i ){
+			if( (long)Perm_pw_gid == (long)v->gids[i] ) result = 0;
+		}
+		for( i = 0; result && i < v->members.count; ++i ){
+			result = (safestrcmp( user, v->members.list[i] ) != 0);
+		}
+		break;
+	}
+	DEBUGF(DDB3)("perm_ingroup: user '%s', group '%s', result: %d",
+		user, v->str, result );
+	return( result );
+}
+
+static int perm_match_group( struct perm_program *prog, int start, int count,
+	const char *user, int invert )
+{
+ 	int result = 1;
+ 	int i;
+
+ 	for( i = start; user && result && i < start+count; ++i ){
+ 		result = perm_ingroup( prog, &prog->values[i], user );
+	}
+	if( invert ) result = !result;
+ 	DEBUGF(DDB3)("perm_match_group: user '%s' value %d", user, result );
+	return( result );
+}
+
 /***************************************************************************
  * Perms_check( struct line_list *perms, struct perm_check );
  * - run down the list of permissions
@@ -83,61 +710,55 @@ static int perm_val( char *s )
  * 1. the P_NOT field inverts the result of the next test
  * 2. if one test fails,  then we go to the next line
  * 3. The entire set of tests is accepted if all pass, i.e. none fail
+ * The permissions are compiled by Compile_perms() and the program is
+ * kept for the following checks.
  ***************************************************************************/
 
 int Perms_check( struct line_list *perms, struct perm_check *check,
 	struct job *job, int job_check )
 {
-	int j, c, linecount, valuecount, key;
+	struct perm_program *prog = &Perm_program;
+	struct perm_term *term;
+	int j, c, linecount, termcount, key;
 	int invert = 0;
 	int result = 0, m = 0;
-	struct line_list values, args;
 	char *s, *t;					/* string */
 	int last_default_perm;
 	char buffer[4];
 
 	DEBUGFC(DDB1)Dump_perm_check( "Perms_check - checking", check );
 	DEBUGFC(DDB1)Dump_line_list( "Perms_check - permissions", perms );
-	Init_line_list(&values);
-	Init_line_list(&args);
 	last_default_perm = perm_val( Default_permission_DYN );
 	DEBUGF(DDB1)("Perms_check: last_default_perm '%s', Default_perm '%s'",
 		perm_str( last_default_perm ), Default_permission_DYN );
 	if( check == 0 || perms == 0 ){
 		return( last_default_perm );
 	}
+	Compile_perms( perms );
+	Perm_pw_user[0] = 0;
+	Perm_pw_found = 0;
 	for( linecount = 0; result == 0 && linecount < perms->count; ++linecount ){
 		DEBUGF(DDB2)("Perms_check: line [%d]='%s'", linecount,
 			perms->list[linecount]);
-		Free_line_list(&values);
-		Split(&values,perms->list[linecount],Whitespace,0,0,0,0,0,0);
-		if( values.count == 0 ) continue;
-		result = 0; m = 0; invert = 0;
-		for( valuecount = 0; m == 0 && valuecount < values.count;
-				++valuecount ){
-			DEBUGF(DDB2)("Perms_check: [%d]='%s'",valuecount,
-				values.list[valuecount] );
-			Free_line_list(&args);
-			Split(&args,values.list[valuecount],Perm_sep,0,0,0,0,0,0);
-			if( args.count == 0 ) continue;
-			if( invert > 0 ){
-				invert = -1;
-			} else {
-				invert = 0;
-			}
-			key = perm_val( args.list[0] );
+		termcount = prog->line_start[linecount];
+		if( termcount < prog->line_start[linecount+1]
+			&& prog->terms[termcount].key == P_NOT ){
+			/* empty line */
+			continue;
+		}
+		result = 0; m = 0;
+		for( ; m == 0 && termcount < prog->line_start[linecount+1];
+				++termcount ){
+			term = &prog->terms[termcount];
+			key = term->key;
+			invert = term->invert;
 			if( key == 0 ){
 				m = 1;
 				break;
 			}
-			/* we remove the key entry */
-			Remove_line_list( &args, 0 );
 			DEBUGF(DDB2)("Perms_check: before doing %s, result %d, %s",
 				perm_str(key), result, perm_str(result) );
 			switch( key ){
-			case P_NOT:
-				invert = 1;
-				continue;
 			case P_REJECT: result = P_REJECT; m = 0; break;
 			case P_ACCEPT: result = P_ACCEPT; m = 0; break;
 			case P_USER:
@@ -146,7 +767,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				else switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->user, invert );
+					m = perm_match( prog, term->start, term->count, check->user, invert );
 					break;
 				}
 				break;
@@ -155,7 +776,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				case 'C':
-					m = match( &args, check->lpc, invert );
+					m = perm_match( prog, term->start, term->count, check->lpc, invert );
 					break;
 				}
 				break;
@@ -167,7 +788,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				else switch (check->service){
 				case 'X': break;
 				default:
-					m = match_host( &args, check->host, invert );
+					m = perm_match_host( prog, term->start, term->count, check->host, invert );
 					break;
 				}
 				break;
@@ -178,7 +799,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				else switch (check->service){
 				case 'X': break;
 				default:
-					m = match_group( &args, check->user, invert );
+					m = perm_match_group( prog, term->start, term->count, check->user, invert );
 					break;
 				}
 				break;
@@ -188,7 +809,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				m = 1;
 				switch (check->service){
 				case 'X': case 'M': case 'C':
-					m = match_range( &args, check->port, invert );
+					m = perm_match_range( prog, term->start, term->count, check->port, invert );
 					break;
 				}
 				break;
@@ -197,7 +818,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->remoteuser, invert );
+					m = perm_match( prog, term->start, term->count, check->remoteuser, invert );
 					break;
 				}
 				break;
@@ -206,7 +827,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match_group( &args, check->remoteuser, invert );
+					m = perm_match_group( prog, term->start, term->count, check->remoteuser, invert );
 					break;
 				}
 				break;
@@ -214,7 +835,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 			case P_IFIP:
 			case P_REMOTEHOST:
 			case P_REMOTEIP:
-				m = match_host( &args, check->remotehost, invert );
+				m = perm_match_host( prog, term->start, term->count, check->remotehost, invert );
 				break;
 
 			case P_AUTH:
@@ -236,7 +857,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				default:
 					DEBUGF(DDB3)(
 						"Perms_check: P_AUTHTYPE authtype '%s'", check->authtype );
-					m = match( &args, check->authtype, invert );
+					m = perm_match( prog, term->start, term->count, check->authtype, invert );
 				}
 				break;
 
@@ -245,7 +866,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->authfrom, invert );
+					m = perm_match( prog, term->start, term->count, check->authfrom, invert );
 				}
 				break;
 
@@ -254,7 +875,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->authca, invert );
+					m = perm_match( prog, term->start, term->count, check->authca, invert );
 				}
 				break;
 
@@ -263,7 +884,7 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->authuser, invert );
+					m = perm_match( prog, term->start, term->count, check->authuser, invert );
 				}
 				break;
 
@@ -271,8 +892,8 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				/* check to see if we have control line */
 				m = 1;
 				if( !job_check ){ m = 0; }
-				for( j = 0; m && j < args.count; ++j ){
-					if( !(t = args.list[j]) ) continue;
+				for( j = 0; m && j < term->count; ++j ){
+					if( !(t = prog->values[term->start+j].str) ) continue;
 					c = cval(t);
 					buffer[1] = 0; buffer[0] = c;
 					if( isupper(c) && (s = Find_str_value(&job->info,buffer))){
@@ -287,12 +908,12 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 				switch (check->service){
 				case 'X': break;
 				default:
-					m = match( &args, check->printer, invert );
+					m = perm_match( prog, term->start, term->count, check->printer, invert );
 					break;
 				}
 				break;
 			case P_SERVICE:
-				m = match_char( &args, check->service, invert );
+				m = perm_match_char( prog, term->start, term->count, check->service, invert );
 				break;
 			case P_FORWARD:
 			case P_SAMEHOST:
@@ -386,14 +1007,11 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 
 			case P_DEFAULT:
 				
-				DEBUGF(DDB3)("Perms_check: DEFAULT - %d, values.count %d",
-					valuecount, values.count );
+				DEBUGF(DDB3)("Perms_check: DEFAULT - %s",
+					perm_str(term->default_perm) );
 				m = 1;
-				if( values.count == 2 ){
-					switch( perm_val( values.list[1]) ){
-					case P_REJECT: last_default_perm =  P_REJECT; break;
-					case P_ACCEPT: last_default_perm =  P_ACCEPT; break;
-					}
+				if( term->default_perm ){
+					last_default_perm = term->default_perm;
 				}
 			}
 			DEBUGF(DDB2)("Perms_check: match %d, result '%s' default now '%s'",
@@ -413,8 +1031,6 @@ int Perms_check( struct line_list *perms, struct perm_check *check,
 	}
 	DEBUGF(DDB1)("Perms_check: final result %d '%s'",
 				result, perm_str( result ) );
-	Free_line_list(&values);
-	Free_line_list(&args);
 	return( result );
 }
 
@@ -463,211 +1079,6 @@ int match( struct line_list *list, const char *str, int invert )
 	return( result );
 }
 
-/***************************************************************************
- * static int match_host( char **list, char *host );
- *  returns 1 on failure, 0 on success
- *  - match the hostname/printer strings against the list of options
- *    options are glob type regular expressions;  we implement this
- *    currently using the most crude of pattern matching
- *  - if string is null or pattern list is null, then match fails
- *    if both are null, then match succeeds
- ***************************************************************************/
-
-static int match_host( struct line_list *list, struct host_information *host,
-	int invert )
-{
- 	int result = Match_ipaddr_value(list,host);
-	if( invert ) result = !result;
- 	DEBUGF(DDB3)("match_host: host '%s' final result %d", host?host->fqdn:0,
-		result );
-	return( result );
-}
-/***************************************************************************
- * static int match_range( char **list, int port );
- * check the port number and/or range
- * entry has the format:  number     number-number
- ***************************************************************************/
-
-static int portmatch( char *val, int port )
-{
-	int low, high, err;
-	char *end;
-	int result = 1;
-	char *s, *t, *tend;
-
-	err = 0;
-	s = safestrchr( val, '-' );
-	if( s ){
-		*s = 0;
-	}
-	end = val;
-	low = strtol( val, &end, 10 );
-	if( end == val || *end ) err = 1;
-
-	high = low;
-	if( s ){
-		tend = t = s+1;
-		high = strtol( t, &tend, 10 );
-		if( t == tend || *tend ) err = 1;
-		*s = '-';
-	}
-	if( err ){
-		logmsg( LOG_ERR, "portmatch: bad port range '%s'", val );
-	}
-	if( high < low ){
-		err = high;
-		high = low;
-		low = err;
-	}
-	result = !( port >= low && port <= high );
-	DEBUGF(DDB3)("portmatch: low %d, high %d, port %d, result %d",
-		low, high, port, result );
-	return( result );
-}
-
-static int match_range( struct line_list *list, int port, int invert )
-{
-	int result = 1;
-	int i;
-	char *s;
-
-	DEBUGF(DDB3)("match_range: port '0x%x'", port );
-	for( i = 0; result && i < list->count; ++i ){
-		/* now do the match */
-		if( !(s = list->list[i]) ) continue;
-		result = portmatch( s, port );
-	}
-	if( invert ) result = !result;
-	DEBUGF(DDB3)("match_range: port '%d' result %d", port, result );
-	return( result );
-}
-
-/***************************************************************************
- * static int match_char( char **list, int value );
- * check for the character value in one of the option strings
- * entry has the format:  string
- ***************************************************************************/
-
-static int match_char( struct line_list *list, int value, int invert )
-{
-	int result = 1;
-	int i;
-	char *s;
-
-	DEBUGF(DDB3)("match_char: value '0x%x' '%c'", value, value );
-	DEBUGFC(DDB3)Dump_line_list("match_char - lines", list );
-	for( i = 0; result && i < list->count; ++i ){
-		if( !(s = list->list[i]) ) continue;
-		result = (safestrchr( s, value ) == 0) && (safestrchr(s,'*') == 0) ;
-		DEBUGF(DDB3)("match_char: val %c, str '%s', match %d",
-			value, s, result);
-	}
-	if( invert ) result = !result;
-	DEBUGF(DDB3)("match_char: value '%c' result %d", value, result );
-	return( result );
-}
-
-
-/***************************************************************************
- * static int match_group( char **list, char *str );
- *  returns 1 on failure, 0 on success
- *  - get the UID for the named user
- *  - scan the listed groups to see if there is a group
- *    check to see if user is in group
- ***************************************************************************/
-
-static int match_group( struct line_list *list, const char *str, int invert )
-{
- 	int result = 1;
- 	int i;
-	char *s;
-
- 	DEBUGF(DDB3)("match_group: str '%s'", str );
- 	for( i = 0; str && result && i < list->count; ++i ){
- 		/* now do the match */
-		if( !(s = list->list[i]) ) continue;
- 		result = ingroup( s, str );
-	}
-	if( invert ) result = !result;
- 	DEBUGF(DDB3)("match: str '%s' value %d", str, result );
-	return( result );
-}
-
-/***************************************************************************
- * static int ingroup( char* *group, char *user );
- *  returns 1 on failure, 0 on success
- *  scan group for user name
- * Note: we first check for the group.  If there is none, we check for
- *  wildcard (*) in group name, and then scan only if we need to
- ***************************************************************************/
-
-static int ingroup( char *group, const char *user )
-{
-	struct group *grent;
-	struct passwd *pwent;
-	char **members;
-	int result = 1;
-
-	DEBUGF(DDB3)("ingroup: checking '%s' for membership in group '%s'", user, group);
-	if( group == 0 || user == 0 ){
-		return( result );
-	}
-	/* first try getgrnam, see if it is a group */
-	pwent = getpwnam(user);
-	if( group[0] == '@' ) {	/* look up user in netgroup */
-#ifdef HAVE_INNETGR
-		if( !innetgr( group+1, 0, (char *)user, 0 ) ) {
-			DEBUGF(DDB3)( "ingroup: user %s P_NOT in netgroup %s", user, group+1 );
-		} else {
-			DEBUGF(DDB3)( "ingroup: user %s in netgroup %s", user, group+1 );
-			result = 0;
-		}
-#else /* HAVE_INNETGR */
-		DEBUGF(DDB3)( "ingroup: no innetgr() call, netgroups not permitted" );
-#endif /* HAVE_INNETGR */
-	} else if( group[0] == '<' && group[1] == '/' ){
-		struct line_list users;
-		Init_line_list(&users);
-		Get_file_image_and_split(group+1,0,0,&users,Whitespace,
-			0,0,0,0,0,0);
-		DEBUGFC(DDB3)Dump_line_list("match- file contents'", &users );
-		result = match_group( &users,user,0);
-		Free_line_list(&users);
-	} else if( (grent = getgrnam( group )) ){
-		DEBUGF(DDB3)("ingroup: group id: %ld\n", (long)grent->gr_gid);
-		if( pwent && ((long)pwent->pw_gid == (long)grent->gr_gid) ){
-			DEBUGF(DDB3)("ingroup: user default group id: %ld\n", (long)pwent->pw_gid);
-			result = 0;
-		} else for( members = grent->gr_mem; result && *members; ++members ){
-			DEBUGF(DDB3)("ingroup: member '%s'", *members);
-			result = (safestrcmp( user, *members ) != 0);
-		}
-	} else if( safestrpbrk( group, "*[]") ){
-		/* wildcard in group name, scan through all groups */
-		setgrent();
-		while( result && (grent = getgrent()) ){
-			DEBUGF(DDB3)("ingroup: group name '%s'", grent->gr_name);
-			/* now do match against group */
-			if( Globmatch( group, grent->gr_name ) == 0 ){
-				if( pwent && ((long)pwent->pw_gid == (long)grent->gr_gid) ){
-					DEBUGF(DDB3)("ingroup: user default group id: %ld\n",
-					(long)pwent->pw_gid);
-					result = 0;
-				} else {
-					DEBUGF(DDB3)("ingroup: found '%s'", grent->gr_name);
-					for( members = grent->gr_mem; result && *members; ++members ){
-						DEBUGF(DDB3)("ingroup: member '%s'", *members);
-						result = (safestrcmp( user, *members ) != 0);
-					}
-				}
-			}
-		}
-		endgrent();
-	}
-	DEBUGF(DDB3)("ingroup: result: %d", result );
-	return( result );
-}
-
 /***************************************************************************
  * Dump_perm_check( char *title, struct perm_check *check )
  * Dump perm_check information
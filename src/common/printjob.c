@@ -78,6 +78,10 @@ static int Write_outbuf_to_OF( struct job *job, const char *title,
 	int of_fd, char *buffer, int outlen,
 	int of_error, char *msg, int msgmax,
 	int timeout, int poll_for_status, char *status_file );
+static int Copy_fd_to_device( struct job *job, int output, int fd,
+	int status_device, char *msgbuffer, int msglen,
+	int send_job_rw_timeout, int poll_for_status );
+static int Same_print_file( struct line_list *a, struct line_list *b );
 
 
  
@@ -120,8 +124,8 @@ int Print_job( int output, int status_device, struct job *job,
 	int send_job_rw_timeout, int poll_for_status, char *user_filter )
 {
 	char *FF_str, *leader_str, *trailer_str, *filter;
-	int i, of_stdin, of_stderr, if_error[2],
-		of_pid, copy, copies,
+	int i, of_stdin, of_stderr, if_error[2], pr_pipe[2],
+		of_pid, pr_pid, copy, copies, cache_fd, filter_output, save_output,
 		do_banner, n, pid, count, fd, tempfd,
 		files_printed, time_left;
 
@@ -130,15 +134,18 @@ int Print_job( int output, int status_device, struct job *job,
 		filtermsgbuffer[SMALLBUFFER];
 	const char *id, *s, *banner_name, *transfername, *openname, *format;
 	char *t;
-	struct line_list *datafile, files;
+	struct line_list *datafile, *cache_datafile, files;
 	struct stat statb;
+	plp_status_t pr_status;
+	plp_sigfunc_t pipe_handler;
 
-	of_pid = -1;
+	of_pid = pr_pid = -1;
+	cache_datafile = 0;
 	msgbuffer[0] = 0;
 	filtermsgbuffer[0] = 0;
 	Errorcode = 0;
 	Init_line_list(&files);
-	of_stdin = of_stderr = tempfd = fd = -1;
+	of_stdin = of_stderr = tempfd = fd = cache_fd = -1;
 	FF_str = leader_str = trailer_str = 0;
 	files_printed = 0;
 
@@ -291,6 +298,17 @@ int Print_job( int output, int status_device, struct job *job,
 		plp_snprintf(filter_title,sizeof(filter_title), "%s filter '%s'",
 			filter_name, msg );
 
+		/* the filter output is saved for the copies of a file,
+		 * which may also be sent as separate data file entries
+		 */
+		if( cache_fd >= 0 && !Same_print_file( cache_datafile, datafile ) ){
+			close(cache_fd);
+			cache_fd = -1;
+		}
+		save_output = filter && !Filter_each_copy_DYN && (copies > 1
+			|| (count+1 < job->datafiles.count
+				&& Same_print_file( datafile, (void *)job->datafiles.list[count+1] )));
+
 		if( fd >= 0 ) close(fd);
 		fd = -1;
 		if( !Is_server && openname == 0 ){
@@ -312,6 +330,16 @@ int Print_job( int output, int status_device, struct job *job,
 				Errorcode = JABORT;
 				goto end_of_job;
 			}
+		}
+		if( cache_fd >= 0 ){
+			DEBUG3("Print_job: using saved filter output for '%s'", transfername );
+		} else if( cval(format) == 'p' && copies == 1 && filter ){
+			/* the pr output is piped into the filter when it starts
+			 * so the printer gets the first page without waiting
+			 * for the whole file to be formatted
+			 */
+			pr_pid = 0;
+		} else if( cval(format) == 'p' ){
 			tempfd = Make_temp_fd(0);
 			n = Filter_file( send_job_rw_timeout, fd, tempfd, "PR_PROGRAM",
 				Pr_program_DYN, 0, job, 0, 1 );
@@ -389,9 +417,18 @@ int Print_job( int output, int status_device, struct job *job,
 			}
 
 			Set_block_io( output );
-			if( filter ){
+			if( filter && cache_fd < 0 ){
 				DEBUG3("Print_job: format '%s' starting filter '%s'",
 					format, filter );
+				/* the filter output for the first copy is saved
+				 * and sent again for the other copies
+				 */
+				filter_output = output;
+				if( save_output ){
+					filter_output = cache_fd = Make_temp_fd(0);
+					cache_datafile = datafile;
+					DEBUG3("Print_job: saving filter output in fd %d", cache_fd );
+				}
 				DEBUG2("Print_job: filter_stderr_to_status_file %d, ps '%s'",
 					Filter_stderr_to_status_file_DYN, Status_file_DYN );
 				if_error[0] = if_error[1] = -1;
@@ -405,6 +442,38 @@ int Print_job( int output, int status_device, struct job *job,
 				Max_open(if_error[0]); Max_open(if_error[1]);
 				DEBUG3("Print_job: %s fd if_error[%d,%d]", filter_title,
 					 if_error[0], if_error[1] );
+				if( pr_pid == 0 ){
+					/* pr writes to the filter, errors go with the filter's */
+					if( pipe( pr_pipe ) == -1 ){
+						Errorcode = JFAIL;
+						logerr(LOG_INFO, "Print_job: pipe() failed");
+						goto end_of_job;
+					}
+					Max_open(pr_pipe[0]); Max_open(pr_pipe[1]);
+					Free_line_list(&files);
+					Check_max(&files, 10 );
+					files.list[files.count++] = Cast_int_to_voidstar(fd);		/* stdin */
+					files.list[files.count++] = Cast_int_to_voidstar(pr_pipe[1]);	/* stdout */
+					files.list[files.count++] = Cast_int_to_voidstar(if_error[1]);	/* stderr */
+					/* lpd ignores SIGPIPE;  pr gets the default action so
+					 * that it is killed by SIGPIPE,  which we can recognize,
+					 * if the filter stops reading */
+					pipe_handler = plp_signal( SIGPIPE, (plp_sigfunc_t)SIG_DFL );
+					pr_pid = Make_passthrough( Pr_program_DYN, 0, &files, job, 0 );
+					plp_signal( SIGPIPE, pipe_handler );
+					if( pr_pid < 0 ){
+						Errorcode = JABORT;
+						logerr(LOG_INFO, "Print_job:  could not make '%s' process",
+							Pr_program_DYN );
+						close( pr_pipe[0] ); close( pr_pipe[1] );
+						goto end_of_job;
+					}
+					files.count = 0;
+					Free_line_list(&files);
+					close( pr_pipe[1] );
+					close( fd );
+					fd = pr_pipe[0];
+				}
 				s = 0;
 				if( Backwards_compatible_filter_DYN ) s = BK_filter_options_DYN;
 				if( s == 0 ) s = Filter_options_DYN;
@@ -412,7 +481,7 @@ int Print_job( int output, int status_device, struct job *job,
 				Free_line_list(&files);
 				Check_max(&files, 10 );
 				files.list[files.count++] = Cast_int_to_voidstar(fd);		/* stdin */
-				files.list[files.count++] = Cast_int_to_voidstar(output);	/* stdout */
+				files.list[files.count++] = Cast_int_to_voidstar(filter_output);	/* stdout */
 				files.list[files.count++] = Cast_int_to_voidstar(if_error[1]);	/* stderr */
 				if( (pid = Make_passthrough( filter, s, &files, job, 0 )) < 0 ){
 					Errorcode = JFAIL;
@@ -422,6 +491,12 @@ int Print_job( int output, int status_device, struct job *job,
 				}
 				files.count = 0;
 				Free_line_list(&files);
+				if( pr_pid > 0 ){
+					/* only the filter reads the pr output,  so pr gets
+					 * EPIPE rather than blocking if the filter exits early */
+					close( fd );
+					fd = -1;
+				}
 
 				if( (close(if_error[1]) == -1 ) ){
 					Errorcode = JFAIL;
@@ -476,28 +551,52 @@ int Print_job( int output, int status_device, struct job *job,
 					setstatus(job, "%s filter finished", filter_title );
 					break;
 				}
-			} else {
-				/* we write to the output device, and then get status */
-				DEBUG3("Print_job: format '%s' no filter, reading from %d",
-					format, fd );
-				Init_buf(&Outbuf, &Outmax, &Outlen );
-				while( (Outlen = Read_fd_len_timeout(send_job_rw_timeout,fd,Outbuf,Outmax)) > 0 ){
-					Outbuf[Outlen] = 0;
-					n = Write_outbuf_to_OF(job,"LP",output, Outbuf, Outlen,
-						status_device, msgbuffer, sizeof(msgbuffer)-1,
-						send_job_rw_timeout, poll_for_status, Status_file_DYN );
+				if( pr_pid > 0 ){
+					/* the filter has finished successfully.  pr is killed
+					 * by SIGPIPE if the filter exits without reading all of
+					 * its output,  which is not an error.  Any other pr
+					 * failure means the filter did not get all of the file,
+					 * so the job is aborted as when pr writes a temp file */
+					n = Wait_for_pid_status( pr_pid, "PR_PROGRAM", 0,
+						send_job_rw_timeout, &pr_status );
+					if( n == JTIMEOUT ){
+						kill( pr_pid, SIGINT );
+						Wait_for_pid( pr_pid, "PR_PROGRAM", 0, 0 );
+					}
+					pr_pid = -1;
+					if( n == JSIGNAL && WIFSIGNALED(pr_status)
+						&& WTERMSIG(pr_status) == SIGPIPE ){
+						n = JSUCC;
+					}
 					if( n ){
-						Errorcode = JFAIL;
-						setstatus(job, "error '%s'", Server_status(n));
+						Errorcode = JABORT;
+						setstatus(job, "format 'p' pretty printer '%s' exit status '%s'",
+							Pr_program_DYN, Server_status(n));
 						goto end_of_job;
 					}
 				}
-				if( Outlen < 0 ){
-					Errorcode = JFAIL;
-					setstatus(job, "error reading file '%s'", Errormsg(errno));
+			}
+			if( !filter || cache_fd >= 0 ){
+				/* we write to the output device, and then get status */
+				if( cache_fd >= 0 ){
+					DEBUG3("Print_job: format '%s' sending saved filter output from %d",
+						format, cache_fd );
+					if( lseek( cache_fd, 0, SEEK_SET ) == -1 ){
+						Errorcode = JABORT;
+						logerr(LOG_INFO, "Print_job:  lseek cache_fd failed");
+						goto end_of_job;
+					}
+				} else {
+					DEBUG3("Print_job: format '%s' no filter, reading from %d",
+						format, fd );
+				}
+				n = Copy_fd_to_device( job, output, cache_fd >= 0 ? cache_fd : fd,
+					status_device, msgbuffer, sizeof(msgbuffer)-1,
+					send_job_rw_timeout, poll_for_status );
+				if( n ){
+					Errorcode = n;
 					goto end_of_job;
 				}
-				Outlen = 0;
 			}
 			DEBUG3("Print_job: finished copy");
 		}
@@ -577,6 +676,13 @@ int Print_job( int output, int status_device, struct job *job,
 	tempfd = -1;
 	if( fd != -1 ) close(fd);
 	fd = -1;
+	if( cache_fd != -1 ) close(cache_fd);
+	cache_fd = -1;
+	if( pr_pid > 0 ){
+		kill( pr_pid, SIGINT );
+		Wait_for_pid( pr_pid, "PR_PROGRAM", 0, 0 );
+	}
+	pr_pid = -1;
 	if(DEBUGL3){
 		LOGDEBUG("Print_job: at end open fd's");
 		for( i = 0; i < 20; ++i ){
@@ -588,6 +694,69 @@ int Print_job( int output, int status_device, struct job *job,
 	return( Errorcode );
 }
 
+/*
+ * int Copy_fd_to_device( struct job *job, int output, int fd,
+ *	int status_device, char *msgbuffer, int msglen,
+ *	int send_job_rw_timeout, int poll_for_status )
+ *
+ *  copy a file to the output device,  getting the device status.
+ *  If there is no device status the kernel copies the file.
+ *  RETURNS: 0 if successful, job status otherwise
+ */
+
+static int Copy_fd_to_device( struct job *job, int output, int fd,
+	int status_device, char *msgbuffer, int msglen,
+	int send_job_rw_timeout, int poll_for_status )
+{
+	struct stat statb;
+	int n;
+
+	Init_buf(&Outbuf, &Outmax, &Outlen );
+	n = -2;
+	if( status_device < 0 && fstat( fd, &statb ) == 0
+		&& S_ISREG(statb.st_mode) ){
+		/* no device status to read, let the kernel copy the file */
+		while( (n = Sendfile_fd_len_timeout( send_job_rw_timeout,
+			output, fd, SENDFILE_CHUNK )) > 0 && !Alarm_timed_out );
+		DEBUG3("Copy_fd_to_device: sendfile status %d", n );
+		if( n != -2 && (n < 0 || Alarm_timed_out) ){
+			setstatus(job, "error writing file '%s'",
+				Alarm_timed_out?"timeout":Errormsg(errno));
+			return( JFAIL );
+		}
+	}
+	/* copy the file through the buffer */
+	if( n == -2 ) while( (Outlen = Read_fd_len_timeout(send_job_rw_timeout,fd,Outbuf,Outmax)) > 0 ){
+		Outbuf[Outlen] = 0;
+		n = Write_outbuf_to_OF(job,"LP",output, Outbuf, Outlen,
+			status_device, msgbuffer, msglen,
+			send_job_rw_timeout, poll_for_status, Status_file_DYN );
+		if( n ){
+			setstatus(job, "error '%s'", Server_status(n));
+			return( JFAIL );
+		}
+	}
+	if( Outlen < 0 ){
+		setstatus(job, "error reading file '%s'", Errormsg(errno));
+		return( JFAIL );
+	}
+	Outlen = 0;
+	return( 0 );
+}
+
+/*
+ * check if two data file entries print the same file the same way
+ */
+
+static int Same_print_file( struct line_list *a, struct line_list *b )
+{
+	return( a && b
+		&& !safestrcmp( Find_str_value(a,OPENNAME), Find_str_value(b,OPENNAME) )
+		&& !safestrcmp( Find_str_value(a,DFTRANSFERNAME), Find_str_value(b,DFTRANSFERNAME) )
+		&& !safestrcmp( Find_str_value(a,FORMAT), Find_str_value(b,FORMAT) )
+		&& !safestrcmp( Find_str_value(a,"N"), Find_str_value(b,"N") ) );
+}
+
 /*
  * int Create_OF_filter( int *of_stdin, int *of_stderr )
  *  of_stdin = STDIN of filter (writable)
@@ -1110,9 +1279,17 @@ int Get_status_from_OF( struct job *job, const char *title, int of_pid,
  *  JCHILD     - ECHILD error
  *  JNOWAIT    - nonblocking check, no status
  *
+ * Wait_for_pid_status() also returns the wait status in *status
+ *  so the caller can tell which signal the process died with.
  ****************************************************************************/
 
 int Wait_for_pid( int of_pid, const char *name, int suspend, int timeout )
+{
+	return( Wait_for_pid_status( of_pid, name, suspend, timeout, 0 ) );
+}
+
+int Wait_for_pid_status( int of_pid, const char *name, int suspend, int timeout,
+	plp_status_t *status )
 {
 	int pid, err, return_code;
  	plp_status_t ps_status;
@@ -1168,6 +1345,7 @@ int Wait_for_pid( int of_pid, const char *name, int suspend, int timeout )
 	}
 	DEBUG1("Wait_for_pid: returning '%s', exit status '%s'",
 		Server_status(return_code), Decode_status(&ps_status) );
+	if( status ) *status = ps_status;
 	errno = err;
 	return( return_code );
 }
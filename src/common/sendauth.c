@@ -50,7 +50,8 @@
  *      wait for an ACK
  ***************************************************************************/
 
-static void Put_in_auth( int tempfd, const char *key, char *value );
+static void Put_in_auth( char **header, const char *key, char *value );
+static int Auth_stream_size( struct auth_stream *stream );
 
 /*
  * Send_auth_transfer
@@ -70,6 +71,10 @@ static void Put_in_auth( int tempfd, const char *key, char *value );
  *     written back on fd 2
  *     - we save this information
  *     - reopen the file and put error messages in it.
+ *  If the security module has a client_stream entry and we know the
+ *  size of all of the job files,  the job is not copied into the
+ *  tempfile but sent by the module as Auth_stream_copy() produces it;
+ *  the tempfile then only holds the reply.
  *  RETURN:
  *     0 - no error
  *     !=0 - error
@@ -80,14 +85,15 @@ int Send_auth_transfer( int *sock, int transfer_timeout,
 	const struct security *security, struct line_list *info )
 {
 	struct stat statb;
-	int ack, len, n, fd;		/* ACME! The best... */
+	struct auth_stream stream;
+	int ack, len, n, fd, streaming;		/* ACME! The best... */
 	int status = JFAIL;			/* job status */
 	char *secure, *destination, *from, *client, *s;
-	char *tempfile;
+	char *tempfile, *header;
 	char buffer[SMALLBUFFER];
 	errno = 0;
 
-	secure = 0;
+	secure = header = 0;
 	fd = Make_temp_fd(&tempfile);
 
 	if( cmd && (s = safestrrchr(cmd,'\n')) ) *s = 0;
@@ -100,45 +106,56 @@ int Send_auth_transfer( int *sock, int transfer_timeout,
 	client = Find_str_value(info, CLIENT );
 
 	if( safestrcmp(security->config_tag, "kerberos") ){
-		Put_in_auth(fd,DESTINATION,destination);
-		if( Is_server ) Put_in_auth(fd,SERVER,from);
-		Put_in_auth(fd,CLIENT,client);
+		Put_in_auth(&header,DESTINATION,destination);
+		if( Is_server ) Put_in_auth(&header,SERVER,from);
+		Put_in_auth(&header,CLIENT,client);
 		if( cmd ){
-			Put_in_auth(fd,INPUT,cmd);
+			Put_in_auth(&header,INPUT,cmd);
 		}
 	} else {
-		if( cmd && (Write_fd_str(fd,cmd) < 0 || Write_fd_str(fd,"\n") < 0) ){
-			plp_snprintf(error, errlen, "Send_auth_transfer: '%s' write failed - %s",
-				tempfile, Errormsg(errno) );
-			goto error;
+		if( cmd ){
+			header = safeextend3(header,cmd,"\n",__FILE__,__LINE__);
 		}
-		if( Is_server && (Write_fd_str(fd,client) < 0 || Write_fd_str(fd,"\n") < 0) ){
-			plp_snprintf(error, errlen, "Send_auth_transfer: '%s' write failed - %s",
-				tempfile, Errormsg(errno) );
-			goto error;
+		if( Is_server ){
+			header = safeextend3(header,client,"\n",__FILE__,__LINE__);
 		}
 	}
+	header = safeextend2(header,"\n",__FILE__,__LINE__);
 
-	if( Write_fd_str(fd,"\n") < 0 ){
-		plp_snprintf(error, errlen, "Send_auth_transfer: '%s' write failed - %s",
-			tempfile, Errormsg(errno) );
-		goto error;
-	}
+	memset( &stream, 0, sizeof(stream) );
+	stream.header = header;
+	stream.job = job;
+	streaming = security->client_stream && Auth_stream_size( &stream ) == 0;
+	DEBUG1("Send_auth_transfer: streaming %d, size %0.0f", streaming, stream.size );
 
 	s = Find_str_value(info, CMD );
-	if( job ){
-        status = Send_normal( &fd, job, logjob, transfer_timeout, fd, 0);
-        if( status ) return( status );
-		errno = 0;
-		if( stat(tempfile,&statb) ){
-			Errorcode = JABORT;
-			logerr_die(LOG_INFO, "Send_auth_transfer: stat '%s' failed",
-				tempfile);
+	if( streaming ){
+		if( job ){
+			plp_snprintf( buffer,sizeof(buffer), " %0.0f", stream.size );
+			secure = safestrdup3(s,buffer,"\n",__FILE__,__LINE__);
+		} else {
+			secure = safestrdup2(s,"\n",__FILE__,__LINE__);
 		}
-		plp_snprintf( buffer,sizeof(buffer), " %0.0f",(double)(statb.st_size) );
-		secure = safestrdup3(s,buffer,"\n",__FILE__,__LINE__);
 	} else {
-		secure = safestrdup2(s,"\n",__FILE__,__LINE__);
+		if( Write_fd_str(fd,header) < 0 ){
+			plp_snprintf(error, errlen, "Send_auth_transfer: '%s' write failed - %s",
+				tempfile, Errormsg(errno) );
+			goto error;
+		}
+		if( job ){
+			status = Send_normal( &fd, job, logjob, transfer_timeout, fd, 0);
+			if( status ) return( status );
+			errno = 0;
+			if( stat(tempfile,&statb) ){
+				Errorcode = JABORT;
+				logerr_die(LOG_INFO, "Send_auth_transfer: stat '%s' failed",
+					tempfile);
+			}
+			plp_snprintf( buffer,sizeof(buffer), " %0.0f",(double)(statb.st_size) );
+			secure = safestrdup3(s,buffer,"\n",__FILE__,__LINE__);
+		} else {
+			secure = safestrdup2(s,"\n",__FILE__,__LINE__);
+		}
 	}
 	close( fd ); fd = -1;
 
@@ -201,8 +218,13 @@ int Send_auth_transfer( int *sock, int transfer_timeout,
      * now we do the protocol dependent exchange
      */
 
-	status = security->client_send( sock, transfer_timeout, tempfile,
-		error, errlen, security, info );
+	if( streaming ){
+		status = security->client_stream( sock, transfer_timeout, &stream,
+			tempfile, error, errlen, security, info );
+	} else {
+		status = security->client_send( sock, transfer_timeout, tempfile,
+			error, errlen, security, info );
+	}
 
  error:
 
@@ -212,6 +234,7 @@ int Send_auth_transfer( int *sock, int transfer_timeout,
 	 * as the device to read from
 	 */
 	free(secure); secure = NULL;
+	free(header); header = NULL;
 	if( error[0] ){
 		if( job ){
 			setstatus(logjob, "Send_auth_transfer: %s", error );
@@ -365,19 +388,147 @@ const struct security *Fix_send_auth( char *name, struct line_list *info,
 	return(security);
 }
 
-void Put_in_auth( int tempfd, const char *key, char *value )
+static void Put_in_auth( char **header, const char *key, char *value )
 {
 	char *v = Escape(value,1);
-	DEBUG1("Put_in_auth: fd %d, key '%s' value '%s', v '%s'",
-		tempfd, key, value, v );
-	if(
-		Write_fd_str(tempfd,key) < 0
-		|| Write_fd_str(tempfd,"=") < 0
-		|| Write_fd_str(tempfd,v) < 0
-		|| Write_fd_str(tempfd,"\n") < 0
-		){
-		Errorcode = JFAIL;
-		logerr_die(LOG_INFO, "Put_in_auth: cannot write to file" );
-	}
+	DEBUG1("Put_in_auth: key '%s' value '%s', v '%s'",
+		key, value, v );
+	*header = safeextend5(*header,key,"=",v,"\n",__FILE__,__LINE__);
 	free(v); 
 }
+
+/*
+ * int Auth_stream_size( struct auth_stream *stream )
+ *  set stream->size to the number of bytes the header and the job
+ *  will have in the block transfer format written by Send_normal()
+ *  returns: 0 if the size is known,  -1 if the job must be copied
+ *   to a file first (read from STDIN, or missing or empty files
+ *   that Send_normal() will report)
+ */
+
+static int Auth_stream_size( struct auth_stream *stream )
+{
+	struct job *job = stream->job;
+	struct line_list *lp;
+	struct stat statb;
+	const char *openname, *transfername;
+	char *cf;
+	char msg[SMALLBUFFER];
+	int count;
+
+	stream->size = safestrlen(stream->header);
+	if( job == 0 ) return( 0 );
+	cf = Find_str_value(&job->info,CF_OUT_IMAGE);
+	transfername = Find_str_value(&job->info,XXCFTRANSFERNAME);
+	if( cf == 0 ) return( -1 );
+	plp_snprintf( msg, sizeof(msg), "%c%d %s\n",
+		CONTROL_FILE, safestrlen(cf), transfername );
+	stream->size += safestrlen(msg) + safestrlen(cf);
+	for( count = 0; count < job->datafiles.count; ++count ){
+		lp = (void *)job->datafiles.list[count];
+		transfername = Find_str_value(lp,DFTRANSFERNAME);
+		openname = Find_str_value(lp,OPENNAME);
+		if( !openname ) openname = transfername;
+		if( !strcmp(openname,"-") || stat(openname,&statb)
+			|| statb.st_size == 0 ){
+			return( -1 );
+		}
+		plp_snprintf( msg, sizeof(msg), "%c%0.0f %s\n",
+			DATA_FILE, (double)statb.st_size, transfername );
+		stream->size += safestrlen(msg) + statb.st_size;
+	}
+	return( 0 );
+}
+
+static int Auth_stream_write( STREAM_WRITE_PROC writer, void *arg,
+	char *buffer, int len, double *total, char *error, int errlen )
+{
+	*total += len;
+	if( len <= 0 ) return( 0 );
+	return( writer( arg, buffer, len, error, errlen ) );
+}
+
+/*
+ * int Auth_stream_copy( struct auth_stream *stream,
+ *	STREAM_WRITE_PROC writer, void *arg, char *error, int errlen )
+ *  pass the authentication header and the job in block transfer
+ *  format to writer;  this can be done more than once,  i.e. to
+ *  get a digest of the job and then send it
+ *  returns: 0 if successful, JFAIL or the writer status if not
+ */
+
+int Auth_stream_copy( struct auth_stream *stream,
+	STREAM_WRITE_PROC writer, void *arg, char *error, int errlen )
+{
+	struct job *job = stream->job;
+	struct line_list *lp;
+	struct stat statb;
+	const char *openname, *transfername;
+	char *cf;
+	char buffer[LARGEBUFFER];
+	double total = 0, size, done;
+	int count, n, fd = -1, status;
+
+	if( (status = Auth_stream_write( writer, arg, stream->header,
+		safestrlen(stream->header), &total, error, errlen )) ){
+		goto error;
+	}
+	if( job ){
+		cf = Find_str_value(&job->info,CF_OUT_IMAGE);
+		transfername = Find_str_value(&job->info,XXCFTRANSFERNAME);
+		plp_snprintf( buffer, sizeof(buffer), "%c%d %s\n",
+			CONTROL_FILE, safestrlen(cf), transfername );
+		if( (status = Auth_stream_write( writer, arg, buffer,
+				safestrlen(buffer), &total, error, errlen ))
+			|| (status = Auth_stream_write( writer, arg, cf,
+				safestrlen(cf), &total, error, errlen )) ){
+			goto error;
+		}
+		for( count = 0; count < job->datafiles.count; ++count ){
+			lp = (void *)job->datafiles.list[count];
+			transfername = Find_str_value(lp,DFTRANSFERNAME);
+			openname = Find_str_value(lp,OPENNAME);
+			if( !openname ) openname = transfername;
+			if( (fd = Checkread( openname, &statb )) < 0 ){
+				plp_snprintf(error, errlen,
+					"cannot open '%s' - '%s'", openname, Errormsg(errno) );
+				status = JFAIL;
+				goto error;
+			}
+			size = statb.st_size;
+			plp_snprintf( buffer, sizeof(buffer), "%c%0.0f %s\n",
+				DATA_FILE, size, transfername );
+			if( (status = Auth_stream_write( writer, arg, buffer,
+				safestrlen(buffer), &total, error, errlen )) ){
+				goto error;
+			}
+			for( done = 0; done < size
+				&& (n = ok_read( fd, buffer, sizeof(buffer) )) > 0; done += n ){
+				if( n > size - done ) n = size - done;
+				if( (status = Auth_stream_write( writer, arg, buffer, n,
+					&total, error, errlen )) ){
+					goto error;
+				}
+			}
+			if( done != size ){
+				plp_snprintf(error, errlen,
+					"did not copy all of '%s'", transfername );
+				status = JFAIL;
+				goto error;
+			}
+			close(fd); fd = -1;
+		}
+	}
+	if( total != stream->size ){
+		plp_snprintf(error, errlen,
+			"job changed while it was being sent - size %0.0f, expected %0.0f",
+			total, stream->size );
+		status = JFAIL;
+	}
+
+ error:
+	if( fd >= 0 ) close(fd);
+	DEBUG1("Auth_stream_copy: sent %0.0f of %0.0f, status %d",
+		total, stream->size, status );
+	return( status );
+}
@@ -66,12 +66,57 @@
  * 	int transfer_timeout    - maximum time to send
  *
  * 	RETURNS: 0 if successful, non-zero if not
+ *
+ * With forward_batch the queue server keeps the connection to the remote
+ * queue open between jobs.  Set_forward_connection() gives us the open
+ * connection, or -1 if there is none yet.  The job is sent with the data
+ * files first:  the remote server accepts the job when it gets the
+ * control file,  not when the connection closes.  On an open connection
+ * the \2RemotePrinter_DYN request has already been accepted;  if sending
+ * the job fails we close it and fall back to a connection of our own.
+ * When the job has been sent Get_forward_connection() returns the
+ * connection,  for the worker to pass back to the queue server.
+ * 
+ * With forward_pipeline we do not wait for the ACK of each command line
+ * or file before sending the next one,  but pick up the ACKs that have
+ * arrived as we go and wait for the rest at the end of the job.  This is
+ * safe with an LPRng server,  which reads a command line a byte at a time
+ * and a file by its count,  but not with every RFC1179 server.
  **************************************************************************/
 
 static int Send_control( int *sock, struct job *job, struct job *logjob, int transfer_timeout,
 	int block_fd );
 static int Send_data_files( int *sock, struct job *job, struct job *logjob,
 	int transfer_timeout, int block_fd, char *final_filter );
+static int Send_with_ack( int *sock, int timeout,
+	const char *sendstr, int count, int *ack );
+static int Read_pipelined_acks( int *sock, int timeout, int *ack, int wait );
+
+static int Forward_fd = -1;			/* connection from the queue server */
+static int Forward_kept = -1;		/* connection kept after the job */
+static char *Forward_host, *Forward_printer;	/* where it goes */
+static int Forward_open;			/* sending over Forward_fd */
+static int Forward_keep;			/* control file last, keep connection */
+static int Pipelined_acks = -1;		/* ACKs owed, -1 if not pipelining */
+
+void Set_forward_connection( int fd )
+{
+	Forward_fd = fd;
+	if( Forward_host ) free( Forward_host );
+	if( Forward_printer ) free( Forward_printer );
+	Forward_host = safestrdup( RemoteHost_DYN,__FILE__,__LINE__ );
+	Forward_printer = safestrdup( RemotePrinter_DYN,__FILE__,__LINE__ );
+	DEBUG1("Set_forward_connection: fd %d to %s@%s",
+		fd, Forward_printer, Forward_host );
+}
+
+int Get_forward_connection( void )
+{
+	int fd = Forward_kept;
+
+	Forward_kept = -1;
+	return( fd );
+}
 
 int Send_job( struct job *job, struct job *logjob,
 	int connect_timeout_len, int connect_interval, int max_connect_interval,
@@ -80,7 +125,7 @@ int Send_job( struct job *job, struct job *logjob,
 	int sock = -1;		/* socket to use */
 	char *id = 0, *s;
 	char *real_host = 0, *save_host = 0;
-	int status = 0, err, errcount = 0, n, len;
+	int status = 0, err, errcount = 0, n, len, keep;
 	char msg[SMALLBUFFER];
 	char error[LARGEBUFFER], errmsg[SMALLBUFFER];
 	const struct security *security = 0;
@@ -124,6 +169,34 @@ int Send_job( struct job *job, struct job *logjob,
 	"sending job '%s' to %s@%s",
 		id, RemotePrinter_DYN, RemoteHost_DYN );
 
+	keep = Forward_host && !security && !Send_block_format_DYN && !final_filter
+		&& !safestrcmp( Forward_host, RemoteHost_DYN )
+		&& !safestrcmp( Forward_printer, RemotePrinter_DYN );
+	if( Forward_fd >= 0 ){
+		if( keep ){
+			setstatus(logjob, "using open connection to '%s'", RemoteHost_DYN );
+			n = Forward_fd;
+			Forward_open = Forward_keep = 1;
+			status = Send_normal( &n, job, logjob, transfer_timeout, 0, 0 );
+			Forward_open = Forward_keep = 0;
+			DEBUG2("Send_job: open connection, status %d", status );
+			if( status ){
+				s = Find_str_value(&job->info,ERROR);
+				setstatus(logjob, "open connection failed, reconnecting\n  %s",
+					s?s:Link_err_str(status) );
+				Set_str_value(&job->info,ERROR,0);
+				Set_flag_value(&job->info,ERROR_TIME,0);
+				status = 0;
+			} else {
+				Forward_kept = Forward_fd; Forward_fd = -1;
+				setstatus(logjob, "done job '%s' transfer to %s@%s",
+					id, RemotePrinter_DYN, RemoteHost_DYN );
+				goto error;
+			}
+		}
+		close( Forward_fd ); Forward_fd = -1;
+	}
+
  retry_connect:
 	error[0] = 0;
 	Set_str_value(&job->info,ERROR,0);
@@ -193,11 +266,18 @@ int Send_job( struct job *job, struct job *logjob,
 	} else if( Send_block_format_DYN ){
 		status = Send_block( &sock, job, logjob, transfer_timeout );
 	} else {
+		Forward_keep = keep;
 		status = Send_normal( &sock, job, logjob, transfer_timeout, 0, final_filter );
+		Forward_keep = 0;
 	}
 	DEBUG2("Send_job: after sending, status %d, error '%s'",
 		status, error );
 	if( status ) goto error;
+	if( keep && sock >= 0 ){
+		/* the queue server sends the next job over it */
+		Forward_kept = sock;
+		sock = -1;
+	}
 
 	setstatus(logjob, "done job '%s' transfer to %s@%s",
 		id, RemotePrinter_DYN, RemoteHost_DYN );
@@ -271,6 +351,9 @@ int Send_job( struct job *job, struct job *logjob,
  * If the block_fd parameter is non-zero, we write out the
  * control and data information to a file instead.
  * 
+ * With forward_batch the control file is sent last,  and on an open
+ * connection from the queue server step 1 has already been done.
+ * 
  ***************************************************************************/
 
 int Send_normal( int *sock, struct job *job, struct job *logjob,
@@ -287,7 +370,7 @@ int Send_normal( int *sock, struct job *job, struct job *logjob,
 	id = Find_str_value(&job->info,IDENTIFIER);
 	transfername = Find_str_value(&job->info,XXCFTRANSFERNAME);
 	
-	if( !block_fd ){
+	if( !block_fd && !Forward_open ){
 		setstatus(logjob, "requesting printer %s@%s",
 			RemotePrinter_DYN, RemoteHost_DYN );
 		plp_snprintf( line, sizeof(line), "%c%s\n",
@@ -314,7 +397,11 @@ int Send_normal( int *sock, struct job *job, struct job *logjob,
 		}
 	}
 
-	if( !block_fd && Send_data_first_DYN ){
+	Pipelined_acks = -1;
+	if( !block_fd && !final_filter && Forward_pipeline_DYN ){
+		Pipelined_acks = 0;
+	}
+	if( !block_fd && (Send_data_first_DYN || Forward_keep) ){
 		status = Send_data_files( sock, job, logjob, transfer_timeout, block_fd, final_filter );
 		if( !status ) status = Send_control(
 			sock, job, logjob, transfer_timeout, block_fd );
@@ -323,9 +410,95 @@ int Send_normal( int *sock, struct job *job, struct job *logjob,
 		if( !status ) status = Send_data_files(
 			sock, job, logjob, transfer_timeout, block_fd, final_filter );
 	}
+	if( Pipelined_acks >= 0 ){
+		int err;
+		/* after a failed send, look for a refusal that explains it */
+		err = Read_pipelined_acks( sock, transfer_timeout, &ack, !status );
+		DEBUG3("Send_normal: pipelined acks status %d, ack %d", err, ack );
+		if( err && (!status || ack) ){
+			if( ack ){
+				plp_snprintf(error,sizeof(error),
+					"error '%s' with ack '%s'\n  sending job '%s' to %s@%s",
+					Link_err_str(err), Ack_err_str(ack), id,
+					RemotePrinter_DYN, RemoteHost_DYN );
+			} else {
+				plp_snprintf(error,sizeof(error),
+					"error '%s'\n  sending job '%s' to %s@%s",
+					Link_err_str(err), id,
+					RemotePrinter_DYN, RemoteHost_DYN );
+			}
+			Set_str_value(&job->info,ERROR,error);
+			Set_nz_flag_value(&job->info,ERROR_TIME,time(0));
+			status = err;
+		}
+		Pipelined_acks = -1;
+	}
 	return(status);
 }
 
+/*
+ * Send_with_ack - Link_send() that gets the ACK,  or when pipelining
+ *  counts it as owed and picks up the ones that have already arrived
+ */
+
+static int Send_with_ack( int *sock, int timeout,
+	const char *sendstr, int count, int *ack )
+{
+	int status;
+
+	if( Pipelined_acks < 0 ){
+		return( Link_send( RemoteHost_DYN, sock, timeout, sendstr, count, ack ) );
+	}
+	*ack = 0;
+	status = Link_send( RemoteHost_DYN, sock, timeout, sendstr, count, 0 );
+	if( !status ){
+		++Pipelined_acks;
+		status = Read_pipelined_acks( sock, timeout, ack, 0 );
+	}
+	return( status );
+}
+
+/*
+ * Read_pipelined_acks - read the ACKs that are owed
+ *  if wait is 0 only read the ones that have arrived
+ *  returns LINK_ACK_FAIL and sets *ack for a non-zero ACK
+ */
+
+static int Read_pipelined_acks( int *sock, int timeout, int *ack, int wait )
+{
+	char buffer[SMALLBUFFER];
+	fd_set readfds;
+	struct timeval delay;
+	int i, n, len;
+
+	*ack = 0;
+	while( Pipelined_acks > 0 && *sock >= 0 ){
+		if( !wait ){
+			memset( &delay,0,sizeof(delay));
+			FD_ZERO( &readfds );
+			FD_SET( *sock, &readfds );
+			if( select( (*sock)+1, &readfds, NULL, NULL, &delay ) <= 0 ){
+				break;
+			}
+		}
+		len = Pipelined_acks;
+		if( len > (int)sizeof(buffer) ) len = sizeof(buffer);
+		n = Read_fd_len_timeout( timeout, *sock, buffer, len );
+		DEBUG3("Read_pipelined_acks: owed %d, read %d", Pipelined_acks, n );
+		if( n <= 0 || Alarm_timed_out ){
+			return( LINK_TRANSFER_FAIL );
+		}
+		for( i = 0; i < n; ++i ){
+			if( buffer[i] ){
+				*ack = cval(buffer+i);
+				return( LINK_ACK_FAIL );
+			}
+		}
+		Pipelined_acks -= n;
+	}
+	return( 0 );
+}
+
 static int Send_control( int *sock, struct job *job, struct job *logjob, int transfer_timeout,
 	int block_fd )
 {
@@ -357,7 +530,7 @@ static int Send_control( int *sock, struct job *job, struct job *logjob, int tra
 	plp_snprintf( msg, sizeof(msg), "%c%d %s\n",
 		CONTROL_FILE, size, transfername);
 	if( !block_fd ){
-		if( (status = Link_send( RemoteHost_DYN, sock, transfer_timeout,
+		if( (status = Send_with_ack( sock, transfer_timeout,
 			msg, safestrlen(msg), &ack )) ){
 			if( (s = safestrchr(msg,'\n')) ) *s = 0;
 			if( ack ){
@@ -388,7 +561,7 @@ static int Send_control( int *sock, struct job *job, struct job *logjob, int tra
 	if( block_fd == 0 ){
 		/* we include the 0 at the end */
 		ack = 0;
-		if( (status = Link_send( RemoteHost_DYN, sock, transfer_timeout,
+		if( (status = Send_with_ack( sock, transfer_timeout,
 			cf,size+1,&ack )) ){
 			if( ack ){
 				plp_snprintf(error,sizeof(error),
@@ -498,7 +671,7 @@ static int Send_data_files( int *sock, struct job *job, struct job *logjob,
 				RemotePrinter_DYN, RemoteHost_DYN );
 			DEBUG3("Send_data_files: data file msg '%s'", msg );
 			errno = 0;
-			if( (status = Link_send( RemoteHost_DYN, sock, transfer_timeout,
+			if( (status = Send_with_ack( sock, transfer_timeout,
 				msg, safestrlen(msg), &ack )) ){
 				if( (s = safestrchr(msg,'\n')) ) *s = 0;
 				if( ack ){
@@ -536,7 +709,7 @@ static int Send_data_files( int *sock, struct job *job, struct job *logjob,
 				*sock = -1;
 			}
 			if( status 
-				|| ( fd !=0 && (status = Link_send( RemoteHost_DYN,sock,
+				|| ( fd !=0 && (status = Send_with_ack( sock,
 					transfer_timeout,"",1,&ack )) ) ){
 				if( ack ){
 					plp_snprintf(error,sizeof(error),
@@ -7,11 +7,18 @@
  *
  ***************************************************************************/
 
+#if !defined(_GNU_SOURCE)
+# define _GNU_SOURCE 1	/* splice(), fallocate() */
+#endif
 #include "lp.h"
 
 #include "utilities.h"
 #include "getopt.h"
 #include "errorcodes.h"
+#if defined(HAVE_SYS_SENDFILE_H) && defined(HAVE_SENDFILE)
+# include <sys/sendfile.h>
+# define USE_SENDFILE 1
+#endif
 
 /**** ENDINCLUDE ****/
 
@@ -223,6 +230,110 @@ int Read_fd_len_timeout( int timeout, int fd, char *msg, int len )
 	return( i );
 }
 
+/*
+ * Sendfile_fd_len_timeout( timeout, out, in, len )
+ *  copy up to len bytes from the current position of the regular
+ *  file 'in' to 'out' in the kernel, without reading them into
+ *  a buffer.
+ * returns:
+ *  n>0 - copied n
+ *  0  - EOF
+ *  -1 - failure
+ *  -2 - cannot be done for these file descriptors; nothing was
+ *       copied and the caller should read and write the data
+ */
+
+int Sendfile_fd_len_timeout( int timeout, int out, int in, int len )
+{
+#if defined(USE_SENDFILE)
+	ssize_t i;
+	int err;
+	if( timeout > 0 ){
+		if( Set_timeout() ){
+			Set_timeout_alarm( timeout  );
+			do{
+				i = sendfile( out, in, 0, len );
+			}while( i < 0 && errno == EINTR && !Alarm_timed_out );
+		} else {
+			i = -1;
+			errno = EINTR;
+		}
+		err = errno;
+		Clear_timeout();
+		errno = err;
+	} else {
+		do{
+			i = sendfile( out, in, 0, len );
+		}while( i < 0 && errno == EINTR );
+	}
+	if( i < 0 && (errno == EINVAL || errno == ENOSYS) ){
+		i = -2;
+	}
+	return( (int)i );
+#else
+	return( -2 );
+#endif
+}
+
+/*
+ * Splice_fd_len_timeout( timeout, in, out, len )
+ *  move up to len bytes from 'in' to 'out' in the kernel;
+ *  one of them must be a pipe.
+ * returns: as for Sendfile_fd_len_timeout()
+ */
+
+int Splice_fd_len_timeout( int timeout, int in, int out, int len )
+{
+#if defined(HAVE_SPLICE) && defined(SPLICE_F_MOVE)
+	ssize_t i;
+	int err;
+	if( timeout > 0 ){
+		if( Set_timeout() ){
+			Set_timeout_alarm( timeout  );
+			do{
+				i = splice( in, 0, out, 0, len, SPLICE_F_MOVE );
+			}while( i < 0 && errno == EINTR && !Alarm_timed_out );
+		} else {
+			i = -1;
+			errno = EINTR;
+		}
+		err = errno;
+		Clear_timeout();
+		errno = err;
+	} else {
+		do{
+			i = splice( in, 0, out, 0, len, SPLICE_F_MOVE );
+		}while( i < 0 && errno == EINTR );
+	}
+	if( i < 0 && (errno == EINVAL || errno == ENOSYS) ){
+		i = -2;
+	}
+	return( (int)i );
+#else
+	return( -2 );
+#endif
+}
+
+/*
+ * Preallocate_fd( fd, len )
+ *  reserve the disk space for len bytes of the file
+ *  without changing the file size.
+ * returns:
+ *  0  - reserved, or not supported
+ *  -1 - not enough space
+ */
+
+int Preallocate_fd( int fd, double len )
+{
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+	if( len > 0 && fallocate( fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)len ) == -1
+		&& errno == ENOSPC ){
+		return( -1 );
+	}
+#endif
+	return( 0 );
+}
+
 
 /**************************************************************
  * 
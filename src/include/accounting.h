@@ -14,5 +14,8 @@
 
 /* PROTOTYPES */
 int Do_accounting( int end, char *command, struct job *job, int timeout );
+int Start_accounting_sink( void );
+void Stop_accounting_sink( void );
+void Set_accounting_sink( int fd );
 
 #endif
@@ -29,6 +29,7 @@ static int Fix_perms( char *path, int perms );
 static int Check_spool_dir( char *path );
 static void Test_port(int ruid, int euid, char *serial_line );
 static void Fix_clean( char *s, int no );
+static off_t Trim_file_tail( char *file, off_t max );
 static int Check_path_list( char *plist, int allow_missing );
 
 #endif
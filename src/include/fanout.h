@@ -0,0 +1,19 @@
+/***************************************************************************
+ * LPRng - An Extended Print Spooler System
+ *
+ * Copyright 1988-2003, Patrick Powell, San Diego, CA
+ *     papowell@lprng.com
+ * See LICENSE for conditions of use.
+ ***************************************************************************/
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_ 1
+
+typedef int (*Fanout_proc)( int n, int fd, void *arg );
+typedef int (*Fanout_emit)( int n, char *output, int len, void *arg );
+
+/* PROTOTYPES */
+int Fanout_status( int count, int workers, Fanout_proc proc,
+	Fanout_emit emit, void *arg );
+
+#endif
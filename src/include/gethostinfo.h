@@ -53,6 +53,9 @@ char *Get_remote_hostbyaddr( struct host_information *info,
 int Same_host( struct host_information *host,
 	struct host_information *remote );
 void Dump_host_information( const char *title,  struct host_information *info );
+int form_addr_and_mask(char *v, char *addr,char *mask,
+	int addrlen, int family );
+int cmp_ip_addr( const char *h, const char *a, const char *m, int len );
 int Match_ipaddr_value( struct line_list *list, struct host_information *host );
 
 #endif
@@ -62,6 +62,7 @@ EXTERN const char * FIRST_SCAN			DEFINE( = "first_scan" );
 EXTERN const char * FORMAT				DEFINE( = "format" );
 EXTERN const char * FORMAT_ERROR		DEFINE( = "format_error" );
 EXTERN const char * FORWARDING			DEFINE( = "forwarding" );
+EXTERN const char * FORWARD_FD			DEFINE( = "forward_fd" );
 EXTERN const char * FORWARD_ID			DEFINE( = "forward_id" );
 EXTERN const char * FROM				DEFINE( = "from" );
 EXTERN const char * FROMHOST			DEFINE( = "H" );
@@ -81,6 +82,7 @@ EXTERN const char * INPUT				DEFINE( = "input" );
 EXTERN const char * JOBNAME				DEFINE( = "J" );
 EXTERN const char * JOBSEQ				DEFINE( = "jobseq" );
 EXTERN const char * JOBSIZE				DEFINE( = "jobsize" );
+EXTERN const char * JOB_MS				DEFINE( = "job_ms" );
 EXTERN const char * JOB_TIME			DEFINE( = "job_time" );
 EXTERN const char * JOB_TIME_USEC		DEFINE( = "job_time_usec" );
 EXTERN const char * KEYID				DEFINE( = "keyid" );
@@ -124,12 +126,14 @@ EXTERN const char * REMOVE_TIME			DEFINE( = "remove_time" );
 EXTERN const char * SD					DEFINE( = "sd" );
 EXTERN const char * SEQUENCE			DEFINE( = "sequence" );
 EXTERN const char * SERVER				DEFINE( = "server" );
+EXTERN const char * SERVER_JOB_MS		DEFINE( = "server_job_ms" );
 EXTERN const char * SERVER_ORDER		DEFINE( = "server_order" );
 EXTERN const char * SERVICE				DEFINE( = "service" );
 EXTERN const char * SIZE				DEFINE( = "size" );
 EXTERN const char * SORT_KEY			DEFINE( = "sort_key" );
 EXTERN const char * SPOOLDIR			DEFINE( = "spooldir" );
 EXTERN const char * SPOOLING_DISABLED 	DEFINE( = "spooling_disabled" );
+EXTERN const char * START_MS			DEFINE( = "start_ms" );
 EXTERN const char * START_TIME			DEFINE( = "start_time" );
 EXTERN const char * STATE				DEFINE( = "state" );
 EXTERN const char * STATUS_CHANGE		DEFINE( = "status_change" );
@@ -141,16 +145,51 @@ EXTERN const char * XXCFTRANSFERNAME		DEFINE( = "cftransfername" );
 EXTERN const char * NTRANSFERNAME		DEFINE( = "ntransfername" );
 EXTERN const char * OTRANSFERNAME		DEFINE( = "otransfername" );
 EXTERN const char * UNIXSOCKET			DEFINE( = "unixsocket" );
+EXTERN const char * UNSPOOLER			DEFINE( = "unspooler" );
 EXTERN const char * UPDATE				DEFINE( = "update" );
 EXTERN const char * UPDATE_TIME			DEFINE( = "update_time" );
 EXTERN const char * USER				DEFINE( = "user" );
 EXTERN const char * VALUE				DEFINE( = "value" );
 
+/* queue status snapshot header, see getqueue.c */
+struct queue_snapshot {
+	char magic[8];
+	int seq;			/* odd while the snapshot is being written */
+	int changes;		/* incremented when the queue changes */
+	int snap_changes;	/* value of changes when the queue was scanned */
+	time_t updated;		/* when the snapshot was written */
+	int format;			/* status line format used */
+	int jobs;			/* job ticket files in the queue */
+	int printable, held, move;	/* job counts from Scan_queue */
+	int matches, total_held, total_move;	/* short status job counts */
+	int removable;		/* done or error jobs that Remove_done_jobs() may remove */
+	time_t oldest_removable;	/* earliest done or error time of those */
+	int len;			/* length of the job status lines that follow */
+};
+
+/* binary job ticket file header, see getqueue.c */
+#define JOB_TICKET_FIELDS 12
+struct job_ticket_header {
+	char magic[8];
+	int order;			/* JOB_TICKET_ORDER, detects a different byte order */
+	int header_size;	/* sizeof(struct job_ticket_header) */
+	int records;		/* number of key=value records that follow */
+	int record_bytes;	/* length of the records */
+	int fields;			/* mask of the job state values present */
+	int hexfields;		/* mask of the values that were in hex */
+	long value[JOB_TICKET_FIELDS];	/* job state values */
+	char update_time[40];	/* UPDATE_TIME value */
+};
+
 /* PROTOTYPES */
 int Scan_queue( struct line_list *spool_control,
 	struct line_list *sort_order, int *pprintable, int *pheld, int *pmove,
 		int only_queue_process, int *perr, int *pdone,
 		const char *remove_prefix, const char *remove_suffix );
+void Queue_status_changed( void );
+int Begin_queue_snapshot( struct queue_snapshot *snap );
+int Write_queue_snapshot( struct queue_snapshot *snap, const char *lines );
+int Read_queue_snapshot( struct queue_snapshot *snap, char **lines );
 char *Get_fd_image( int fd, off_t maxsize );
 char *Get_file_image( const char *file, off_t maxsize );
 int Get_fd_image_and_split( int fd,
@@ -169,6 +208,7 @@ int Set_job_ticket_from_cf_info( struct job *job, char *cf_file_image, int read_
 char *Make_job_ticket_image( struct job *job );
 int Set_job_ticket_file( struct job *job, struct line_list *perm_check, int fd );
 void Get_job_ticket_file( int *lock_fd, struct job *job, char *job_ticket_name );
+void Get_job_ticket_from_index( struct job *job, char *job_ticket_name );
 void Get_spool_control( const char *file, struct line_list *info );
 void Set_spool_control( struct line_list *perm_check, const char *file,
 	struct line_list *info );
@@ -183,6 +223,7 @@ int Setup_printer( char *prname, char *error, int errlen, int subserver );
 pid_t Read_pid( int fd);
 pid_t Read_pid_from_file( const char *filename);
 int Write_pid( int fd, int pid, char *str );
+int Write_slot_pid( int fd, int slot, int pid );
 int Patselect( struct line_list *token, struct line_list *cf, int starting );
 int Check_format( int type, const char *name, struct job *job );
 char *Frwarding(struct line_list *l);
@@ -197,6 +238,9 @@ void Init_job( struct job *job );
 void Free_job( struct job *job );
 void Copy_job( struct job *dest, struct job *src );
 char *Fix_job_number( struct job *job, int n );
+int Allocate_job_number( int n, int max );
+void Release_job_number( const char *job_ticket_name );
+int Sync_spool_files( struct line_list *files );
 char *Make_identifier( struct job *job );
 void Dump_job( const char *title, struct job *job );
 void Job_printable( struct job *job, struct line_list *spool_control,
@@ -206,6 +250,8 @@ void Update_destination( struct job *job );
 int Get_destination( struct job *job, int n );
 int Get_destination_by_name( struct job *job, char *name );
 int Trim_status_file( int status_fd, char *file, int max, int min );
+char *Status_file_segment( const char *file );
+char *Get_status_file_image( const char *file, off_t maxsize, int lines );
 char *Fix_datafile_infox( struct job *job, const char *number, const char *suffix,
 	const char *xlate_format, int update_df_names );
 void Fix_control( struct job *job, char *filter, char *xlate_format,
@@ -18,10 +18,15 @@
 
 #define cval(x) (int)(*(unsigned const char *)(x))
 
+struct line_hash;
+struct line_arena;
+
 struct line_list {
 	char **list;	/* array of pointers to lines */
 	int count;		/* number of entries */
 	int max;		/* maximum number of entries */
+	struct line_hash *hash;	/* optional key index, see Hash_line_list() */
+	struct line_arena *arena;	/* optional line storage, see Make_line_arena() */
 };
 
 typedef void (WorkerProc)( struct line_list *args, int input );
@@ -164,6 +169,11 @@ void Init_line_list( struct line_list *l );
 void Free_line_list( struct line_list *l );
 void Free_listof_line_list( struct line_list *l );
 void Check_max( struct line_list *l, int incr );
+void Hash_line_list( struct line_list *l );
+struct line_arena *Make_line_arena( void );
+void Use_line_arena( struct line_list *l, struct line_arena *arena );
+void Reset_line_arena( struct line_arena *arena );
+void Free_line_arena( struct line_arena *arena );
 char *Add_line_list( struct line_list *l, const char *str,
 		const char *sep, int sort, int uniq );
 void Merge_line_list( struct line_list *dest, struct line_list *src,
@@ -225,6 +235,9 @@ void Getprintcap_pathlist( int required,
 	char *path );
 void Filterprintcap( struct line_list *raw, struct line_list *filters,
 	const char *str );
+void Read_printcap_files( int required, char *path, char *cache,
+	struct line_list *names, struct line_list *order,
+	struct line_list *info, struct line_list *filters );
 int Check_for_rg_group( char *user );
 int Make_temp_fd_in_dir( char **temppath, char *dir );
 int Make_temp_fd( char **temppath );
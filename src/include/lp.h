@@ -37,6 +37,7 @@
 #define LINEBUFFER 180
 #define SMALLBUFFER 512
 #define LARGEBUFFER 10240
+#define SENDFILE_CHUNK (64*LARGEBUFFER)
  
 /*****************************************************************
  * Include files that are so common they should be included anyways
@@ -228,9 +229,11 @@ EXTERN char* ShortRemote_FQDN;   /* Short form of Remote host */
 
 EXTERN int Drop_root_DYN;				/* drop root permissions */
 
+EXTERN int Accounting_batch_DYN; /* send accounting records through the queue accounting sink */
 EXTERN int Accounting_check_DYN; /* check accounting at start */
 EXTERN char* Accounting_end_DYN;/* accounting at start (see also af, la, ar) */
 EXTERN char* Accounting_file_DYN; /* name of accounting file (see also la, ar) */
+EXTERN int Accounting_fsync_DYN; /* fsync accounting file after each write */
 EXTERN char* Accounting_namefixup_DYN; /* fix up accounting name */
 EXTERN int Accounting_remote_DYN; /* write remote transfer accounting (if af is set) */
 EXTERN char* Accounting_start_DYN;/* accounting at start (see also af, la, ar) */
@@ -253,6 +256,7 @@ EXTERN char* Banner_line_DYN;	 /* short banner line sent to banner printer */
 EXTERN char* Banner_printer_DYN; /* banner printing program (see ep) */
 EXTERN char* Banner_start_DYN;	 /* start banner printing program overrides bp */
 EXTERN int Baud_rate_DYN; /* if lp is a tty, set the baud rate (see ty) */
+EXTERN int Binary_job_ticket_DYN; /* write job ticket files in binary form */
 EXTERN char* Bounce_queue_format_DYN; /* destination for bounce queue files */
 EXTERN int Break_classname_priority_link_DYN; /* do not set priority from class name */
 EXTERN int Check_for_nonprintable_DYN;	/* lpr check for nonprintable file */
@@ -285,6 +289,10 @@ EXTERN int   Done_jobs_DYN;        /* keep the last NN done jobs */
 EXTERN int   Done_jobs_max_age_DYN; /* keep the done jobs for at least max age seconds */
 EXTERN int Direct_DYN;		/* allow LPR to send jobs to a socket */
 EXTERN int Discard_zero_length_jobs_DYN;		/* discard zero length jobs */
+EXTERN char* Dns_cache_DYN;	/* shared host information cache file */
+EXTERN int Dns_cache_negative_ttl_DYN;	/* keep failed lookups this long */
+EXTERN int Dns_cache_ttl_DYN;	/* keep host information this long */
+EXTERN int Durable_receive_DYN;	/* sync received jobs to disk before accepting them */
 EXTERN int Exit_linger_timeout_DYN;	/* we set this timeout on all of the sockets */
 EXTERN int FF_on_close_DYN; /* print a form feed when device is closed */
 EXTERN int FF_on_open_DYN; /* print a form feed when device is opened */
@@ -292,6 +300,7 @@ EXTERN int Fifo_DYN; /* FIFO (first in first out) order enforced */
 EXTERN char* Fifo_lock_file_DYN; /* lock file for FIFO */
 
 EXTERN char* Filter_DYN; /* default filter */
+EXTERN int   Filter_each_copy_DYN; /* run the filter again for each copy */
 EXTERN int   Filter_stderr_to_status_file_DYN; /* filter errors sent to :ps file */
 EXTERN char* Filter_ld_path_DYN;
 EXTERN char* Filter_options_DYN;
@@ -304,6 +313,8 @@ EXTERN int Force_localhost_DYN;	/* force localhost for client job transfer */
 EXTERN char* Force_lpq_status_DYN;	/* force lpq status format */
 EXTERN int Force_poll_DYN; /* force polling job queues */
 EXTERN char* Force_queuename_DYN; /* force the use of this queue name */
+EXTERN int Forward_batch_DYN; /* send a run of jobs over one connection */
+EXTERN int Forward_pipeline_DYN; /* do not wait for each ACK when sending a job */
 EXTERN char* Form_feed_DYN; /* string to send for a form feed */
 EXTERN char* Formats_allowed_DYN; /* valid output filter formats */
 EXTERN int Full_time_DYN; /* full or complete time format in messages */
@@ -348,6 +359,7 @@ EXTERN char* Lpq_status_file_DYN; /* cached lpq status */
 EXTERN int   Lpq_status_cached_DYN;  /* how many to cache */
 EXTERN int   Lpq_status_interval_DYN;  /* interval between updates */
 EXTERN int   Lpq_status_stale_DYN;  /* cached lpq status is stale after this */
+EXTERN int   Lpq_status_snapshot_DYN;  /* publish queue status snapshot */
 EXTERN char* Lpr_opts_DYN;		/* addional options for LPR */
 EXTERN int Lpr_send_try_DYN; /* number of times for lpr to try sending job */
 EXTERN char* Mail_from_DYN;
@@ -391,17 +403,26 @@ EXTERN char *Plugin_path_DYN; /* plugin path */
 EXTERN int Poll_time_DYN; /* force polling job queues */
 EXTERN int Poll_start_interval_DYN; /* interval between trying to start servers */
 EXTERN int Poll_servers_started_DYN; /* maximum servers to start at one time */
+EXTERN int Pool_requests_DYN; /* connections serviced by a pool worker */
+EXTERN int Pool_workers_DYN; /* maximum connection pool workers */
 EXTERN char* Ppd_file_DYN;	/* ppd file */
 EXTERN char* Pr_program_DYN; /* pr program for p format */
 EXTERN char* Prefix_Z_DYN; /* prefix -Z options on outgoing or filter*/
 EXTERN char* Prefix_option_to_option_DYN; /* prefix option to option, ie, "z,o" */
+EXTERN char* Printcap_cache_DYN; /* compiled printcap cache file */
 EXTERN char* Printcap_path_DYN;
 EXTERN char* Printer_DYN;		/* Printe r name for logging */
 EXTERN char* Printer_DYN;	/* printer name */
 EXTERN char* Printer_perms_path_DYN;
 EXTERN char* Queue_name_DYN;	/* Queue name used for spooling */
+EXTERN char* Queue_commit_file_DYN; /* Queue received job sync file name */
 EXTERN char* Queue_control_file_DYN; /* Queue control file name */
+EXTERN char* Queue_index_file_DYN; /* Queue job ticket index file name */
+EXTERN char* Queue_jobnumber_file_DYN; /* Queue job numbers in use file name */
 EXTERN char* Queue_lock_file_DYN; /* Queue lock file name */
+EXTERN char* Queue_scan_summary_DYN; /* idle queues found by the last scan */
+EXTERN int Queue_scan_workers_DYN; /* processes scanning queues for status */
+EXTERN char* Queue_snapshot_file_DYN; /* Queue status snapshot file name */
 EXTERN char* Queue_status_file_DYN; /* Queue status file name */
 EXTERN char* Queue_unspooler_file_DYN; /* Unspooler PID status file name */
 EXTERN int Read_write_DYN; /* open the printer for reading and writing */
@@ -441,6 +462,7 @@ EXTERN int Socket_linger_DYN;	/* set SO_linger for connections to remote hosts *
 EXTERN char* Spool_dir_DYN; /* spool directory (only ONE printer per directory!) */
 EXTERN int Spool_dir_perms_DYN;
 EXTERN int Spool_file_perms_DYN;
+EXTERN int Spool_notify_DYN; /* lpd watches spool directories for new jobs */
 EXTERN char *Ssl_ca_file_DYN;	/* ssl cert file */
 EXTERN char *Ssl_ca_path_DYN;	/* ssl cert directory (path) */
 EXTERN char *Ssl_crl_file_DYN;	/* ssl crl cert directory (path) */
@@ -456,6 +478,7 @@ EXTERN int Suspend_OF_filter_DYN; /* suspend OF filter */
 EXTERN char* Syslog_device_DYN;	/* default syslog() facility */
 EXTERN char* Trailer_on_close_DYN; /* trailer string to print when queue empties */
 EXTERN char* Unix_socket_path_DYN;	/* UNIX socket pathname */
+EXTERN int Unspoolers_DYN;	/* jobs printed at the same time */
 EXTERN int Use_info_cache_DYN;
 EXTERN int Use_queuename_DYN;	/* put queuename in control file */
 EXTERN int Use_queuename_flag_DYN;	/* Specified with the -Q option */
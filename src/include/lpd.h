@@ -45,7 +45,14 @@ static void Reinit(void);
 static int Get_lpd_pid(void);
 static void Set_lpd_pid(int lockfd);
 static int Lock_lpd_pid(void);
+static void Make_daemon_file( char *path );
+static void Make_daemon_files( void );
 static int Read_server_status( int fd );
+static void Add_server_requests( struct line_list *l );
+static void Add_server_request( const char *name );
+static void Setup_spool_notify( void );
+static void Add_spool_notify( char *entry );
+static int Read_spool_notify( void );
 static void usage(void);
 static void Get_parms(int argc, char *argv[] );
 static void Accept_connection( int sock );
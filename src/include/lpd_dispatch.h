@@ -15,5 +15,6 @@
 void Dispatch_input(int *talk, char *input, const char *from_addr );
 void Service_all( struct line_list *args, int ) NORETURN;
 void Service_connection( struct line_list *args, int ) NORETURN;
+void Service_pool( struct line_list *args, int channel ) NORETURN;
 
 #endif
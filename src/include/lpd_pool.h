@@ -0,0 +1,22 @@
+/***************************************************************************
+ * LPRng - An Extended Print Spooler System
+ *
+ * Copyright 1988-2003, Patrick Powell, San Diego, CA
+ *     papowell@lprng.com
+ * See LICENSE for conditions of use.
+ ***************************************************************************/
+
+#ifndef _LPD_POOL_H_
+#define _LPD_POOL_H_ 1
+
+/* PROTOTYPES */
+int Pool_dispatch( int talk );
+int Pool_idle_workers( void );
+void Pool_fdset( fd_set *readfds, int *max_socks );
+void Pool_read( fd_set *readfds );
+void Pool_reaped( pid_t pid );
+void Pool_shutdown( void );
+int Send_fd( int channel, int fd );
+int Receive_fd( int channel );
+
+#endif
@@ -16,6 +16,12 @@ int Job_status( int *sock, char *input );
 void Get_queue_status( struct line_list *tokens, int *sock,
 	int displayformat, int status_lines, struct line_list *done_list,
 	int max_size, char *hash_key );
+void Publish_queue_snapshot( struct queue_snapshot *snap,
+	struct line_list *sort_order, int printable, int held, int move,
+	int only_queue_process );
+int Snapshot_removal_due( struct queue_snapshot *snap );
+int Scan_queue_snapshot( struct line_list *sort_order, int *pprintable,
+	int *pheld, int *pmove, int *perr, int *pdone );
 void Print_different_last_status_lines( int *sock, int fd,
 	int status_lines, int max_size );
 void Get_local_or_remote_status( struct line_list *tokens, int *sock,
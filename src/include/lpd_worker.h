@@ -10,5 +10,7 @@
 #define _LPD_WORKER_H_ 1
 
 pid_t Start_worker( const char *name, WorkerProc *proc, struct line_list *parms, int fd );
+pid_t Start_worker_fds( const char *name, WorkerProc *proc, struct line_list *parms, int fd,
+	const char *key, int fd2 );
 
 #endif
@@ -20,13 +20,18 @@ EXTERN int Status_line_count; /* number of status lines */
 EXTERN int Clear_scr;       /* clear screen */
 EXTERN int Interval;        /* display interval */
 EXTERN int Show_all;        /* show all status */
+EXTERN int Status_worker;   /* getting status for Fanout_status() */
 
 /* PROTOTYPES */
 int main(int argc, char *argv[], char *envp[]);
 static void Show_status(char **argv);
+static int Scan_status( int n, int fd, void *argv );
+static int Report_status( int n, char *output, int len, void *argv );
 static int Read_status_info( char *host, int sock,
 	int output, int timeout, int displayformat,
 	int status_line_count );
+static int Print_status_lines( struct line_list *l, int output,
+	int displayformat, int status_line_count );
 static void Term_clear(void);
 static void Get_parms(int argc, char *argv[] );
 static void usage(void);
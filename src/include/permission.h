@@ -90,6 +90,7 @@ EXTERN struct perm_check Perm_check;
 
 /* PROTOTYPES */
 const char *perm_str( int n );
+void Compile_perms( struct line_list *perms );
 int Perms_check( struct line_list *perms, struct perm_check *check,
 	struct job *job, int job_check );
 int match( struct line_list *list, const char *str, int invert );
@@ -779,10 +779,12 @@ extern int innetgr(const char *netgroup,
 # define PRINTFATTR(fmtofs,dotsofs) __attribute__ ((format (printf, fmtofs, dotsofs)))
 # define NORETURN __attribute__ ((noreturn))
 # define UNUSED __attribute__ ((unused))
+# define Memory_barrier() __sync_synchronize()
 #else
 # define PRINTFATTR(fmtofs,dotsofs)
 # define NORETURN
 # define UNUSED
+# define Memory_barrier()
 #endif
 
 #endif
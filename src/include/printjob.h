@@ -18,6 +18,8 @@ int Get_status_from_OF( struct job *job, const char *title, int of_pid,
 	int of_error, char *msg, int msgmax,
 	int timeout, int suspend, int max_wait, char *status_file );
 int Wait_for_pid( int of_pid, const char *name, int suspend, int timeout );
+int Wait_for_pid_status( int of_pid, const char *name, int suspend, int timeout,
+	plp_status_t *status );
 void Add_banner_to_job( struct job *job );
 
 #endif
@@ -17,5 +17,7 @@ int Send_auth_transfer( int *sock, int transfer_timeout,
 	const struct security *security, struct line_list *info );
 const struct security *Fix_send_auth( char *name, struct line_list *info,
 	struct job *job, char *error, int errlen );
+int Auth_stream_copy( struct auth_stream *stream,
+	STREAM_WRITE_PROC writer, void *arg, char *error, int errlen );
 
 #endif
@@ -12,6 +12,8 @@
 #define _SENDJOB_1_ 1
 
 /* PROTOTYPES */
+void Set_forward_connection( int fd );
+int Get_forward_connection( void );
 int Send_job( struct job *job, struct job *logjob,
 	int connect_timeout_len, int connect_interval, int max_connect_interval,
 	int transfer_timeout, char *final_filter );
@@ -27,6 +27,27 @@ typedef int (*SEND_PROC)( int *sock,
 	char *error, int errlen,
 	const struct security *security, struct line_list *info );
 
+/*
+ * A job or command sent through the authenticated channel without
+ * first copying it to a temporary file.  Auth_stream_copy() produces
+ * the same bytes that client_send would read from the file.
+ */
+struct auth_stream {
+	char *header;			/* authentication information */
+	struct job *job;		/* job, 0 if command */
+	double size;			/* total bytes Auth_stream_copy() will write */
+};
+
+/* write len bytes, return 0 if successful */
+typedef int (*STREAM_WRITE_PROC)( void *arg, char *buffer, int len,
+	char *error, int errlen );
+
+typedef int (*STREAM_PROC)( int *sock,
+	int transfer_timeout,
+	struct auth_stream *stream, char *tempfile,
+	char *error, int errlen,
+	const struct security *security, struct line_list *info );
+
 typedef int (*GET_REPLY_PROC)( struct job *job, int *sock,
 	int transfer_timeout,
 	char *error, int errlen,
@@ -77,13 +98,14 @@ struct security {
 	SEND_PROC    client_send;		/* client to server authenticate transfer, talk to transfer */
 	ACCEPT_PROC server_accept;		/* server accepts the connection, sets up transfer */
 	RECEIVE_PROC server_receive;	/* server to client, receive from client */
+	STREAM_PROC  client_stream;		/* client_send without the temporary file */
 };
 
 typedef size_t (plugin_get_func)(const struct security **, size_t max);
 
 /* if anything changes, increment this to avoid old plugins getting loaded */
-#define AUTHPLUGINVERSION 0
-#define getter_name(n) get_lprng_auth_0_ ## n
+#define AUTHPLUGINVERSION 1
+#define getter_name(n) get_lprng_auth_1_ ## n
 
 /* PROTOTYPES */
 const struct security *FindSecurity( const char *name );
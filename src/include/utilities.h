@@ -34,6 +34,9 @@ int Write_fd_len_timeout( int timeout, int fd, const char *msg, int len );
 int Write_fd_str( int fd, const char *msg );
 int Write_fd_str_timeout( int timeout, int fd, const char *msg );
 int Read_fd_len_timeout( int timeout, int fd, char *msg, int len );
+int Sendfile_fd_len_timeout( int timeout, int out, int in, int len );
+int Splice_fd_len_timeout( int timeout, int in, int out, int len );
+int Preallocate_fd( int fd, double len );
 plp_sigfunc_t plp_signal (int signo, plp_sigfunc_t func);
 plp_sigfunc_t plp_signal_break (int signo, plp_sigfunc_t func);
 void plp_block_all_signals ( plp_block_mask *oblock );
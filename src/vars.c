@@ -105,6 +105,10 @@ struct keywords Pc_var_list[] = {
 /* XXSTARTXX */
    /*  always print banner, ignore lpr -h option */
 { "ab", 0,  FLAG_K,  &Always_banner_DYN,0,0,0},
+   /*  send accounting records through the queue accounting sink */
+{ "accounting_batch", 0,  FLAG_K,  &Accounting_batch_DYN,0,0,0},
+   /*  fsync accounting file after each write */
+{ "accounting_fsync", 0,  FLAG_K,  &Accounting_fsync_DYN,0,0,0},
    /*  set accounting name in control file based on host name */
 { "accounting_namefixup", 0,  STRING_K,  &Accounting_namefixup_DYN,0,0,0},
    /*  query accounting server when connected */
@@ -135,6 +139,8 @@ struct keywords Pc_var_list[] = {
 { "auth_forward", 0, STRING_K, &Auth_forward_DYN,0,0,0},
    /*  end banner printing program overides bp */
 { "be", 0,  STRING_K,  &Banner_end_DYN,0,0,0},
+   /*  write job ticket files in binary form */
+{ "binary_job_ticket", 0,  FLAG_K,  &Binary_job_ticket_DYN,0,0,0},
    /*  Berkeley LPD: job file strictly RFC-compliant */
 { "bk", 0,  FLAG_K,  &Backwards_compatible_DYN,0,0,0},
    /*  Berkeley LPD filter options */
@@ -207,12 +213,20 @@ struct keywords Pc_var_list[] = {
 { "discard_large_jobs", 0, FLAG_K, &Discard_large_jobs_DYN,0,0,"=1"},
    /* keep the last NN done jobs for status purposes */
 { "discard_zero_length_jobs", 0, FLAG_K, &Discard_zero_length_jobs_DYN,0,0,"=0"},
+   /* shared host information cache file */
+{ "dns_cache", 0, STRING_K, &Dns_cache_DYN,1,0,"=" LOCKFILE ".dns"},
+   /* keep failed host lookups in the cache for this many seconds */
+{ "dns_cache_negative_ttl", 0, INTEGER_K, &Dns_cache_negative_ttl_DYN,0,0,"=60"},
+   /* keep host information in the cache for this many seconds */
+{ "dns_cache_ttl", 0, INTEGER_K, &Dns_cache_ttl_DYN,0,0,"=300"},
    /* do not print zero length jobs */
 { "done_jobs", 0, INTEGER_K, &Done_jobs_DYN,0,0,"=" DONE_JOBS},
    /* keep done jobs for at most max age seconds */
 { "done_jobs_max_age", 0, INTEGER_K, &Done_jobs_max_age_DYN,0,0,"=" DONE_JOBS_MAX_AGE},
    /* drop root permissions after binding to listening port */
 { "drop_root", 0, FLAG_K, &Drop_root_DYN,0,0,0},
+   /* sync received jobs to disk before accepting them */
+{ "durable_receive", 0, FLAG_K, &Durable_receive_DYN,0,0,0},
    /* exit linger timeout to wait for socket to close */
 { "exit_linger_timeout", 0, INTEGER_K, &Exit_linger_timeout_DYN,0,0,"=600"},
    /* use this size (in Kbytes) when sending 'unknown' size files to a spooler */
@@ -227,6 +241,8 @@ struct keywords Pc_var_list[] = {
 { "fifo_lock_file", 0, STRING_K, &Fifo_lock_file_DYN,0,0,"=fifo.lock"},
    /* default filter */
 { "filter", 0, STRING_K, &Filter_DYN,0,0,0},
+   /* run the filter again for each copy instead of reusing its output */
+{ "filter_each_copy", 0, FLAG_K, &Filter_each_copy_DYN,0,0,0},
    /* filter LD_LIBRARY_PATH value */
 { "filter_ld_path", 0, STRING_K, &Filter_ld_path_DYN,0,0,"=" FILTER_LD_PATH },
    /* filter options */
@@ -249,6 +265,10 @@ struct keywords Pc_var_list[] = {
 { "force_lpq_status", 0, STRING_K, &Force_lpq_status_DYN,0,0,0},
    /*  force use of this queuename if none provided */
 { "force_queuename", 0, STRING_K, &Force_queuename_DYN,0,0,0},
+   /*  send a run of jobs to the remote queue over one connection */
+{ "forward_batch", 0, FLAG_K, &Forward_batch_DYN,0,0,0},
+   /*  send job subcommands without waiting for each ACK */
+{ "forward_pipeline", 0, FLAG_K, &Forward_pipeline_DYN,0,0,0},
    /*  print a form feed when device is closed */
 { "fq", 0,  FLAG_K,  &FF_on_close_DYN,0,0,0},
    /* full or complete time format */
@@ -327,16 +347,24 @@ struct keywords Pc_var_list[] = {
 { "lpd_poll_start_interval", 0,  INTEGER_K,  &Poll_start_interval_DYN,0,0,"=1"},
    /*  interval in secs between servicing all queues */
 { "lpd_poll_time", 0,  INTEGER_K,  &Poll_time_DYN,0,0,"=600"},
+   /*  connections serviced by a pool worker before it exits */
+{ "lpd_pool_requests", 0,  INTEGER_K,  &Pool_requests_DYN,0,0,"=100"},
+   /*  maximum number of connection pool workers, 0 disables the pool */
+{ "lpd_pool_workers", 0,  INTEGER_K,  &Pool_workers_DYN,0,0,"=0"},
    /* lpd port */
 { "lpd_port", 0, STRING_K, &Lpd_port_DYN,0,0,"=515"},
    /* lpd printcap path */
 { "lpd_printcap_path", 0, STRING_K, &Lpd_printcap_path_DYN,1,0,"=" LPD_PRINTCAP_PATH},
+   /* lpd watches spool directories for job files created by other programs */
+{ "lpd_spool_notify", 0, FLAG_K, &Spool_notify_DYN,0,0,"=1"},
    /* maximum number of lpq status queries kept in cache */
 { "lpq_status_cached", 0, INTEGER_K, &Lpq_status_cached_DYN,0,0,"=10"},
    /* cached lpq status file */
 { "lpq_status_file", 0, STRING_K, &Lpq_status_file_DYN,0,0,"=lpq"},
    /* minimum interval between updates */
 { "lpq_status_interval", 0, INTEGER_K, &Lpq_status_interval_DYN,0,0,"=2"},
+   /* lpd publishes a queue status snapshot for lpq */
+{ "lpq_status_snapshot", 0, FLAG_K, &Lpq_status_snapshot_DYN,0,0,"=1"},
    /* cached lpq status timeout - refresh after this time */
 { "lpq_status_stale", 0, INTEGER_K, &Lpq_status_stale_DYN,0,0,"=3600"},
    /* Additional options for LPR */
@@ -417,6 +445,8 @@ struct keywords Pc_var_list[] = {
 { "prefix_option_to_option", 0, STRING_K, &Prefix_option_to_option_DYN,0,0,0},
    /* prefix these -Z options to start of options list on outgoing or filters */
 { "prefix_z", 0, STRING_K, &Prefix_Z_DYN,0,0,0},
+   /* compiled printcap cache file */
+{ "printcap_cache", 0, STRING_K, &Printcap_cache_DYN,1,0,"=" LOCKFILE ".printcap"},
    /* /etc/printcap files */
 { "printcap_path", 0, STRING_K, &Printcap_path_DYN,1,0,"=" PRINTCAP_PATH},
    /*  printer status file name */
@@ -429,10 +459,22 @@ struct keywords Pc_var_list[] = {
 { "py", 0,  INTEGER_K,  &Page_y_DYN,0,0,0},
    /*  put queue name in control file */
 { "qq", 0,  FLAG_K,  &Use_queuename_DYN,0,0,"=1"},
+   /*  print queue received job sync file name */
+{ "queue_commit_file", 0,  STRING_K,  &Queue_commit_file_DYN,0,0,"=commit.pr"},
    /*  print queue control file name */
 { "queue_control_file", 0,  STRING_K,  &Queue_control_file_DYN,0,0,"=control.pr"},
+   /*  print queue job ticket index file name */
+{ "queue_index_file", 0,  STRING_K,  &Queue_index_file_DYN,0,0,"=index.pr"},
+   /*  print queue job numbers in use file name */
+{ "queue_jobnumber_file", 0,  STRING_K,  &Queue_jobnumber_file_DYN,0,0,"=jobnumber.pr"},
    /*  print queue lock file name */
 { "queue_lock_file", 0,  STRING_K,  &Queue_lock_file_DYN,0,0,"=lock.pr"},
+   /*  idle queues found by the last lpd queue scan */
+{ "queue_scan_summary", 0,  STRING_K,  &Queue_scan_summary_DYN,1,0,"=" LOCKFILE ".queues"},
+   /*  processes used to scan queues for lpq -a and the status dump */
+{ "queue_scan_workers", 0,  INTEGER_K,  &Queue_scan_workers_DYN,0,0,"=8"},
+   /*  print queue status snapshot file name */
+{ "queue_snapshot_file", 0,  STRING_K,  &Queue_snapshot_file_DYN,0,0,"=snapshot.pr"},
    /*  print queue status file name */
 { "queue_status_file", 0,  STRING_K,  &Queue_status_file_DYN,0,0,"=status.pr"},
    /*  print queue unspooler pid file name */
@@ -545,6 +587,8 @@ struct keywords Pc_var_list[] = {
 { "translate_incoming_format", 0,  STRING_K,  &Xlate_incoming_format_DYN,0,0,0},
    /*  path for UNIX socket for localhost connections */
 { "unix_socket_path", 0,  STRING_K,  &Unix_socket_path_DYN,0,0,"=" UNIXSOCKETPATH},
+   /*  number of jobs in the queue that are printed at the same time */
+{ "unspoolers", 0,  INTEGER_K,  &Unspoolers_DYN,0,0,"=1"},
    /*  read and cache information */
 { "use_info_cache", 0, FLAG_K, &Use_info_cache_DYN,0,0,"1"},
    /*  put queue name in control file */